@@ -14,21 +14,157 @@
  * limitations under the License.
  */
 #pragma once
+#include <async_simple/Promise.h>
+#include <async_simple/coro/FutureAwaiter.h>
 #include <async_simple/coro/Lazy.h>
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <numeric>
+#include <optional>
 #include <random>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "client_pool.hpp"
 #include "io_context_pool.hpp"
 namespace coro_io {
 
 enum class load_blance_algorithm {
-  RR = 0,  // round-robin
-  WRR,     // weight round-robin
+  RR = 0,             // round-robin
+  WRR,                // weight round-robin
   random,
+  P2C,                // power of two choices, by load and latency
+  least_outstanding,  // the host with the fewest requests in flight
+  consistent_hash,    // by the key of send_request(key, op)
+};
+
+/**
+ * @brief limits retries and hedged requests to a ratio of the requests, so
+ * that they can't multiply the load of an overloaded backend.
+ *
+ * Every request deposits `ratio` tokens, up to `max_tokens`, and every retry
+ * or hedge takes one. It starts full. Share one between channels for a
+ * global budget.
+ */
+class retry_budget {
+ public:
+  retry_budget(double ratio = 0.1, double max_tokens = 10)
+      : deposit_(static_cast<int64_t>(ratio * scale)),
+        max_tokens_(static_cast<int64_t>(max_tokens * scale)),
+        tokens_(max_tokens_) {}
+
+  void deposit() noexcept {
+    auto tokens = tokens_.load(std::memory_order_relaxed);
+    while (tokens < max_tokens_ &&
+           !tokens_.compare_exchange_weak(
+               tokens, (std::min)(tokens + deposit_, max_tokens_),
+               std::memory_order_relaxed)) {
+    }
+  }
+
+  bool try_withdraw() noexcept {
+    auto tokens = tokens_.load(std::memory_order_relaxed);
+    while (tokens >= scale) {
+      if (tokens_.compare_exchange_weak(tokens, tokens - scale,
+                                        std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  // tokens are kept in thousandths
+  static constexpr int64_t scale = 1000;
+  int64_t deposit_;
+  int64_t max_tokens_;
+  std::atomic<int64_t> tokens_;
+};
+
+/**
+ * @brief latencies of the recent requests in log-scale buckets, four per
+ * power of two microseconds, for quantiles like the p95.
+ *
+ * The counts are halved whenever there are max_count of them, so that the
+ * quantiles follow changes of the backends.
+ */
+class latency_histogram {
+ public:
+  static constexpr uint64_t min_count = 100;
+  static constexpr uint64_t max_count = 4096;
+
+  void record(std::chrono::steady_clock::duration latency) noexcept {
+    auto us =
+        std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    buckets_[bucket(us < 0 ? 0 : static_cast<uint64_t>(us))].fetch_add(
+        1, std::memory_order_relaxed);
+    if (count_.fetch_add(1, std::memory_order_relaxed) + 1 == max_count) {
+      uint64_t count = 0;
+      for (auto& n : buckets_) {
+        auto halved = n.load(std::memory_order_relaxed) / 2;
+        n.store(halved, std::memory_order_relaxed);
+        count += halved;
+      }
+      count_.store(count, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief the q-quantile of the latencies, rounded up to its bucket, or
+   * nullopt before min_count of them are recorded.
+   *
+   * @return std::optional<std::chrono::microseconds>
+   */
+  std::optional<std::chrono::microseconds> quantile(double q) const noexcept {
+    uint64_t total = 0;
+    for (auto& n : buckets_) {
+      total += n.load(std::memory_order_relaxed);
+    }
+    if (total < min_count) {
+      return std::nullopt;
+    }
+    auto target = static_cast<uint64_t>(q * total);
+    uint64_t count = 0;
+    for (std::size_t i = 0; i < bucket_cnt; ++i) {
+      count += buckets_[i].load(std::memory_order_relaxed);
+      if (count > target) {
+        return std::chrono::microseconds{upper_bound(i)};
+      }
+    }
+    return std::chrono::microseconds{upper_bound(bucket_cnt - 1)};
+  }
+
+ private:
+  static constexpr std::size_t bucket_cnt = 128;
+
+  // [0, 4) us have a bucket each, then [4 << b, 8 << b) us is split in four.
+  static std::size_t bucket(uint64_t us) noexcept {
+    if (us < 4) {
+      return us;
+    }
+    std::size_t b = std::bit_width(us) - 1;
+    std::size_t i = 4 * (b - 1) + ((us >> (b - 2)) & 3);
+    return (std::min)(i, bucket_cnt - 1);
+  }
+
+  static uint64_t upper_bound(std::size_t i) noexcept {
+    if (i < 4) {
+      return i + 1;
+    }
+    return (5 + i % 4) << (i / 4 - 1);
+  }
+
+  std::array<std::atomic<uint64_t>, bucket_cnt> buckets_{};
+  std::atomic<uint64_t> count_ = 0;
 };
 
 template <typename client_t, typename io_context_pool_t = io_context_pool>
@@ -40,6 +176,20 @@ class channel {
   struct channel_config {
     typename client_pool_t::pool_config pool_config;
     load_blance_algorithm lba = load_blance_algorithm::RR;
+    // Hedging: when a request hasn't finished after hedge_delay, the same
+    // request is sent to another host too, and the first successful reply
+    // wins. With hedge_quantile, e.g. 0.95, the delay is that quantile of
+    // the recent latencies instead, hedge_delay until there are enough of
+    // them. 0 disables both. Only for idempotent requests.
+    std::chrono::milliseconds hedge_delay{0};
+    double hedge_quantile = 0;
+    // A request that couldn't be sent, e.g. connection refused, is retried
+    // on the next host up to max_retries times.
+    uint32_t max_retries = 0;
+    // Retries and hedges are limited by a retry budget of
+    // retry_budget_ratio, or by shared_retry_budget if it's set.
+    double retry_budget_ratio = 0.1;
+    std::shared_ptr<coro_io::retry_budget> shared_retry_budget;
     ~channel_config(){};
   };
 
@@ -139,23 +289,159 @@ class channel {
   struct RandomLoadBlancer {
     async_simple::coro::Lazy<std::shared_ptr<client_pool_t>> operator()(
         const channel& channel) {
-      static thread_local std::default_random_engine e;
+      static thread_local std::default_random_engine e(std::random_device{}());
       std::uniform_int_distribution rnd{std::size_t{0},
                                         channel.client_pools_.size() - 1};
       co_return channel.client_pools_[rnd(e)];
     }
   };
+  /*
+   Power of two choices: pick two hosts at random and send to the one with the
+   lower cost, (outstanding requests + 1) * latency EWMA. Unlike looking at
+   every host, it doesn't make all clients rush to the same idle host, and a
+   slow host stops getting most of the traffic after a few requests.
+  */
+  struct P2CLoadBlancer {
+    async_simple::coro::Lazy<std::shared_ptr<client_pool_t>> operator()(
+        const channel& channel) {
+      auto& pools = channel.client_pools_;
+      if (pools.size() < 2) {
+        co_return pools[0];
+      }
+      // seeded, so that the threads (and processes) don't all pick the same
+      // sequence of hosts.
+      static thread_local std::default_random_engine e(std::random_device{}());
+      std::uniform_int_distribution first{std::size_t{0}, pools.size() - 1};
+      std::uniform_int_distribution second{std::size_t{0}, pools.size() - 2};
+      auto i = first(e);
+      auto j = second(e);
+      if (j >= i) {
+        ++j;
+      }
+      co_return cost(*pools[i]) <= cost(*pools[j]) ? pools[i] : pools[j];
+    }
+
+   private:
+    static double cost(const client_pool_t& pool) {
+      // a host without latency sample costs as little as possible, so that it
+      // gets one.
+      return (pool.outstanding_requests() + 1) *
+             (pool.latency_ewma().count() + 1.0);
+    }
+  };
+
+  struct LeastOutstandingLoadBlancer {
+    std::unique_ptr<std::atomic<uint32_t>> index =
+        std::make_unique<std::atomic<uint32_t>>();
+    async_simple::coro::Lazy<std::shared_ptr<client_pool_t>> operator()(
+        const channel& channel) {
+      auto& pools = channel.client_pools_;
+      // ties go round-robin, instead of always to the first host.
+      std::size_t start =
+          index->fetch_add(1, std::memory_order_relaxed) % pools.size();
+      std::size_t selected = start;
+      std::size_t least = pools[start]->outstanding_requests();
+      for (std::size_t n = 1; n < pools.size() && least > 0; ++n) {
+        std::size_t i = (start + n) % pools.size();
+        auto outstanding = pools[i]->outstanding_requests();
+        if (outstanding < least) {
+          least = outstanding;
+          selected = i;
+        }
+      }
+      co_return pools[selected];
+    }
+  };
+  /*
+   Ring hash: every host is put on a ring of 64 bit hashes at
+   `virtual_node_cnt` points, hashed from its name, and a key goes to the
+   first host point at or after the key's hash. Adding or removing a host
+   only moves the keys of the arcs it owns, about 1/n of them, and every
+   channel with the same hosts maps a key to the same host.
+  */
+  struct ConsistentHashLoadBlancer {
+    static constexpr uint32_t virtual_node_cnt = 160;
+
+    ConsistentHashLoadBlancer(const std::vector<std::string_view>& hosts) {
+      ring_.reserve(hosts.size() * virtual_node_cnt);
+      for (uint32_t i = 0; i < hosts.size(); ++i) {
+        std::string name{hosts[i]};
+        name.push_back('#');
+        auto prefix_len = name.size();
+        for (uint32_t n = 0; n < virtual_node_cnt; ++n) {
+          name.resize(prefix_len);
+          name += std::to_string(n);
+          ring_.emplace_back(hash(name), i);
+        }
+      }
+      std::sort(ring_.begin(), ring_.end());
+    }
+
+    // requests without a key go round-robin.
+    async_simple::coro::Lazy<std::shared_ptr<client_pool_t>> operator()(
+        const channel& channel) {
+      auto i = index->fetch_add(1, std::memory_order_relaxed);
+      co_return channel.client_pools_[i % channel.client_pools_.size()];
+    }
+
+    async_simple::coro::Lazy<std::shared_ptr<client_pool_t>> operator()(
+        const channel& channel, std::string_view key) {
+      auto& pools = channel.client_pools_;
+      auto iter = std::lower_bound(ring_.begin(), ring_.end(),
+                                   std::pair{hash(key), uint32_t{0}});
+      if (iter == ring_.end()) {
+        iter = ring_.begin();
+      }
+      // the keys of an ejected host go on to the next hosts of the ring, so
+      // they are spread over the others and come back with it.
+      auto selected = iter;
+      while (pools[selected->second]->is_ejected()) {
+        if (++selected == ring_.end()) {
+          selected = ring_.begin();
+        }
+        if (selected == iter) {
+          break;
+        }
+      }
+      co_return pools[selected->second];
+    }
+
+    // FNV-1a, then the murmur3 finalizer to spread similar names and keys
+    // over the whole ring. Stable across processes and platforms.
+    static uint64_t hash(std::string_view str) {
+      uint64_t h = 14695981039346656037ull;
+      for (unsigned char c : str) {
+        h = (h ^ c) * 1099511628211ull;
+      }
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdull;
+      h ^= h >> 33;
+      h *= 0xc4ceb9fe1a85ec53ull;
+      h ^= h >> 33;
+      return h;
+    }
+
+    // (hash, index of the host)
+    std::vector<std::pair<uint64_t, uint32_t>> ring_;
+    std::unique_ptr<std::atomic<uint32_t>> index =
+        std::make_unique<std::atomic<uint32_t>>();
+  };
   channel() = default;
 
  public:
   channel(channel&& o)
       : config_(std::move(o.config_)),
         lb_worker(std::move(o.lb_worker)),
-        client_pools_(std::move(o.client_pools_)){};
+        client_pools_(std::move(o.client_pools_)),
+        retry_budget_(std::move(o.retry_budget_)),
+        latencies_(std::move(o.latencies_)){};
   channel& operator=(channel&& o) {
     this->config_ = std::move(o.config_);
     this->lb_worker = std::move(o.lb_worker);
     this->client_pools_ = std::move(o.client_pools_);
+    this->retry_budget_ = std::move(o.retry_budget_);
+    this->latencies_ = std::move(o.latencies_);
+    return *this;
   }
   channel(const channel& o) = delete;
   channel& operator=(const channel& o) = delete;
@@ -175,6 +461,13 @@ class channel {
     else {
       client_pool = client_pools_[0];
     }
+    client_pool = skip_ejected(std::move(client_pool));
+    if constexpr (std::is_copy_constructible_v<decltype(op)>) {
+      if (config_.max_retries > 0 || hedge_enabled()) {
+        co_return co_await send_with_policy(std::move(client_pool),
+                                            std::move(op), config);
+      }
+    }
     co_return co_await client_pool->send_request(
         std::move(op), client_pool->get_host_name(), config);
   }
@@ -182,6 +475,47 @@ class channel {
     return send_request(std::move(op), config_.pool_config.client_config);
   }
 
+  /**
+   * @brief send a request to the host `key` maps to, so that requests of the
+   * same key land on the same host. Only the consistent_hash algorithm
+   * routes by key, the others ignore it.
+   */
+  auto send_request(std::string_view key, auto op,
+                    typename client_t::config& config)
+      -> decltype(std::declval<client_pool_t>().send_request(std::move(op),
+                                                             std::string_view{},
+                                                             config)) {
+    std::shared_ptr<client_pool_t> client_pool;
+    if (client_pools_.size() > 1) {
+      if (auto ring = std::get_if<ConsistentHashLoadBlancer>(&lb_worker)) {
+        client_pool = co_await (*ring)(*this, key);
+      }
+      else {
+        client_pool = co_await std::visit(
+            [this](auto& worker) {
+              return worker(*this);
+            },
+            lb_worker);
+      }
+    }
+    else {
+      client_pool = client_pools_[0];
+    }
+    client_pool = skip_ejected(std::move(client_pool));
+    if constexpr (std::is_copy_constructible_v<decltype(op)>) {
+      if (config_.max_retries > 0 || hedge_enabled()) {
+        co_return co_await send_with_policy(std::move(client_pool),
+                                            std::move(op), config);
+      }
+    }
+    co_return co_await client_pool->send_request(
+        std::move(op), client_pool->get_host_name(), config);
+  }
+  auto send_request(std::string_view key, auto op) {
+    return send_request(key, std::move(op),
+                        config_.pool_config.client_config);
+  }
+
   static channel create(const std::vector<std::string_view>& hosts,
                         const channel_config& config = {},
                         const std::vector<int>& weights = {},
@@ -199,11 +533,204 @@ class channel {
    */
   std::size_t size() const noexcept { return client_pools_.size(); }
 
+  /**
+   * @brief latencies of the requests sent with hedging or retries, see
+   * channel_config.
+   *
+   * @return const latency_histogram&
+   */
+  const latency_histogram& latencies() const noexcept { return *latencies_; }
+
  private:
+  template <typename result_t>
+  struct hedge_state {
+    async_simple::Promise<result_t> promise;
+    std::atomic<bool> has_result = false;
+    // requests sent and not finished
+    std::atomic<int> pending = 1;
+    // waits hedge_delay before the second request.
+    std::shared_ptr<coro_io::period_timer> timer;
+
+    // the first result is in: stop the hedge timer. The request still
+    // running isn't closed, which would count as a failure of a host that is
+    // merely slower and throw away a pooled connection, its late result is
+    // dropped instead.
+    void set_result(async_simple::Try<result_t>&& ret) {
+      if (has_result.exchange(true, std::memory_order_acq_rel)) {
+        return;
+      }
+      promise.setValue(std::move(ret));
+      asio::post(timer->get_executor(), [timer = timer] {
+        timer->cancel();
+      });
+    }
+  };
+
+  bool hedge_enabled() const noexcept {
+    return client_pools_.size() > 1 &&
+           (config_.hedge_delay.count() > 0 || config_.hedge_quantile > 0);
+  }
+
+  std::chrono::microseconds hedge_delay() const noexcept {
+    if (config_.hedge_quantile > 0) {
+      if (auto delay = latencies_->quantile(config_.hedge_quantile)) {
+        return *delay;
+      }
+    }
+    return config_.hedge_delay;
+  }
+
+  template <typename Op>
+  static auto attempt(std::shared_ptr<client_pool_t> client_pool, Op op,
+                      typename client_t::config& config,
+                      std::shared_ptr<latency_histogram> latencies)
+      -> decltype(client_pool->send_request(std::move(op), std::string_view{},
+                                            config)) {
+    auto begin = std::chrono::steady_clock::now();
+    auto ret = co_await client_pool->send_request(
+        std::move(op), client_pool->get_host_name(), config);
+    if (ret.has_value()) {
+      latencies->record(std::chrono::steady_clock::now() - begin);
+    }
+    co_return std::move(ret);
+  }
+
+  // the first successful reply is the result, or the last failure (or
+  // exception of op) when nothing else is pending.
+  template <typename Op, typename result_t>
+  static async_simple::coro::Lazy<void> hedge_attempt(
+      std::shared_ptr<hedge_state<result_t>> state,
+      std::shared_ptr<client_pool_t> client_pool, Op op,
+      typename client_t::config config,
+      std::shared_ptr<latency_histogram> latencies) {
+    auto ret = co_await attempt(std::move(client_pool), std::move(op), config,
+                                std::move(latencies))
+                   .coAwaitTry();
+    if ((!ret.hasError() && ret.value().has_value()) ||
+        state->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      state->set_result(std::move(ret));
+    }
+  }
+
+  template <typename Op, typename result_t>
+  static async_simple::coro::Lazy<void> hedge_after(
+      std::chrono::microseconds delay,
+      std::shared_ptr<hedge_state<result_t>> state,
+      std::shared_ptr<client_pool_t> client_pool, Op op,
+      typename client_t::config config,
+      std::shared_ptr<latency_histogram> latencies,
+      std::shared_ptr<coro_io::retry_budget> budget) {
+    state->timer->expires_after(delay);
+    if (!co_await state->timer->async_await() ||
+        state->has_result.load(std::memory_order_acquire)) {
+      co_return;
+    }
+    if (!budget->try_withdraw()) {
+      ELOG_DEBUG << "retry budget exhausted, don't hedge to "
+                 << client_pool->get_host_name();
+      co_return;
+    }
+    state->pending.fetch_add(1, std::memory_order_acq_rel);
+    if (state->has_result.load(std::memory_order_acquire)) {
+      co_return;
+    }
+    ELOG_TRACE << "hedge request to " << client_pool->get_host_name();
+    co_await hedge_attempt(std::move(state), std::move(client_pool),
+                           std::move(op), std::move(config),
+                           std::move(latencies));
+  }
+
+  // The first result cancels the hedge timer. The request which lost runs
+  // on in the background until it finishes, so it owns copies of everything
+  // it uses, and its result is dropped.
+  template <typename Op>
+  auto send_hedged(std::shared_ptr<client_pool_t> client_pool, Op op,
+                   typename client_t::config& config,
+                   std::chrono::microseconds delay)
+      -> decltype(client_pool->send_request(std::move(op), std::string_view{},
+                                            config)) {
+    using result_t = typename decltype(client_pool->send_request(
+        std::move(op), std::string_view{}, config))::ValueType;
+    auto state = std::make_shared<hedge_state<result_t>>();
+    auto timer_executor = coro_io::get_global_executor();
+    state->timer = std::make_shared<coro_io::period_timer>(timer_executor);
+    auto future = state->promise.getFuture();
+    auto executor = co_await async_simple::CurrentExecutor{};
+    auto start = [executor](async_simple::coro::Lazy<void> lazy) {
+      if (executor) {
+        std::move(lazy).via(executor).start([](auto&&) {
+        });
+      }
+      else {
+        lazy.start([](auto&&) {
+        });
+      }
+    };
+    start(hedge_attempt(state, client_pool, op, config, latencies_));
+    // the timer is only used on its own executor.
+    hedge_after(delay, state, next_pool(client_pool), std::move(op), config,
+                latencies_, retry_budget_)
+        .via(timer_executor)
+        .start([](auto&&) {
+        });
+    co_return co_await std::move(future);
+  }
+
+  template <typename Op>
+  auto send_with_policy(std::shared_ptr<client_pool_t> client_pool, Op op,
+                        typename client_t::config& config)
+      -> decltype(client_pool->send_request(std::move(op), std::string_view{},
+                                            config)) {
+    retry_budget_->deposit();
+    auto delay = hedge_enabled() ? hedge_delay() : std::chrono::microseconds{};
+    auto first = delay.count() > 0
+                     ? send_hedged(client_pool, op, config, delay)
+                     : attempt(client_pool, op, config, latencies_);
+    auto ret = co_await std::move(first);
+    for (uint32_t i = 0; !ret.has_value() && i < config_.max_retries; ++i) {
+      if (!retry_budget_->try_withdraw()) {
+        ELOG_DEBUG << "retry budget exhausted, don't retry request to "
+                   << client_pool->get_host_name();
+        break;
+      }
+      client_pool = next_pool(client_pool);
+      ELOG_TRACE << "retry request to " << client_pool->get_host_name();
+      ret = co_await attempt(client_pool, op, config, latencies_);
+    }
+    co_return std::move(ret);
+  }
+
+  // an ejected host is passed over for the next one which isn't. If all of
+  // them are, the request goes to the selected host, which fails fast or
+  // probes it.
+  std::shared_ptr<client_pool_t> skip_ejected(
+      std::shared_ptr<client_pool_t> client_pool) const {
+    return client_pool->is_ejected() ? next_pool(client_pool) : client_pool;
+  }
+
+  // the first host after client_pool which isn't ejected, or client_pool.
+  std::shared_ptr<client_pool_t> next_pool(
+      const std::shared_ptr<client_pool_t>& client_pool) const {
+    std::size_t i =
+        std::find(client_pools_.begin(), client_pools_.end(), client_pool) -
+        client_pools_.begin();
+    for (std::size_t n = 1; n < client_pools_.size(); ++n) {
+      auto& next = client_pools_[(i + n) % client_pools_.size()];
+      if (!next->is_ejected()) {
+        return next;
+      }
+    }
+    return client_pool;
+  }
+
   void init(const std::vector<std::string_view>& hosts,
             const channel_config& config, const std::vector<int>& weights,
             client_pools_t& client_pools) {
     config_ = config;
+    retry_budget_ = config.shared_retry_budget
+                        ? config.shared_retry_budget
+                        : std::make_shared<coro_io::retry_budget>(
+                              config.retry_budget_ratio);
     client_pools_.reserve(hosts.size());
     for (auto& host : hosts) {
       client_pools_.emplace_back(client_pools.at(host, config.pool_config));
@@ -221,6 +748,15 @@ class channel {
         }
         lb_worker = WRRLoadBlancer(weights);
       } break;
+      case load_blance_algorithm::P2C:
+        lb_worker = P2CLoadBlancer{};
+        break;
+      case load_blance_algorithm::least_outstanding:
+        lb_worker = LeastOutstandingLoadBlancer{};
+        break;
+      case load_blance_algorithm::consistent_hash:
+        lb_worker = ConsistentHashLoadBlancer(hosts);
+        break;
       case load_blance_algorithm::random:
       default:
         lb_worker = RandomLoadBlancer{};
@@ -228,8 +764,14 @@ class channel {
     return;
   }
   channel_config config_;
-  std::variant<RRLoadBlancer, WRRLoadBlancer, RandomLoadBlancer> lb_worker;
+  std::variant<RRLoadBlancer, WRRLoadBlancer, RandomLoadBlancer,
+               P2CLoadBlancer, LeastOutstandingLoadBlancer,
+               ConsistentHashLoadBlancer>
+      lb_worker;
   std::vector<std::shared_ptr<client_pool_t>> client_pools_;
+  std::shared_ptr<coro_io::retry_budget> retry_budget_;
+  std::shared_ptr<latency_histogram> latencies_ =
+      std::make_shared<latency_histogram>();
 };
 
 }  // namespace coro_io
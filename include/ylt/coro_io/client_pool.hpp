@@ -27,12 +27,15 @@
 #include <asio/steady_timer.hpp>
 #include <atomic>
 #include <chrono>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <deque>
 #include <exception>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <random>
 #include <shared_mutex>
 #include <string_view>
@@ -63,11 +66,13 @@ class client_pool : public std::enable_shared_from_this<
   static async_simple::coro::Lazy<void> collect_idle_timeout_client(
       std::weak_ptr<client_pool> self_weak,
       coro_io::detail::client_queue<std::unique_ptr<client_t>>& clients,
-      std::chrono::milliseconds sleep_time, std::size_t clear_cnt) {
+      std::chrono::milliseconds sleep_time, std::size_t clear_cnt,
+      std::size_t min_idle, std::chrono::milliseconds max_keep_time) {
     std::shared_ptr<client_pool> self = self_weak.lock();
     if (self == nullptr) {
       co_return;
     }
+    std::chrono::milliseconds kept_time{0};
     while (true) {
       clients.reselect();
       self = nullptr;
@@ -79,7 +84,12 @@ class client_pool : public std::enable_shared_from_this<
         ELOG_DEBUG << "start collect timeout client of pool{"
                    << self->host_name_
                    << "}, now client count: " << clients.size();
-        std::size_t is_all_cleared = clients.clear_old(clear_cnt);
+        // keep min_idle clients, but no longer than max_keep_time: the server
+        // may have closed them meanwhile, keep_min_idle() reconnects them.
+        auto size = clients.size();
+        auto keep = kept_time < max_keep_time ? min_idle : 0;
+        std::size_t is_all_cleared = clients.clear_old(
+            size > keep ? (std::min)(clear_cnt, size - keep) : 0);
         ELOG_DEBUG << "finish collect timeout client of pool{"
                    << self->host_name_
                    << "}, now client cnt: " << clients.size();
@@ -94,6 +104,8 @@ class client_pool : public std::enable_shared_from_this<
           break;
         }
       }
+      kept_time = kept_time < max_keep_time ? kept_time + sleep_time
+                                            : std::chrono::milliseconds{0};
       --clients.collecter_cnt_;
       if (clients.size() == 0) {
         break;
@@ -105,6 +117,37 @@ class client_pool : public std::enable_shared_from_this<
     co_return;
   }
 
+  static async_simple::coro::Lazy<void> keep_min_idle(
+      std::weak_ptr<client_pool> self_weak) {
+    while (true) {
+      std::chrono::milliseconds interval;
+      {
+        auto self = self_weak.lock();
+        if (self == nullptr) {
+          co_return;
+        }
+        if (self->free_clients_.size() <
+            self->pool_config_.min_idle_connection) {
+          co_await self->warm_up(self->pool_config_.min_idle_connection);
+        }
+        interval = self->pool_config_.reconnect_wait_time;
+      }
+      co_await coro_io::sleep_for(interval);
+    }
+  }
+
+  void start_min_idle_keeper() {
+    if (pool_config_.min_idle_connection == 0) {
+      return;
+    }
+    ELOG_DEBUG << "start min idle keeper of client_pool{" << host_name_
+               << "}, min idle: " << pool_config_.min_idle_connection;
+    keep_min_idle(this->weak_from_this())
+        .via(coro_io::get_global_executor())
+        .start([](auto&&) {
+        });
+  }
+
   struct client_connect_helper {
     std::unique_ptr<client_t> client;
     std::weak_ptr<client_pool> pool_watcher;
@@ -144,6 +187,159 @@ class client_pool : public std::enable_shared_from_this<
     }
   };
 
+  // Counts a request as outstanding until it finishes, adds the latency of
+  // its operation to the pool's EWMA, and reports whether it failed to the
+  // outlier detection. A request fails unless `ok` is set, e.g. when the
+  // operation throws.
+  struct request_tracker {
+    request_tracker(client_pool& pool, bool is_probe)
+        : pool(pool), is_probe(is_probe) {
+      pool.outstanding_requests_.fetch_add(1, std::memory_order_relaxed);
+    }
+    ~request_tracker() {
+      pool.outstanding_requests_.fetch_sub(1, std::memory_order_relaxed);
+      if (op_start) {
+        pool.record_latency(std::chrono::steady_clock::now() - *op_start);
+      }
+      pool.record_result(ok, is_probe);
+    }
+    void start_op() { op_start = std::chrono::steady_clock::now(); }
+    client_pool& pool;
+    bool is_probe;
+    bool ok = false;
+    std::optional<std::chrono::steady_clock::time_point> op_start;
+  };
+
+  void record_latency(std::chrono::steady_clock::duration latency) {
+    int64_t sample =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count();
+    int64_t old = latency_ewma().count();
+    // the first sample is taken as is, later ones with a weight of 1/8, like
+    // TCP's smoothed rtt. Concurrent updates may lose a sample.
+    int64_t ewma = old == 0 ? sample : old + (sample - old) / 8;
+    latency_ewma_ns_.store((std::max<int64_t>)(ewma, 1),
+                           std::memory_order_relaxed);
+    latency_updated_at_.store(
+        std::chrono::steady_clock::now().time_since_epoch().count(),
+        std::memory_order_relaxed);
+  }
+
+  static bool default_host_failure(std::errc ec) {
+    switch (ec) {
+      case std::errc::timed_out:
+      case std::errc::io_error:
+      case std::errc::not_connected:
+      case std::errc::connection_refused:
+      case std::errc::connection_reset:
+      case std::errc::connection_aborted:
+      case std::errc::broken_pipe:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  // Whether a finished request failed the host, for the outlier detection.
+  template <typename R>
+  bool is_host_failure(client_t& client, const R& ret) {
+    if (client.has_closed()) {
+      return true;
+    }
+    if constexpr (requires { client_t::result_errc(ret); }) {
+      if (auto ec = client_t::result_errc(ret);
+          ec && pool_config_.is_host_failure) {
+        return pool_config_.is_host_failure(*ec);
+      }
+    }
+    return false;
+  }
+
+  static int64_t now_ticks() {
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+  }
+
+  // Whether a request may be sent. It's false while the host is ejected,
+  // and once the ejection time is over, true for a single probe request.
+  bool admit(bool& is_probe) {
+    auto ejected_until = ejected_until_.load(std::memory_order_acquire);
+    if (ejected_until == 0) {
+      return true;
+    }
+    if (now_ticks() < ejected_until) {
+      return false;
+    }
+    bool expected = false;
+    is_probe = probing_.compare_exchange_strong(expected, true,
+                                                std::memory_order_acq_rel);
+    return is_probe;
+  }
+
+  void record_result(bool ok, bool is_probe) {
+    if (is_probe) {
+      if (ok) {
+        ELOG_INFO << "probe of ejected host " << host_name_
+                  << " succeeded, host is back";
+        ejection_count_.store(0, std::memory_order_relaxed);
+        consecutive_failures_.store(0, std::memory_order_relaxed);
+        ejected_until_.store(0, std::memory_order_release);
+      }
+      else {
+        eject();
+      }
+      probing_.store(false, std::memory_order_release);
+      return;
+    }
+    auto now = now_ticks();
+    auto window_start = window_start_.load(std::memory_order_relaxed);
+    if (now - window_start >
+            std::chrono::steady_clock::duration{
+                pool_config_.eject_error_rate_window}
+                .count() &&
+        window_start_.compare_exchange_strong(window_start, now)) {
+      window_requests_.store(0, std::memory_order_relaxed);
+      window_failures_.store(0, std::memory_order_relaxed);
+    }
+    auto requests =
+        window_requests_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (ok) {
+      consecutive_failures_.store(0, std::memory_order_relaxed);
+      return;
+    }
+    auto failures =
+        window_failures_.fetch_add(1, std::memory_order_relaxed) + 1;
+    auto consecutive =
+        consecutive_failures_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (ejected_until_.load(std::memory_order_acquire) != 0) {
+      // a request sent before the host was ejected.
+      return;
+    }
+    if ((pool_config_.eject_consecutive_failures != 0 &&
+         consecutive >= pool_config_.eject_consecutive_failures) ||
+        (pool_config_.eject_error_rate > 0 &&
+         requests >= pool_config_.eject_min_requests &&
+         failures >= pool_config_.eject_error_rate * requests)) {
+      eject();
+    }
+  }
+
+  void eject() {
+    // the ejection time doubles each time in a row the host is ejected.
+    auto shift = (std::min)(
+        ejection_count_.fetch_add(1, std::memory_order_relaxed), 16u);
+    auto ejection_time =
+        (std::min)(pool_config_.base_ejection_time * (1 << shift),
+                   pool_config_.max_ejection_time);
+    consecutive_failures_.store(0, std::memory_order_relaxed);
+    window_requests_.store(0, std::memory_order_relaxed);
+    window_failures_.store(0, std::memory_order_relaxed);
+    ejected_until_.store(
+        now_ticks() +
+            std::chrono::steady_clock::duration{ejection_time}.count(),
+        std::memory_order_release);
+    ELOG_WARN << "eject host " << host_name_ << " for "
+              << ejection_time.count() << "ms";
+  }
+
   async_simple::coro::Lazy<void> reconnect(std::unique_ptr<client_t>& client) {
     for (unsigned int i = 0; i < pool_config_.connect_retry_count; ++i) {
       ELOG_DEBUG << "try to reconnect client{" << client.get() << "},host:{"
@@ -305,7 +501,9 @@ class client_pool : public std::enable_shared_from_this<
                                   pool_config_.short_connect_idle_timeout)
                      : pool_config_.idle_timeout),
                 std::chrono::milliseconds{50}),
-            pool_config_.idle_queue_per_max_clear_count)
+            pool_config_.idle_queue_per_max_clear_count,
+            is_short_client ? 0 : pool_config_.min_idle_connection,
+            pool_config_.max_connection_time)
             .via(coro_io::get_global_executor())
             .start([](auto&&) {
             });
@@ -369,7 +567,37 @@ class client_pool : public std::enable_shared_from_this<
     std::chrono::milliseconds reconnect_wait_time{1000};
     std::chrono::milliseconds idle_timeout{30000};
     std::chrono::milliseconds short_connect_idle_timeout{1000};
+    // max wait for a connect, and the max time an idle client is kept alive
+    // by min_idle_connection
     std::chrono::milliseconds max_connection_time{60000};
+    // Free clients kept connected, they aren't closed when idle but replaced
+    // by new ones after max_connection_time. Missing ones are reconnected
+    // every reconnect_wait_time in the background, see warm_up().
+    uint32_t min_idle_connection = 0;
+    // connects per second of warm_up(), 0 for no limit
+    uint32_t warm_up_rate = 100;
+    // Outlier ejection, off unless eject_consecutive_failures or
+    // eject_error_rate is set. The host is ejected after
+    // eject_consecutive_failures failed requests in a row, or when at least
+    // eject_error_rate of the requests in an eject_error_rate_window failed
+    // (checked after eject_min_requests of them). A request fails if no
+    // client could connect, the operation closed its client, or the result
+    // it returned is_host_failure(). Requests to an ejected host fail at
+    // once with connection_refused, and channel skips it. When the ejection
+    // time is over, a single probe request is sent: the host is back if it
+    // succeeds, else it's ejected again for twice as long, up to
+    // max_ejection_time.
+    uint32_t eject_consecutive_failures = 0;
+    double eject_error_rate = 0;
+    uint32_t eject_min_requests = 20;
+    std::chrono::milliseconds eject_error_rate_window{10000};
+    std::chrono::milliseconds base_ejection_time{1000};
+    std::chrono::milliseconds max_ejection_time{30000};
+    // Whether the error of a result fails the host, for the outlier
+    // ejection. It's asked for the results client_t::result_errc() knows the
+    // error of, e.g. the rpc_result of coro_rpc_client. By default a timeout
+    // or an I/O error does, errors the host answered with don't.
+    std::function<bool(std::errc)> is_host_failure = default_host_failure;
     typename client_t::config client_config;
   };
 
@@ -380,8 +608,10 @@ class client_pool : public std::enable_shared_from_this<
   static std::shared_ptr<client_pool> create(
       std::string_view host_name, const pool_config& pool_config = {},
       io_context_pool_t& io_context_pool = coro_io::g_io_context_pool()) {
-    return std::make_shared<client_pool>(private_construct_token{}, host_name,
-                                         pool_config, io_context_pool);
+    auto pool = std::make_shared<client_pool>(
+        private_construct_token{}, host_name, pool_config, io_context_pool);
+    pool->start_min_idle_keeper();
+    return pool;
   }
 
   client_pool(private_construct_token t, std::string_view host_name,
@@ -406,19 +636,28 @@ class client_pool : public std::enable_shared_from_this<
       T op, typename client_t::config& client_config) {
     // return type: Lazy<expected<T::returnType,std::errc>>
     ELOG_TRACE << "try send request to " << host_name_;
+    bool is_probe = false;
+    if (!admit(is_probe)) {
+      ELOG_TRACE << "host " << host_name_ << " is ejected, fail fast.";
+      co_return return_type<T>{tl::unexpect, std::errc::connection_refused};
+    }
+    request_tracker tracker(*this, is_probe);
     auto client = co_await get_client(client_config);
     if (!client) {
       ELOG_WARN << "send request to " << host_name_
                 << " failed. connection refused.";
       co_return return_type<T>{tl::unexpect, std::errc::connection_refused};
     }
+    tracker.start_op();
     if constexpr (std::is_same_v<typename return_type<T>::value_type, void>) {
       co_await op(*client);
+      tracker.ok = !client->has_closed();
       collect_free_client(std::move(client));
       co_return return_type<T>{};
     }
     else {
       auto ret = co_await op(*client);
+      tracker.ok = !is_host_failure(*client, ret);
       collect_free_client(std::move(client));
       co_return std::move(ret);
     }
@@ -429,6 +668,45 @@ class client_pool : public std::enable_shared_from_this<
     return send_request(std::move(op), pool_config_.client_config);
   }
 
+  /**
+   * @brief connect clients until the pool has n free ones, at most
+   * pool_config.warm_up_rate per second, so that the first requests after a
+   * start or a scale-out don't all wait for handshakes.
+   *
+   * It stops at the first failed connect.
+   *
+   * @return std::size_t the count of free clients afterwards
+   */
+  async_simple::coro::Lazy<std::size_t> warm_up(std::size_t n) {
+    n = (std::min<std::size_t>)(n, pool_config_.max_connection);
+    auto interval =
+        pool_config_.warm_up_rate == 0
+            ? std::chrono::microseconds{0}
+            : std::chrono::microseconds{std::chrono::seconds{1}} /
+                  pool_config_.warm_up_rate;
+    ELOG_DEBUG << "warm up client_pool{" << host_name_ << "} to " << n
+               << " free clients";
+    // waiters may take some of them, don't connect forever.
+    for (std::size_t i = 0; i < n && free_clients_.size() < n; ++i) {
+      auto client =
+          std::make_unique<client_t>(*io_context_pool_.get_executor());
+      if (!client->init_config(pool_config_.client_config)) {
+        ELOG_ERROR << "init client config{" << client.get() << "} failed.";
+        break;
+      }
+      if (!client_t::is_ok(co_await client->connect(host_name_))) {
+        ELOG_WARN << "warm up client_pool{" << host_name_
+                  << "} failed, connect failed.";
+        break;
+      }
+      collect_free_client(std::move(client));
+      if (interval.count() > 0 && free_clients_.size() < n) {
+        co_await coro_io::sleep_for(interval);
+      }
+    }
+    co_return free_clients_.size();
+  }
+
   /**
    * @brief approx connection of client pools
    *
@@ -447,6 +725,53 @@ class client_pool : public std::enable_shared_from_this<
 
   std::string_view get_host_name() const noexcept { return host_name_; }
 
+  /**
+   * @brief number of requests sent through the pool and not finished yet
+   *
+   * @return std::size_t
+   */
+  std::size_t outstanding_requests() const noexcept {
+    return outstanding_requests_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief EWMA of the time requests spend in their operation, zero before
+   * the first one finishes.
+   *
+   * It decays toward zero while no request finishes, so that a host which
+   * has been slow is tried again after a while.
+   *
+   * @return std::chrono::nanoseconds
+   */
+  std::chrono::nanoseconds latency_ewma() const noexcept {
+    auto ewma = latency_ewma_ns_.load(std::memory_order_relaxed);
+    if (ewma == 0) {
+      return {};
+    }
+    auto idle = std::chrono::steady_clock::duration{
+        std::chrono::steady_clock::now().time_since_epoch().count() -
+        latency_updated_at_.load(std::memory_order_relaxed)};
+    if (idle <= std::chrono::steady_clock::duration::zero()) {
+      return std::chrono::nanoseconds{ewma};
+    }
+    double decay = std::exp(-std::chrono::duration<double>(idle) /
+                            std::chrono::duration<double>(latency_decay_time));
+    return std::chrono::nanoseconds{static_cast<int64_t>(ewma * decay)};
+  }
+
+  /**
+   * @brief whether the host is ejected by outlier detection, see pool_config.
+   * Requests to it fail fast, except a probe after the ejection time.
+   *
+   * @return bool
+   */
+  bool is_ejected() const noexcept {
+    auto ejected_until = ejected_until_.load(std::memory_order_acquire);
+    return ejected_until != 0 &&
+           (now_ticks() < ejected_until ||
+            probing_.load(std::memory_order_acquire));
+  }
+
  private:
   template <typename, typename>
   friend class client_pools;
@@ -460,6 +785,13 @@ class client_pool : public std::enable_shared_from_this<
       typename client_t::config& client_config) {
     // return type: Lazy<expected<T::returnType,std::errc>>
     ELOG_TRACE << "try send request to " << endpoint;
+    bool is_probe = false;
+    if (!admit(is_probe)) {
+      ELOG_TRACE << "host " << endpoint << " is ejected, fail fast.";
+      co_return return_type_with_host<T>{tl::unexpect,
+                                         std::errc::connection_refused};
+    }
+    request_tracker tracker(*this, is_probe);
     auto client = co_await get_client(client_config);
     if (!client) {
       ELOG_WARN << "send request to " << endpoint
@@ -467,14 +799,17 @@ class client_pool : public std::enable_shared_from_this<
       co_return return_type_with_host<T>{tl::unexpect,
                                          std::errc::connection_refused};
     }
+    tracker.start_op();
     if constexpr (std::is_same_v<typename return_type_with_host<T>::value_type,
                                  void>) {
       co_await op(*client, endpoint);
+      tracker.ok = !client->has_closed();
       collect_free_client(std::move(client));
       co_return return_type_with_host<T>{};
     }
     else {
       auto ret = co_await op(*client, endpoint);
+      tracker.ok = !is_host_failure(*client, ret);
       collect_free_client(std::move(client));
       co_return std::move(ret);
     }
@@ -495,6 +830,20 @@ class client_pool : public std::enable_shared_from_this<
   std::string host_name_;
   pool_config pool_config_;
   io_context_pool_t& io_context_pool_;
+  // load of the host, see outstanding_requests() and latency_ewma()
+  static constexpr auto latency_decay_time = std::chrono::seconds{10};
+  std::atomic<std::size_t> outstanding_requests_ = 0;
+  std::atomic<int64_t> latency_ewma_ns_ = 0;
+  // in steady_clock ticks
+  std::atomic<int64_t> latency_updated_at_ = 0;
+  // outlier detection, times in steady_clock ticks
+  std::atomic<uint32_t> consecutive_failures_ = 0;
+  std::atomic<uint32_t> window_requests_ = 0;
+  std::atomic<uint32_t> window_failures_ = 0;
+  std::atomic<int64_t> window_start_ = 0;
+  std::atomic<uint32_t> ejection_count_ = 0;
+  std::atomic<int64_t> ejected_until_ = 0;  // 0 if the host isn't ejected
+  std::atomic<bool> probing_ = false;
 };
 
 template <typename client_t,
@@ -561,6 +910,7 @@ class client_pools {
         if (has_inserted) {
           ELOG_DEBUG << "add new client pool of {" << host_name
                      << "} to hash table";
+          pool->start_min_idle_keeper();
         }
         else {
           ELOG_DEBUG << "add new client pool of {" << host_name
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace coro_io {
+
+/*!
+ * An adaptive limit of the requests in flight, so that a server sheds the
+ * excess load instead of letting its queues and latency grow. It's a
+ * gradient limiter: the limit grows by sqrt(limit) per window while requests
+ * take about as long as the best latency seen lately (min rtt), and shrinks
+ * in proportion as they get slower,
+ *
+ *   new_limit = limit * clamp(tolerance * min_rtt / rtt, 0.5, 1) + sqrt(limit)
+ *
+ * where rtt is the average of a window of window_size requests, and the limit
+ * moves toward new_limit by smoothing. The min rtt is learned again every
+ * min_rtt_windows windows, so it follows a changing workload.
+ *
+ * try_acquire() and release() only touch atomics, the limit is updated by
+ * the request which completes a window.
+ */
+class concurrency_limiter {
+ public:
+  struct config {
+    std::size_t initial_limit = 20;
+    std::size_t min_limit = 4;
+    std::size_t max_limit = 1000;
+    // latency up to rtt_tolerance times the min rtt doesn't shrink the limit.
+    double rtt_tolerance = 1.5;
+    // how far the limit moves toward the new one per window, in (0, 1].
+    double smoothing = 0.2;
+    std::size_t window_size = 100;
+    std::size_t min_rtt_windows = 100;
+  };
+
+  concurrency_limiter() : concurrency_limiter(config{}) {}
+
+  explicit concurrency_limiter(config conf)
+      : conf_(conf),
+        limit_value_(static_cast<double>(std::clamp(
+            conf.initial_limit, conf.min_limit, conf.max_limit))),
+        limit_(static_cast<std::size_t>(limit_value_)) {}
+
+  /*!
+   * Take a slot if fewer than limit() requests are in flight.
+   */
+  bool try_acquire() {
+    auto inflight = inflight_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (inflight > limit_.load(std::memory_order_relaxed)) {
+      inflight_.fetch_sub(1, std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+  /*!
+   * Give back the slot of a request which took rtt.
+   */
+  void release(std::chrono::steady_clock::duration rtt) {
+    auto inflight = inflight_.fetch_sub(1, std::memory_order_relaxed);
+    int64_t nanos =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(rtt).count();
+    window_rtt_sum_.fetch_add(
+        static_cast<uint64_t>((std::max)(nanos, int64_t{1})),
+        std::memory_order_relaxed);
+    auto max_inflight = window_max_inflight_.load(std::memory_order_relaxed);
+    while (inflight > max_inflight &&
+           !window_max_inflight_.compare_exchange_weak(
+               max_inflight, inflight, std::memory_order_relaxed)) {
+    }
+    if (window_count_.fetch_add(1, std::memory_order_relaxed) + 1 ==
+        conf_.window_size) {
+      end_window();
+    }
+  }
+
+  std::size_t limit() const { return limit_.load(std::memory_order_relaxed); }
+
+  std::size_t inflight() const {
+    return inflight_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  void end_window() {
+    std::lock_guard lock(mutex_);
+    auto count = window_count_.exchange(0, std::memory_order_relaxed);
+    auto rtt_sum = window_rtt_sum_.exchange(0, std::memory_order_relaxed);
+    auto max_inflight =
+        window_max_inflight_.exchange(0, std::memory_order_relaxed);
+    if (count == 0) {
+      return;
+    }
+    double rtt = static_cast<double>(rtt_sum) / count;
+
+    if (min_rtt_ == 0 || rtt < min_rtt_ ||
+        ++windows_since_min_rtt_ >= conf_.min_rtt_windows) {
+      min_rtt_ = rtt;
+      windows_since_min_rtt_ = 0;
+    }
+
+    double gradient =
+        std::clamp(conf_.rtt_tolerance * min_rtt_ / rtt, 0.5, 1.0);
+    double new_limit = limit_value_ * gradient + std::sqrt(limit_value_);
+    // don't grow a limit the load doesn't come near.
+    if (max_inflight < limit_value_ / 2) {
+      new_limit = (std::min)(new_limit, limit_value_);
+    }
+    limit_value_ = std::clamp(
+        limit_value_ * (1 - conf_.smoothing) + new_limit * conf_.smoothing,
+        static_cast<double>(conf_.min_limit),
+        static_cast<double>(conf_.max_limit));
+    limit_.store(static_cast<std::size_t>(limit_value_),
+                 std::memory_order_relaxed);
+  }
+
+  config conf_;
+  std::mutex mutex_;
+  // under mutex_
+  double limit_value_;
+  double min_rtt_ = 0;
+  std::size_t windows_since_min_rtt_ = 0;
+
+  std::atomic<std::size_t> limit_;
+  std::atomic<std::size_t> inflight_ = 0;
+  std::atomic<std::size_t> window_count_ = 0;
+  std::atomic<uint64_t> window_rtt_sum_ = 0;
+  std::atomic<std::size_t> window_max_inflight_ = 0;
+};
+
+}  // namespace coro_io
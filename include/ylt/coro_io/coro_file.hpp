@@ -16,6 +16,7 @@
 #pragma once
 #include <async_simple/Promise.h>
 #include <async_simple/Traits.h>
+#include <async_simple/coro/Collect.h>
 #include <async_simple/coro/FutureAwaiter.h>
 
 #include <cstdint>
@@ -35,6 +36,7 @@
 #include <exception>
 #include <iostream>
 #include <memory>
+#include <span>
 #include <string>
 #include <string_view>
 #include <system_error>
@@ -42,10 +44,13 @@
 #include <vector>
 
 #include "coro_io.hpp"
+#include "uring_service.hpp"
 
 #if defined(ASIO_WINDOWS)
 #include <fcntl.h>
 #include <io.h>
+#else
+#include <sys/uio.h>
 #endif
 
 namespace coro_io {
@@ -93,6 +98,11 @@ enum flags {
   create_write_trunc = O_WRONLY | O_CREAT | O_TRUNC,
   create_read_write_trunc = O_RDWR | O_CREAT | O_TRUNC,
   create_read_write_append = O_RDWR | O_CREAT | O_APPEND,
+#if defined(O_DIRECT)
+  // bypass the page cache, only with read_type::native_uring, see
+  // coro_file::direct_io_alignment.
+  direct = O_DIRECT,
+#endif
   sync_all_on_write = O_SYNC
 #endif  // defined(ASIO_WINDOWS)
 };
@@ -106,6 +116,18 @@ enum class read_type {
   fread,
 #endif
   pread,
+#if defined(YLT_HAS_NATIVE_IO_URING)
+  // async_pread/async_pwrite on the io_uring of the executor's io_context,
+  // see uring_service.
+  native_uring,
+#endif
+};
+
+// a part of a file to read, see coro_file::async_read_ranges.
+struct file_range {
+  uint64_t offset;
+  char* data;
+  size_t size;
 };
 
 class coro_file {
@@ -127,8 +149,12 @@ class coro_file {
       : executor_wrapper_(executor) {}
 #endif
 
+  // offset, buffer address and size of I/O on a file opened with
+  // flags::direct must be multiples of it.
+  static constexpr size_t direct_io_alignment = 4096;
+
   bool is_open() {
-    if (type_ == read_type::pread) {
+    if (type_ == read_type::pread || uses_native_uring()) {
       return fd_file_ != nullptr;
     }
 
@@ -169,6 +195,11 @@ class coro_file {
 
   async_simple::coro::Lazy<std::pair<std::error_code, size_t>> async_pread(
       size_t offset, char* data, size_t size) {
+#if defined(YLT_HAS_NATIVE_IO_URING)
+    if (type_ == read_type::native_uring) {
+      co_return co_await async_uring_rw(true, offset, data, size);
+    }
+#endif
     if (type_ != read_type::pread) {
       co_return std::make_pair(
           std::make_error_code(std::errc::bad_file_descriptor), 0);
@@ -197,6 +228,13 @@ class coro_file {
   async_simple::coro::Lazy<std::error_code> async_pwrite(size_t offset,
                                                          const char* data,
                                                          size_t size) {
+#if defined(YLT_HAS_NATIVE_IO_URING)
+    if (type_ == read_type::native_uring) {
+      auto result =
+          co_await async_uring_rw(false, offset, const_cast<char*>(data), size);
+      co_return result.first;
+    }
+#endif
     if (type_ != read_type::pread) {
       co_return std::make_error_code(std::errc::bad_file_descriptor);
     }
@@ -222,6 +260,114 @@ class coro_file {
     co_return result.first;
   }
 
+#if !defined(ASIO_WINDOWS)
+  /*!
+   * Read at offset into the buffers of iov in turn, with one system call.
+   * iov must stay alive until it completes. Only for read_type::pread and
+   * read_type::native_uring.
+   */
+  async_simple::coro::Lazy<std::pair<std::error_code, size_t>> async_preadv(
+      size_t offset, std::span<const iovec> iov) {
+#if defined(YLT_HAS_NATIVE_IO_URING)
+    if (type_ == read_type::native_uring) {
+      co_return co_await async_uring_rwv(true, offset, iov);
+    }
+#endif
+    if (type_ != read_type::pread) {
+      co_return std::make_pair(
+          std::make_error_code(std::errc::bad_file_descriptor), 0);
+    }
+    auto preadv = [iov](int fd, char*, size_t, size_t offset) {
+      return ::preadv(fd, iov.data(), iov.size(), offset);
+    };
+    co_return co_await async_prw(preadv, true, offset, nullptr, 0);
+  }
+
+  /*!
+   * Write the buffers of iov in turn at offset, with one system call.
+   */
+  async_simple::coro::Lazy<std::error_code> async_pwritev(
+      size_t offset, std::span<const iovec> iov) {
+#if defined(YLT_HAS_NATIVE_IO_URING)
+    if (type_ == read_type::native_uring) {
+      auto result = co_await async_uring_rwv(false, offset, iov);
+      co_return result.first;
+    }
+#endif
+    if (type_ != read_type::pread) {
+      co_return std::make_error_code(std::errc::bad_file_descriptor);
+    }
+    auto pwritev = [iov](int fd, char*, size_t, size_t offset) {
+      return ::pwritev(fd, iov.data(), iov.size(), offset);
+    };
+    auto result = co_await async_prw(pwritev, false, offset, nullptr, 0);
+    co_return result.first;
+  }
+#endif
+
+  /*!
+   * Read all the ranges at once, e.g. the parts of a multi-range http
+   * request, and complete when all are done. The i-th result is that of
+   * ranges[i], as async_pread or async_read_at would return it.
+   *
+   * With read_type::pread they are read in one trip to the block executor,
+   * with read_type::native_uring they are submitted together.
+   */
+  async_simple::coro::Lazy<std::vector<std::pair<std::error_code, size_t>>>
+  async_read_ranges(std::span<const file_range> ranges) {
+    using result_t = std::vector<std::pair<std::error_code, size_t>>;
+#if !defined(ASIO_WINDOWS)
+    if (type_ == read_type::pread) {
+      if (!fd_file_) {
+        co_return result_t(
+            ranges.size(),
+            {std::make_error_code(std::errc::bad_file_descriptor), 0});
+      }
+      auto result = co_await coro_io::post(
+          [this, ranges] {
+            result_t results;
+            results.reserve(ranges.size());
+            for (auto& range : ranges) {
+              auto len = ::pread(*fd_file_, range.data, range.size,
+                                 range.offset);
+              if (len < 0) {
+                results.emplace_back(
+                    std::error_code(errno, std::system_category()), 0);
+                continue;
+              }
+              if (len == 0) {
+                eof_ = true;
+              }
+              results.emplace_back(std::error_code{}, len);
+            }
+            return results;
+          },
+          &executor_wrapper_);
+      co_return std::move(result.value());
+    }
+#endif
+
+    std::vector<async_simple::coro::Lazy<std::pair<std::error_code, size_t>>>
+        reads;
+    reads.reserve(ranges.size());
+    for (auto& range : ranges) {
+#if defined(YLT_ENABLE_FILE_IO_URING)
+      if (type_ == read_type::uring_random) {
+        reads.push_back(async_read_at(range.offset, range.data, range.size));
+        continue;
+      }
+#endif
+      reads.push_back(async_pread(range.offset, range.data, range.size));
+    }
+    auto tries = co_await async_simple::coro::collectAll(std::move(reads));
+    result_t results;
+    results.reserve(tries.size());
+    for (auto& item : tries) {
+      results.push_back(std::move(item.value()));
+    }
+    co_return results;
+  }
+
 #if defined(YLT_ENABLE_FILE_IO_URING)
   async_simple::coro::Lazy<bool> async_open(std::string_view filepath,
                                             int open_mode = flags::read_write,
@@ -230,6 +376,11 @@ class coro_file {
     if (type_ == read_type::pread) {
       co_return open_fd(filepath, open_mode);
     }
+#if defined(YLT_HAS_NATIVE_IO_URING)
+    if (type_ == read_type::native_uring) {
+      co_return open_native_uring(filepath, open_mode);
+    }
+#endif
 
     try {
       if (type_ == read_type::uring) {
@@ -376,6 +527,11 @@ class coro_file {
     if (type_ == read_type::pread) {
       co_return open_fd(filepath, open_mode);
     }
+#if defined(YLT_HAS_NATIVE_IO_URING)
+    if (type_ == read_type::native_uring) {
+      co_return open_native_uring(filepath, open_mode);
+    }
+#endif
 
     if (stream_file_ != nullptr) {
       co_return true;
@@ -442,6 +598,115 @@ class coro_file {
 #endif
 
  private:
+  bool uses_native_uring() const {
+#if defined(YLT_HAS_NATIVE_IO_URING)
+    return type_ == read_type::native_uring;
+#else
+    return false;
+#endif
+  }
+
+#if defined(YLT_HAS_NATIVE_IO_URING)
+  bool open_native_uring(std::string_view filepath, int open_mode) {
+    if (fd_file_) {
+      return true;
+    }
+
+    auto& uring =
+        asio::use_service<uring_service>(executor_wrapper_.context());
+    if (!uring.available()) {
+      std::cout << "line " << __LINE__ << " io_uring unavailable "
+                << uring.error().message() << "\n";
+      return false;
+    }
+    int fd = ::open(std::string(filepath).data(), open_mode, 0644);
+    if (fd < 0) {
+      return false;
+    }
+
+    uring_ = &uring;
+    uring_slot_ = uring.register_file(fd);
+#if defined(O_DIRECT)
+    direct_ = open_mode & O_DIRECT;
+#endif
+    // the file may be closed after its io_context, and the service, are gone.
+    fd_file_ = std::shared_ptr<int>(
+        new int(fd),
+        [unregister = uring.file_unregisterer(uring_slot_),
+         slot = uring_slot_](int* ptr) {
+          if (slot >= 0) {
+            unregister();
+          }
+          ::close(*ptr);
+          delete ptr;
+        });
+    return true;
+  }
+
+  async_simple::coro::Lazy<std::pair<std::error_code, size_t>> async_uring_rw(
+      bool is_read, size_t offset, char* buf, size_t size) {
+    if (!fd_file_) {
+      co_return std::make_pair(
+          std::make_error_code(std::errc::bad_file_descriptor), 0);
+    }
+    if (!direct_io_aligned(offset, buf, size)) {
+      co_return std::make_pair(
+          std::make_error_code(std::errc::invalid_argument), 0);
+    }
+
+    // the kernel transfers at most 2GB less a page at once anyway.
+    constexpr size_t max_size = 0x7ffff000;
+    int len = co_await uring_->async_rw(
+        is_read, *fd_file_, uring_slot_, offset, buf,
+        static_cast<uint32_t>((std::min)(size, max_size)));
+    co_return uring_result(is_read, len);
+  }
+
+  async_simple::coro::Lazy<std::pair<std::error_code, size_t>> async_uring_rwv(
+      bool is_read, size_t offset, std::span<const iovec> iov) {
+    if (!fd_file_) {
+      co_return std::make_pair(
+          std::make_error_code(std::errc::bad_file_descriptor), 0);
+    }
+    for (auto& vec : iov) {
+      if (!direct_io_aligned(offset, static_cast<char*>(vec.iov_base),
+                             vec.iov_len)) {
+        co_return std::make_pair(
+            std::make_error_code(std::errc::invalid_argument), 0);
+      }
+    }
+
+    int len = co_await uring_->async_rwv(is_read, *fd_file_, uring_slot_,
+                                         offset, iov.data(), iov.size());
+    co_return uring_result(is_read, len);
+  }
+
+  bool direct_io_aligned(size_t offset, const char* buf, size_t size) const {
+    auto aligned = [](size_t n) {
+      return n % direct_io_alignment == 0;
+    };
+    return !direct_ || (aligned(offset) && aligned(size) &&
+                        aligned(reinterpret_cast<uintptr_t>(buf)));
+  }
+
+  std::pair<std::error_code, size_t> uring_result(bool is_read, int len) {
+    std::error_code ec{};
+    size_t op_size = 0;
+    if (len == 0) {
+      if (is_read) {
+        eof_ = true;
+      }
+    }
+    else if (len > 0) {
+      op_size = len;
+    }
+    else {
+      ec = std::error_code(-len, std::system_category());
+    }
+    return std::make_pair(ec, op_size);
+  }
+#endif
+
   async_simple::coro::Lazy<std::pair<std::error_code, size_t>> async_prw(
       auto io_func, bool is_read, size_t offset, char* buf, size_t size) {
     std::function<int()> func = [=, this] {
@@ -537,5 +802,10 @@ class coro_file {
   coro_io::ExecutorWrapper<> executor_wrapper_;
   std::shared_ptr<int> fd_file_;
   std::atomic<bool> eof_ = false;
+#if defined(YLT_HAS_NATIVE_IO_URING)
+  uring_service* uring_ = nullptr;
+  int uring_slot_ = -1;
+  bool direct_ = false;
+#endif
 };
 }  // namespace coro_io
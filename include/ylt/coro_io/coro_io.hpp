@@ -24,6 +24,7 @@
 #include <asio/ssl.hpp>
 #endif
 
+#include <asio/buffered_read_stream.hpp>
 #include <asio/connect.hpp>
 #include <asio/dispatch.hpp>
 #include <asio/experimental/channel.hpp>
@@ -35,6 +36,8 @@
 #include <asio/write_at.hpp>
 #include <chrono>
 #include <deque>
+#include <string>
+#include <vector>
 
 #include "io_context_pool.hpp"
 #include "ylt/util/type_traits.h"
@@ -117,6 +120,35 @@ template <>
 class callback_awaitor<void>
     : public callback_awaitor_base<void, callback_awaitor<void>> {};
 
+#ifdef SO_REUSEPORT
+/*!
+ * SO_REUSEPORT: several sockets may bind the same port, and the kernel spreads
+ * new connections among their listen queues.
+ */
+using reuse_port =
+    asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+inline constexpr bool has_reuse_port = true;
+#else
+inline constexpr bool has_reuse_port = false;
+#endif
+
+template <typename Socket>
+inline void set_reuse_port(Socket &socket, asio::error_code &ec) {
+#ifdef SO_REUSEPORT
+  socket.set_option(reuse_port(true), ec);
+#else
+  ec = asio::error::operation_not_supported;
+#endif
+}
+
+// the ip of the peer, empty if it isn't connected.
+template <typename Socket>
+inline std::string remote_ip(const Socket &socket) {
+  asio::error_code ec;
+  auto endpoint = socket.remote_endpoint(ec);
+  return ec ? std::string{} : endpoint.address().to_string();
+}
+
 inline async_simple::coro::Lazy<std::error_code> async_accept(
     asio::ip::tcp::acceptor &acceptor, asio::ip::tcp::socket &socket) noexcept {
   callback_awaitor<std::error_code> awaitor;
@@ -162,6 +194,63 @@ inline async_simple::coro::Lazy<std::pair<std::error_code, size_t>> async_read(
   });
 }
 
+/*!
+ * reads larger than this bypass the buffer of a buffered_read_stream, see
+ * async_read(asio::buffered_read_stream<Stream> &, AsioBuffer &&).
+ */
+inline constexpr std::size_t default_read_buffer_size = 8192;
+
+/*!
+ * Read exactly `asio::buffer_size(buffer)` bytes from a buffered stream.
+ *
+ * If the buffer already holds enough data the read is served by a copy and
+ * never suspends, so several small pipelined messages cost one recv. Small
+ * reads refill the buffer with as much as the socket has available. For a
+ * read whose unbuffered part is at least default_read_buffer_size, the
+ * buffered prefix is copied and the rest is read from the next layer
+ * directly to avoid copying big payloads twice.
+ */
+template <typename Stream, typename AsioBuffer>
+inline async_simple::coro::Lazy<std::pair<std::error_code, size_t>> async_read(
+    asio::buffered_read_stream<Stream> &stream, AsioBuffer &&buffer) noexcept {
+  std::error_code ec;
+  const std::size_t size = asio::buffer_size(buffer);
+  const std::size_t avail = stream.in_avail(ec);
+  if (avail >= size) {
+    auto n = asio::read(stream, buffer, ec);
+    co_return std::make_pair(ec, n);
+  }
+  if (size - avail < default_read_buffer_size) {
+    callback_awaitor<std::pair<std::error_code, size_t>> awaitor;
+    co_return co_await awaitor.await_resume([&](auto handler) {
+      asio::async_read(stream, buffer, [&, handler](const auto &ec, auto n) {
+        handler.set_value_then_resume(ec, n);
+      });
+    });
+  }
+  std::size_t copied = 0;
+  if (avail > 0) {
+    copied = asio::read(stream, buffer, asio::transfer_exactly(avail), ec);
+    if (ec) {
+      co_return std::make_pair(ec, copied);
+    }
+  }
+  std::vector<asio::mutable_buffer> rest;
+  std::size_t skip = copied;
+  for (auto it = asio::buffer_sequence_begin(buffer);
+       it != asio::buffer_sequence_end(buffer); ++it) {
+    asio::mutable_buffer b = *it;
+    if (skip >= b.size()) {
+      skip -= b.size();
+      continue;
+    }
+    rest.push_back(b + skip);
+    skip = 0;
+  }
+  auto [read_ec, n] = co_await async_read(stream.next_layer(), rest);
+  co_return std::make_pair(read_ec, copied + n);
+}
+
 template <typename Socket, typename AsioBuffer>
 inline async_simple::coro::Lazy<std::pair<std::error_code, size_t>> async_read(
     Socket &socket, AsioBuffer &buffer, size_t size_to_read) noexcept {
@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include <async_simple/coro/Lazy.h>
+
+#include "coro_io.hpp"
+#include "io_context_pool.hpp"
+
+#if !defined(ASIO_WINDOWS)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace coro_io {
+
+/*!
+ * A read only file mapped into memory, for hot read mostly files such as
+ * static assets or struct_pack snapshots. Reads return views of the page
+ * cache instead of copying into a buffer:
+ *
+ * ```cpp
+ * coro_io::coro_mmap_file file;
+ * co_await file.async_open("model.bin");
+ * co_await file.async_prefetch(coro_io::coro_mmap_file::advice::sequential);
+ * auto header = file.read_at(0, 64);
+ * ```
+ *
+ * When the file grows, remap() maps it again. Views returned by read_at()
+ * are only valid while a mapping() they come from is held: a remap() or
+ * close() on another thread unmaps the old mapping once nothing holds it.
+ * Readers racing with them should read through mapping()->view(). The file
+ * must not shrink while it's mapped.
+ */
+class coro_mmap_file {
+ public:
+  enum class advice {
+    normal = MADV_NORMAL,
+    sequential = MADV_SEQUENTIAL,
+    random = MADV_RANDOM,
+    willneed = MADV_WILLNEED,
+    dontneed = MADV_DONTNEED,
+  };
+
+  /*!
+   * One mapping of the file, unmapped once the file and every holder of it
+   * have released it.
+   */
+  struct region {
+    region(char* data, size_t size) : data(data), size(size) {}
+    region(const region&) = delete;
+    region& operator=(const region&) = delete;
+    ~region() {
+      if (size != 0) {
+        munmap(data, size);
+      }
+    }
+
+    std::string_view view() const { return {data, size}; }
+
+    char* const data;
+    const size_t size;
+  };
+
+  coro_mmap_file(coro_io::ExecutorWrapper<>* executor =
+                     coro_io::get_global_block_executor())
+      : executor_(executor) {}
+
+  coro_mmap_file(const coro_mmap_file&) = delete;
+  coro_mmap_file& operator=(const coro_mmap_file&) = delete;
+
+  ~coro_mmap_file() { close(); }
+
+  async_simple::coro::Lazy<bool> async_open(std::string filepath) {
+    if (is_open()) {
+      co_return true;
+    }
+
+    auto result = co_await coro_io::post(
+        [this, &filepath] {
+          int fd = ::open(filepath.data(), O_RDONLY | O_CLOEXEC);
+          if (fd < 0) {
+            std::cout << "line " << __LINE__ << " coro_mmap_file open failed "
+                      << filepath << "\n";
+            return false;
+          }
+          std::lock_guard lock(mutex_);
+          fd_ = fd;
+          if (!map_locked()) {
+            ::close(fd_);
+            fd_ = -1;
+            return false;
+          }
+          return true;
+        },
+        executor_);
+    co_return result.value();
+  }
+
+  bool is_open() const { return load() != nullptr; }
+
+  /*!
+   * Release the mapping, views returned by read_at() become invalid. A
+   * mapping() held elsewhere stays mapped until it's released.
+   */
+  void close() {
+    std::lock_guard lock(mutex_);
+    store(nullptr);
+    if (fd_ >= 0) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  size_t size() const {
+    auto region = load();
+    return region ? region->size : 0;
+  }
+
+  std::string_view view() const { return read_at(0, size()); }
+
+  /*!
+   * The current mapping, null if the file isn't open.
+   */
+  std::shared_ptr<const region> mapping() const { return load(); }
+
+  /*!
+   * At most size bytes from offset, empty past the end of the file. The view
+   * is unmapped by a concurrent remap() or close() unless a mapping() is
+   * held.
+   */
+  std::string_view read_at(size_t offset, size_t size) const {
+    auto region = load();
+    if (region == nullptr || offset >= region->size) {
+      return {};
+    }
+    return {region->data + offset, (std::min)(size, region->size - offset)};
+  }
+
+  /*!
+   * Map the file again if it has grown since it was mapped, and return false
+   * if that failed. The old mapping is released, views of it stay valid only
+   * while a mapping() of it is held.
+   */
+  bool remap() {
+    std::lock_guard lock(mutex_);
+    if (fd_ < 0) {
+      return false;
+    }
+    return map_locked();
+  }
+
+  /*!
+   * madvise the range from offset on the block executor, e.g.
+   * advice::willneed to start reading it ahead without waiting for it.
+   */
+  async_simple::coro::Lazy<std::error_code> async_prefetch(
+      size_t offset, size_t size, advice how = advice::willneed) {
+    // held until madvise is done, so that a remap() or close() meanwhile
+    // doesn't unmap the range under it.
+    auto region = mapping();
+    if (region == nullptr) {
+      co_return std::make_error_code(std::errc::bad_file_descriptor);
+    }
+    if (offset >= region->size) {
+      co_return std::error_code{};
+    }
+    // madvise wants a page aligned address.
+    static const size_t page_size = sysconf(_SC_PAGESIZE);
+    size = (std::min)(size, region->size - offset);
+    size_t begin = offset / page_size * page_size;
+    auto advise = [region, begin, length = offset + size - begin, how] {
+      if (madvise(region->data + begin, length, static_cast<int>(how)) != 0) {
+        return std::error_code(errno, std::system_category());
+      }
+      return std::error_code{};
+    };
+    auto result = co_await coro_io::post(std::move(advise), executor_);
+    co_return result.value();
+  }
+
+  async_simple::coro::Lazy<std::error_code> async_prefetch(
+      advice how = advice::willneed) {
+    return async_prefetch(0, size(), how);
+  }
+
+ private:
+  bool map_locked() {
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+      return false;
+    }
+    size_t size = st.st_size;
+    auto current = load();
+    if (current && size <= current->size) {
+      return true;
+    }
+
+    // an empty file can't be mapped, it's an empty region.
+    char* data = nullptr;
+    if (size != 0) {
+      void* ptr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd_, 0);
+      if (ptr == MAP_FAILED) {
+        return false;
+      }
+      data = static_cast<char*>(ptr);
+    }
+    store(std::make_shared<const region>(data, size));
+    return true;
+  }
+
+#if defined(__cpp_lib_atomic_shared_ptr)
+  std::shared_ptr<const region> load() const {
+    return current_.load(std::memory_order_acquire);
+  }
+  void store(std::shared_ptr<const region> region) {
+    current_.store(std::move(region), std::memory_order_release);
+  }
+#else
+  std::shared_ptr<const region> load() const {
+    return std::atomic_load_explicit(&current_, std::memory_order_acquire);
+  }
+  void store(std::shared_ptr<const region> region) {
+    std::atomic_store_explicit(&current_, std::move(region),
+                               std::memory_order_release);
+  }
+#endif
+
+  coro_io::ExecutorWrapper<>* executor_;
+  // serializes open, remap() and close(), readers only load current_.
+  std::mutex mutex_;
+  int fd_ = -1;
+#if defined(__cpp_lib_atomic_shared_ptr)
+  std::atomic<std::shared_ptr<const region>> current_;
+#else
+  std::shared_ptr<const region> current_;
+#endif
+};
+
+}  // namespace coro_io
+#endif
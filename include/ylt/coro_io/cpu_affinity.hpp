@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace coro_io {
+
+/*!
+ * Where the io threads of a pool run. Thread i is pinned to the i-th CPU of
+ * resolve(), wrapping around.
+ *
+ * ```cpp
+ * // reactors on the NIC's node, one per physical core.
+ * coro_io::cpu_affinity_policy policy;
+ * policy.numa_node = 1;  // cat /sys/class/net/eth0/device/numa_node
+ * policy.skip_hyperthread_siblings = true;
+ * coro_io::io_context_pool pool(8, policy);
+ * ```
+ */
+struct cpu_affinity_policy {
+  // CPU ids to use, in order. Empty for every CPU the process may run on. An
+  // explicit list is used as is, so it may name isolcpus.
+  std::vector<int> cpus;
+  // only keep the CPUs of this NUMA node, -1 for any node.
+  int numa_node = -1;
+  // only keep the first hardware thread of each core.
+  bool skip_hyperthread_siblings = false;
+  // each io thread allocates from its own node (MPOL_LOCAL), even if the
+  // process runs with another memory policy, e.g. under numactl --interleave.
+  // Buffers a thread first touches, like the read buffers of its
+  // connections, then stay on its node.
+  bool numa_local_memory = true;
+
+  /*!
+   * The CPUs threads are pinned to, empty if nothing is left after filtering
+   * (threads are then not pinned).
+   */
+  std::vector<int> resolve() const;
+};
+
+namespace detail {
+// parse a sysfs cpu list, e.g. "0-3,8,10-11".
+inline std::vector<int> parse_cpu_list(std::string_view list) {
+  std::vector<int> cpus;
+  while (!list.empty()) {
+    auto pos = list.find(',');
+    auto item = list.substr(0, pos);
+    list = pos == std::string_view::npos ? std::string_view{}
+                                         : list.substr(pos + 1);
+    while (!item.empty() && (item.back() == '\n' || item.back() == ' ')) {
+      item.remove_suffix(1);
+    }
+    if (item.empty()) {
+      continue;
+    }
+    auto dash = item.find('-');
+    int first = std::atoi(std::string(item.substr(0, dash)).data());
+    int last = dash == std::string_view::npos
+                   ? first
+                   : std::atoi(std::string(item.substr(dash + 1)).data());
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+// empty if the file can't be read.
+inline std::vector<int> read_cpu_list(const std::string &path) {
+  std::ifstream file(path);
+  std::string list;
+  if (!file || !std::getline(file, list)) {
+    return {};
+  }
+  return parse_cpu_list(list);
+}
+
+// the CPUs the process may run on.
+inline std::vector<int> allowed_cpus() {
+  std::vector<int> cpus;
+#ifdef __linux__
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  if (sched_getaffinity(0, sizeof(cpuset), &cpuset) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &cpuset)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+#endif
+  return cpus;
+}
+}  // namespace detail
+
+inline std::vector<int> cpu_affinity_policy::resolve() const {
+  std::vector<int> result = cpus.empty() ? detail::allowed_cpus() : cpus;
+  if (numa_node >= 0) {
+    auto node_cpus = detail::read_cpu_list("/sys/devices/system/node/node" +
+                                           std::to_string(numa_node) +
+                                           "/cpulist");
+    std::erase_if(result, [&](int cpu) {
+      return std::find(node_cpus.begin(), node_cpus.end(), cpu) ==
+             node_cpus.end();
+    });
+  }
+  if (skip_hyperthread_siblings) {
+    std::set<std::vector<int>> cores;
+    std::erase_if(result, [&](int cpu) {
+      auto siblings = detail::read_cpu_list(
+          "/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
+          "/topology/thread_siblings_list");
+      if (siblings.empty()) {
+        siblings.push_back(cpu);
+      }
+      return !cores.insert(std::move(siblings)).second;
+    });
+  }
+  return result;
+}
+
+/*!
+ * Pin the calling thread to cpu, and with numa_local_memory make it allocate
+ * from its own node. Returns false if pinning failed.
+ */
+inline bool bind_current_thread(int cpu, bool numa_local_memory) {
+#ifdef __linux__
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(cpu, &cpuset);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) !=
+      0) {
+    return false;
+  }
+#ifdef SYS_set_mempolicy
+  if (numa_local_memory) {
+    constexpr int mpol_local = 4;  // MPOL_LOCAL of <linux/mempolicy.h>
+    // fails on kernels without NUMA, where memory is local anyway.
+    (void)syscall(SYS_set_mempolicy, mpol_local, nullptr, 0);
+  }
+#endif
+  return true;
+#else
+  (void)cpu;
+  (void)numa_local_memory;
+  return false;
+#endif
+}
+
+}  // namespace coro_io
@@ -21,16 +21,17 @@
 #include <asio/post.hpp>
 #include <asio/steady_timer.hpp>
 #include <atomic>
+#include <chrono>
+#include <deque>
 #include <future>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <thread>
 #include <type_traits>
 #include <vector>
-#ifdef __linux__
-#include <pthread.h>
-#include <sched.h>
-#endif
+
+#include "cpu_affinity.hpp"
 
 namespace coro_io {
 
@@ -112,10 +113,19 @@ class io_context_pool {
  public:
   using executor_type = asio::io_context::executor_type;
   explicit io_context_pool(std::size_t pool_size, bool cpu_affinity = false)
-      : next_io_context_(0), cpu_affinity_(cpu_affinity) {
+      : next_io_context_(0) {
     if (pool_size == 0) {
       pool_size = 1;  // set default value as 1
     }
+    if (cpu_affinity) {
+      // thread i on CPU i.
+      cpu_affinity_policy policy;
+      for (std::size_t i = 0; i < pool_size; ++i) {
+        policy.cpus.push_back(static_cast<int>(i));
+      }
+      policy.numa_local_memory = false;
+      cpu_affinity_ = std::move(policy);
+    }
 
     for (std::size_t i = 0; i < pool_size; ++i) {
       io_context_ptr io_context(new asio::io_context(1));
@@ -128,6 +138,16 @@ class io_context_pool {
     }
   }
 
+  io_context_pool(std::size_t pool_size, cpu_affinity_policy policy)
+      : io_context_pool(pool_size) {
+    cpu_affinity_ = std::move(policy);
+  }
+
+  // call it before run().
+  void set_cpu_affinity(cpu_affinity_policy policy) {
+    cpu_affinity_ = std::move(policy);
+  }
+
   void run() {
     bool has_run_or_stop = false;
     bool ok = has_run_or_stop_.compare_exchange_strong(has_run_or_stop, true);
@@ -135,25 +155,27 @@ class io_context_pool {
       return;
     }
 
+    std::vector<int> cpus;
+    bool numa_local_memory = false;
+    if (cpu_affinity_) {
+      cpus = cpu_affinity_->resolve();
+      numa_local_memory = cpu_affinity_->numa_local_memory;
+    }
     std::vector<std::shared_ptr<std::thread>> threads;
     for (std::size_t i = 0; i < io_contexts_.size(); ++i) {
+      int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
       threads.emplace_back(std::make_shared<std::thread>(
-          [](io_context_ptr svr) {
+          [cpu, numa_local_memory](io_context_ptr svr) {
+            // pin before running anything, so that the thread's allocations
+            // land on its node.
+            if (cpu >= 0) {
+              bind_current_thread(cpu, numa_local_memory);
+            }
             auto ctx = get_current();
             *ctx = svr.get();
             svr->run();
           },
           io_contexts_[i]));
-
-#ifdef __linux__
-      if (cpu_affinity_) {
-        cpu_set_t cpuset;
-        CPU_ZERO(&cpuset);
-        CPU_SET(i, &cpuset);
-        pthread_setaffinity_np(threads.back()->native_handle(),
-                               sizeof(cpu_set_t), &cpuset);
-      }
-#endif
     }
 
     for (std::size_t i = 0; i < threads.size(); ++i) {
@@ -198,6 +220,11 @@ class io_context_pool {
     return ret;
   }
 
+  // the executor of the index-th io_context, regardless of round-robin.
+  coro_io::ExecutorWrapper<> *get_executor(std::size_t index) {
+    return executors[index % io_contexts_.size()].get();
+  }
+
   template <typename T>
   friend io_context_pool &g_io_context_pool();
 
@@ -212,7 +239,7 @@ class io_context_pool {
   std::promise<void> promise_;
   std::atomic<bool> has_run_or_stop_ = false;
   std::once_flag flag_;
-  bool cpu_affinity_ = false;
+  std::optional<cpu_affinity_policy> cpu_affinity_;
 };
 
 class multithread_context_pool {
@@ -258,6 +285,406 @@ class multithread_context_pool {
   std::promise<void> promise_;
 };
 
+class work_stealing_executor_pool;
+
+/*!
+ * An executor of work_stealing_executor_pool: a strand homed on one io_context.
+ *
+ * Sockets and timers created from get_asio_executor() are registered in that
+ * io_context's reactor, but their completion handlers, like the functions
+ * given to schedule(), are queued on the strand. The tasks of a strand run one
+ * at a time, so a connection keeps the single-threaded view it has with
+ * io_context_pool, while the strand itself may be run by any thread of the
+ * pool.
+ */
+class work_stealing_executor : public async_simple::Executor {
+ public:
+  using context_t = asio::io_context;
+
+  /*!
+   * The asio executor of the strand, for sockets and timers.
+   */
+  class executor_type {
+   public:
+    explicit executor_type(work_stealing_executor *executor) noexcept
+        : executor_(executor) {}
+
+    asio::io_context &query(asio::execution::context_t) const noexcept {
+      return executor_->ctx_;
+    }
+
+    static constexpr asio::execution::blocking_t query(
+        asio::execution::blocking_t) noexcept {
+      return asio::execution::blocking.never;
+    }
+
+    template <typename F>
+    void execute(F &&f) const {
+      using handler_t = std::decay_t<F>;
+      if constexpr (std::is_copy_constructible_v<handler_t>) {
+        executor_->enqueue(Func(std::forward<F>(f)));
+      }
+      else {
+        // Func must be copyable, asio's handlers may be move only.
+        executor_->enqueue(
+            [handler = std::make_shared<handler_t>(std::forward<F>(f))] {
+              (*handler)();
+            });
+      }
+    }
+
+    friend bool operator==(const executor_type &a,
+                           const executor_type &b) noexcept {
+      return a.executor_ == b.executor_;
+    }
+    friend bool operator!=(const executor_type &a,
+                           const executor_type &b) noexcept {
+      return a.executor_ != b.executor_;
+    }
+
+   private:
+    work_stealing_executor *executor_;
+  };
+
+  work_stealing_executor(work_stealing_executor_pool &pool,
+                         asio::io_context &ctx, std::size_t home)
+      : pool_(pool), ctx_(ctx), home_(home) {}
+
+  virtual bool schedule(Func func) override {
+    enqueue(std::move(func));
+    return true;
+  }
+
+  // a coroutine goes back to the strand it was checked out from, not to
+  // another strand on the same io_context.
+  virtual bool checkin(Func func, void *ctx) override {
+    static_cast<work_stealing_executor *>(ctx)->enqueue(std::move(func));
+    return true;
+  }
+  virtual void *checkout() override { return this; }
+
+  context_t &context() { return ctx_; }
+
+  executor_type get_asio_executor() { return executor_type{this}; }
+
+  // for get_current_executor<work_stealing_executor>().
+  executor_type get_executor() { return executor_type{this}; }
+
+  bool currentThreadInExecutor() const override { return running() == this; }
+
+  size_t currentContextId() const override {
+    if (running() == this) {
+      return (size_t)&ctx_;
+    }
+    auto ptr = *get_current();
+    return ptr ? (size_t)ptr : 0;
+  }
+
+ private:
+  friend class work_stealing_executor_pool;
+  using tracked_work_t = std::decay_t<decltype(asio::require(
+      std::declval<asio::io_context &>().get_executor(),
+      asio::execution::outstanding_work.tracked))>;
+
+  void schedule(Func func, Duration dur) override {
+    auto timer = std::make_unique<asio::steady_timer>(get_asio_executor(), dur);
+    auto tm = timer.get();
+    tm->async_wait([fn = std::move(func),
+                    timer = std::move(timer)](const std::error_code &) {
+      fn();
+    });
+  }
+
+  static work_stealing_executor *&running() {
+    static thread_local work_stealing_executor *current = nullptr;
+    return current;
+  }
+
+  void enqueue(Func func);
+
+  // Run at most `batch` tasks, then hand the strand back to the pool if more
+  // are queued. Returns the number of tasks run.
+  std::size_t run_tasks(std::size_t batch);
+
+  work_stealing_executor_pool &pool_;
+  asio::io_context &ctx_;
+  std::size_t home_;
+  std::mutex mtx_;
+  std::deque<Func> tasks_;
+  // true while the strand is in a ready queue or being run, so only one
+  // thread runs it at a time.
+  bool scheduled_ = false;
+  // keeps the io_context running while the strand has tasks.
+  std::optional<tracked_work_t> work_;
+};
+
+/*!
+ * An executor pool for servers whose handlers mix short and long requests.
+ *
+ * Like io_context_pool, thread i runs io_context i, the reactor of the sockets
+ * created on it. But the pool hands out strands_per_thread strands on each
+ * io_context instead of the io_context itself, and a strand with tasks waits
+ * in the ready queue of its thread. A thread runs its own ready strands
+ * first, and when it has none it takes the oldest ready strand of another
+ * thread; the reactor of the other thread is never run by a thief. So a long
+ * handler only holds up the connections of its own strand, the rest of its
+ * thread's strands are run by the idle threads. A strand runs at most
+ * max_batch tasks at a time before it goes back to its queue.
+ *
+ * An idle thread blocks in its own io_context until an I/O event or a task
+ * for it arrives, a thread queueing a strand wakes its home thread, or an
+ * idle one when the home thread is busy.
+ */
+class work_stealing_executor_pool {
+ public:
+  using executor_type = work_stealing_executor::executor_type;
+
+  explicit work_stealing_executor_pool(std::size_t pool_size,
+                                       std::size_t strands_per_thread = 16,
+                                       std::size_t max_batch = 64)
+      : max_batch_(max_batch) {
+    if (pool_size == 0) {
+      pool_size = 1;
+    }
+    if (strands_per_thread == 0) {
+      strands_per_thread = 1;
+    }
+    if (max_batch_ == 0) {
+      max_batch_ = 1;
+    }
+
+    for (std::size_t i = 0; i < pool_size; ++i) {
+      auto worker = std::make_unique<worker_t>();
+      work_.push_back(std::make_unique<asio::io_context::work>(worker->ctx));
+      workers_.push_back(std::move(worker));
+    }
+    // consecutive executors live on different io_contexts.
+    for (std::size_t i = 0; i < pool_size * strands_per_thread; ++i) {
+      executors_.push_back(std::make_unique<work_stealing_executor>(
+          *this, workers_[i % pool_size]->ctx, i % pool_size));
+    }
+  }
+
+  void run() {
+    bool has_run_or_stop = false;
+    bool ok = has_run_or_stop_.compare_exchange_strong(has_run_or_stop, true);
+    if (!ok) {
+      return;
+    }
+
+    std::vector<int> cpus;
+    if (cpu_affinity_) {
+      cpus = cpu_affinity_->resolve();
+    }
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < workers_.size(); ++i) {
+      int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+      threads.emplace_back([this, i, cpu] {
+        if (cpu >= 0) {
+          bind_current_thread(cpu, cpu_affinity_->numa_local_memory);
+        }
+        run_worker(i);
+      });
+    }
+    for (auto &thd : threads) {
+      thd.join();
+    }
+    promise_.set_value();
+  }
+
+  void stop() {
+    std::call_once(flag_, [this] {
+      bool has_run_or_stop = false;
+      bool ok = has_run_or_stop_.compare_exchange_strong(has_run_or_stop, true);
+
+      work_.clear();
+
+      if (ok) {
+        // clear all unfinished work
+        drain();
+        return;
+      }
+
+      promise_.get_future().wait();
+    });
+  }
+
+  ~work_stealing_executor_pool() {
+    if (!has_stop())
+      stop();
+  }
+
+  std::size_t pool_size() const noexcept { return workers_.size(); }
+
+  bool has_stop() const { return work_.empty(); }
+
+  work_stealing_executor *get_executor() {
+    auto i = next_executor_.fetch_add(1, std::memory_order::relaxed);
+    return executors_[i % executors_.size()].get();
+  }
+
+  // call it before run().
+  void set_cpu_affinity(cpu_affinity_policy policy) {
+    cpu_affinity_ = std::move(policy);
+  }
+
+  // tasks a thread ran for a strand of another thread.
+  std::size_t stolen_count() const noexcept {
+    return stolen_count_.load(std::memory_order::relaxed);
+  }
+
+ private:
+  friend class work_stealing_executor;
+
+  struct worker_t {
+    // several threads may post to one io_context, keep its default locking.
+    asio::io_context ctx;
+    std::mutex mtx;
+    std::deque<work_stealing_executor *> ready;
+    // set while the thread blocks in ctx without a ready strand.
+    std::atomic<bool> idle = false;
+  };
+
+  static std::size_t &current_worker() {
+    static thread_local std::size_t index = SIZE_MAX;
+    return index;
+  }
+
+  // queue a strand with tasks on its home thread.
+  void push_ready(std::size_t home, work_stealing_executor *executor) {
+    {
+      auto &worker = *workers_[home];
+      std::lock_guard lock(worker.mtx);
+      worker.ready.push_back(executor);
+      ready_count_.fetch_add(1);
+    }
+    // the home thread, or else any idle thread, picks it up.
+    for (std::size_t k = 0; k < workers_.size(); ++k) {
+      auto &worker = *workers_[(home + k) % workers_.size()];
+      if (worker.idle.exchange(false)) {
+        asio::post(worker.ctx, [] {
+        });
+        return;
+      }
+    }
+  }
+
+  // the oldest ready strand of this thread, or else of another one.
+  work_stealing_executor *take_ready(std::size_t index) {
+    for (std::size_t k = 0; k < workers_.size(); ++k) {
+      auto &worker = *workers_[(index + k) % workers_.size()];
+      std::lock_guard lock(worker.mtx);
+      if (!worker.ready.empty()) {
+        auto executor = worker.ready.front();
+        worker.ready.pop_front();
+        ready_count_.fetch_sub(1);
+        return executor;
+      }
+    }
+    return nullptr;
+  }
+
+  void run_worker(std::size_t index) {
+    auto &worker = *workers_[index];
+    *get_current() = &worker.ctx;
+    current_worker() = index;
+    while (true) {
+      // completions queue their handlers on the strands, it doesn't block.
+      worker.ctx.poll();
+      if (auto executor = take_ready(index)) {
+        executor->run_tasks(max_batch_);
+        continue;
+      }
+      worker.idle.store(true);
+      // a strand queued before idle was set hasn't woken this thread.
+      if (ready_count_.load() > 0) {
+        worker.idle.store(false);
+        continue;
+      }
+      auto handled = worker.ctx.run_one();
+      worker.idle.store(false);
+      if (handled == 0) {
+        // stopped, and no strand of this io_context has tasks left.
+        break;
+      }
+    }
+  }
+
+  // run everything left on the calling thread, for stop() without run().
+  void drain() {
+    bool has_work = true;
+    while (has_work) {
+      has_work = false;
+      for (std::size_t i = 0; i < workers_.size(); ++i) {
+        has_work |= workers_[i]->ctx.poll() > 0;
+        while (auto executor = take_ready(i)) {
+          executor->run_tasks(max_batch_);
+          has_work = true;
+        }
+      }
+    }
+  }
+
+  std::vector<std::unique_ptr<worker_t>> workers_;
+  std::vector<std::unique_ptr<work_stealing_executor>> executors_;
+  std::vector<std::unique_ptr<asio::io_context::work>> work_;
+  std::atomic<std::size_t> next_executor_ = 0;
+  std::atomic<std::size_t> ready_count_ = 0;
+  std::atomic<std::size_t> stolen_count_ = 0;
+  std::size_t max_batch_;
+  std::optional<cpu_affinity_policy> cpu_affinity_;
+  std::promise<void> promise_;
+  std::atomic<bool> has_run_or_stop_ = false;
+  std::once_flag flag_;
+};
+
+inline void work_stealing_executor::enqueue(Func func) {
+  {
+    std::lock_guard lock(mtx_);
+    tasks_.push_back(std::move(func));
+    if (scheduled_) {
+      return;
+    }
+    scheduled_ = true;
+    work_.emplace(asio::require(ctx_.get_executor(),
+                                asio::execution::outstanding_work.tracked));
+  }
+  pool_.push_ready(home_, this);
+}
+
+inline std::size_t work_stealing_executor::run_tasks(std::size_t batch) {
+  auto &current = running();
+  auto prev = std::exchange(current, this);
+  bool stolen = work_stealing_executor_pool::current_worker() != home_;
+  std::size_t count = 0;
+  bool has_more = true;
+  while (count < batch) {
+    Func task;
+    {
+      std::lock_guard lock(mtx_);
+      if (tasks_.empty()) {
+        scheduled_ = false;
+        work_.reset();
+        has_more = false;
+        break;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    if (stolen) {
+      pool_.stolen_count_.fetch_add(1, std::memory_order::relaxed);
+    }
+    task();
+    ++count;
+  }
+  current = prev;
+  if (has_more) {
+    // give the other strands a turn.
+    pool_.push_ready(home_, this);
+  }
+  return count;
+}
+
 template <typename T = io_context_pool>
 inline T &g_io_context_pool(
     unsigned pool_size = std::thread::hardware_concurrency()) {
@@ -20,8 +20,17 @@
 #include <async_simple/coro/SyncAwait.h>
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <ylt/coro_io/coro_io.hpp>
 #include <ylt/easylog.hpp>
 
@@ -178,4 +187,168 @@ class smooth_bursty_rate_limiter : public abstract_smooth_rate_limiter {
    */
   double max_burst_seconds_ = 0;
 };
+
+/**
+ * A token bucket for admission control on hot paths. Taking permits is a
+ * compare-and-swap on one atomic, there is no lock: the bucket is kept as
+ * the time at which it would be empty (the generic cell rate algorithm), and
+ * permits are available while that is at most one burst ahead of now.
+ */
+class token_bucket {
+ public:
+  /**
+   * @param permits_per_second the refill rate.
+   * @param burst permits that may be taken at once after being idle, one
+   * second's worth by default. It starts full.
+   */
+  explicit token_bucket(double permits_per_second, double burst = 0) {
+    set_rate(permits_per_second, burst);
+  }
+
+  void set_rate(double permits_per_second, double burst = 0) {
+    if (burst <= 0) {
+      burst = permits_per_second;
+    }
+    int64_t interval =
+        (std::max)(static_cast<int64_t>(1e9 / permits_per_second), int64_t{1});
+    interval_.store(interval, std::memory_order_relaxed);
+    tolerance_.store(static_cast<int64_t>(interval * (std::max)(burst, 1.0)),
+                     std::memory_order_relaxed);
+  }
+
+  /**
+   * Take permits if they are available now, never waits.
+   */
+  bool try_acquire(int permits = 1) {
+    int64_t now = now_nanos();
+    int64_t cost = interval_.load(std::memory_order_relaxed) * permits;
+    int64_t tolerance = tolerance_.load(std::memory_order_relaxed);
+    int64_t empty_at = empty_at_.load(std::memory_order_relaxed);
+    int64_t next;
+    do {
+      next = (std::max)(empty_at, now) + cost;
+      if (next - now > tolerance) {
+        return false;
+      }
+    } while (!empty_at_.compare_exchange_weak(empty_at, next,
+                                              std::memory_order_relaxed));
+    return true;
+  }
+
+  /**
+   * Take permits, waiting until they are available.
+   *
+   * @return how long it waited.
+   */
+  async_simple::coro::Lazy<std::chrono::milliseconds> acquire(int permits = 1) {
+    int64_t now = now_nanos();
+    int64_t cost = interval_.load(std::memory_order_relaxed) * permits;
+    int64_t empty_at = empty_at_.load(std::memory_order_relaxed);
+    int64_t next;
+    do {
+      next = (std::max)(empty_at, now) + cost;
+    } while (!empty_at_.compare_exchange_weak(empty_at, next,
+                                              std::memory_order_relaxed));
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::nanoseconds((std::max)(
+            next - tolerance_.load(std::memory_order_relaxed) - now,
+            int64_t{0})));
+    if (wait.count() > 0) {
+      co_await coro_io::sleep_for(wait);
+    }
+    co_return wait;
+  }
+
+ private:
+  static int64_t now_nanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // nanoseconds per permit
+  std::atomic<int64_t> interval_;
+  // how far ahead of now the bucket may be emptied, the burst in nanoseconds
+  std::atomic<int64_t> tolerance_;
+  std::atomic<int64_t> empty_at_ = 0;
+};
+
+/**
+ * Token buckets by key, e.g. per tenant, client ip or method. Keys are
+ * spread over shards that each have their own lock, so there is no global
+ * lock. Each shard keeps at most max_keys / shard_count buckets and evicts
+ * the least recently used one, so memory stays bounded however many keys
+ * come; an evicted key starts again with a full bucket.
+ */
+class keyed_rate_limiter {
+ public:
+  /**
+   * @param permits_per_second the rate of every key.
+   * @param burst the burst of every key, see token_bucket.
+   */
+  keyed_rate_limiter(double permits_per_second, double burst = 0,
+                     std::size_t max_keys = 65536,
+                     std::size_t shard_count = 64)
+      : permits_per_second_(permits_per_second),
+        burst_(burst),
+        shard_count_((std::max)(shard_count, std::size_t{1})),
+        max_keys_per_shard_(
+            (std::max)(max_keys / shard_count_, std::size_t{1})),
+        shards_(std::make_unique<shard[]>(shard_count_)) {}
+
+  /**
+   * Take permits from the bucket of key if they are available now.
+   */
+  bool try_acquire(std::string_view key, int permits = 1) {
+    auto &shard = shards_[std::hash<std::string_view>{}(key) % shard_count_];
+    std::lock_guard lock(shard.mutex);
+    auto it = shard.buckets.find(key);
+    if (it != shard.buckets.end()) {
+      shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    }
+    else {
+      if (shard.buckets.size() >= max_keys_per_shard_) {
+        shard.buckets.erase(shard.lru.back().key);
+        shard.lru.pop_back();
+      }
+      shard.lru.emplace_front(std::string(key), permits_per_second_, burst_);
+      // the key of the map views the string of the list node.
+      it = shard.buckets.emplace(shard.lru.front().key, shard.lru.begin())
+               .first;
+    }
+    return it->second->bucket.try_acquire(permits);
+  }
+
+  /**
+   * The number of keys which have a bucket.
+   */
+  std::size_t size() const {
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < shard_count_; ++i) {
+      std::lock_guard lock(shards_[i].mutex);
+      count += shards_[i].buckets.size();
+    }
+    return count;
+  }
+
+ private:
+  struct entry {
+    entry(std::string key, double permits_per_second, double burst)
+        : key(std::move(key)), bucket(permits_per_second, burst) {}
+    std::string key;
+    token_bucket bucket;
+  };
+  struct shard {
+    mutable std::mutex mutex;
+    // the most recently used first
+    std::list<entry> lru;
+    std::unordered_map<std::string_view, std::list<entry>::iterator> buckets;
+  };
+
+  double permits_per_second_;
+  double burst_;
+  std::size_t shard_count_;
+  std::size_t max_keys_per_shard_;
+  std::unique_ptr<shard[]> shards_;
+};
 }  // namespace coro_io
\ No newline at end of file
@@ -0,0 +1,515 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+// IORING_OP_READ and IORING_OP_WRITE came with it, in linux 5.6.
+#if defined(IORING_FEAT_RW_CUR_POS)
+#define YLT_HAS_NATIVE_IO_URING 1
+#endif
+#endif
+
+#if defined(YLT_HAS_NATIVE_IO_URING)
+#include <async_simple/coro/Lazy.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <asio/dispatch.hpp>
+#include <asio/io_context.hpp>
+#include <asio/posix/stream_descriptor.hpp>
+#include <asio/post.hpp>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+#include "coro_io.hpp"
+#include "ylt/easylog.hpp"
+
+namespace coro_io {
+
+/*!
+ * An io_uring of an io_context, for the file I/O of coro_file with
+ * read_type::native_uring. Get it with
+ * `asio::use_service<coro_io::uring_service>(io_context)`.
+ *
+ * Reads and writes are prepared on the io_context's thread, and all those
+ * prepared while its ready handlers run are submitted in one io_uring_enter.
+ * Completions wake the io_context through an eventfd and resume the
+ * coroutines there, so an I/O costs no thread hop. Buffers registered with
+ * register_buffers() and files registered with register_file() are used as
+ * fixed buffers and fixed files.
+ *
+ * It talks to the kernel with the raw syscalls, liburing isn't needed.
+ */
+class uring_service : public asio::execution_context::service {
+ public:
+  inline static asio::execution_context::id id;
+
+  static constexpr unsigned entries = 256;
+  static constexpr unsigned max_registered_files = 1024;
+
+  explicit uring_service(asio::io_context& ctx)
+      : asio::execution_context::service(ctx), ctx_(ctx), eventfd_(ctx) {
+    init();
+  }
+
+  ~uring_service() { release(); }
+
+  /*!
+   * False if the kernel refused to set up an io_uring, e.g. it's too old or
+   * disabled by seccomp. error() tells why.
+   */
+  bool available() const noexcept { return ring_fd_ >= 0; }
+
+  std::error_code error() const noexcept { return error_; }
+
+  /*!
+   * Register buffers as fixed buffers, replacing those registered before.
+   * I/O into or from them skips mapping the pages for every request. The
+   * registration runs on the io_context, where prepare() reads them, so
+   * unless it's called there it blocks until the io_context runs it: called
+   * from another thread before the io_context runs, it waits until it does,
+   * forever if it never does. It fails with operation_canceled if the
+   * io_context has stopped.
+   */
+  std::error_code register_buffers(std::vector<iovec> buffers) {
+    if (!available()) {
+      return error_;
+    }
+    if (ctx_.get_executor().running_in_this_thread()) {
+      return register_buffers_here(std::move(buffers));
+    }
+    if (ctx_.stopped()) {
+      return std::make_error_code(std::errc::operation_canceled);
+    }
+    std::promise<std::error_code> promise;
+    auto future = promise.get_future();
+    asio::dispatch(ctx_, [this, &buffers, &promise] {
+      promise.set_value(register_buffers_here(std::move(buffers)));
+    });
+    return future.get();
+  }
+
+  /*!
+   * Register fd in the ring's file table, which saves looking it up for
+   * every request. Returns its slot, or -1 if the table is full or not
+   * supported, then the fd is used as is.
+   */
+  int register_file(int fd) {
+    std::lock_guard lock(files_->mutex);
+    if (files_->free_slots.empty()) {
+      return -1;
+    }
+    int slot = files_->free_slots.back();
+    if (update_file(slot, fd) < 0) {
+      return -1;
+    }
+    files_->free_slots.pop_back();
+    return slot;
+  }
+
+  /*!
+   * A callable which unregisters slot, and which may outlive the service,
+   * e.g. in a file closed after its io_context: once the service has shut
+   * down it does nothing, the file table is gone with the ring.
+   */
+  auto file_unregisterer(int slot) {
+    return [this, files = files_, slot] {
+      std::lock_guard lock(files->mutex);
+      if (!files->shut_down) {
+        update_file(slot, -1);
+        files->free_slots.push_back(slot);
+      }
+    };
+  }
+
+  void unregister_file(int slot) { file_unregisterer(slot)(); }
+
+  /*!
+   * Read or write at offset of fd, or of the registered file in slot if it
+   * isn't -1. Returns the size transferred, or -errno.
+   */
+  async_simple::coro::Lazy<int> async_rw(bool is_read, int fd, int slot,
+                                         uint64_t offset, char* buf,
+                                         uint32_t size) {
+    return async_submit(is_read ? IORING_OP_READ : IORING_OP_WRITE, fd, slot,
+                        offset, reinterpret_cast<uint64_t>(buf), size);
+  }
+
+  /*!
+   * Like async_rw, but scatters into or gathers from the buffers of iov,
+   * which must stay alive until it completes.
+   */
+  async_simple::coro::Lazy<int> async_rwv(bool is_read, int fd, int slot,
+                                          uint64_t offset, const iovec* iov,
+                                          unsigned count) {
+    return async_submit(is_read ? IORING_OP_READV : IORING_OP_WRITEV, fd, slot,
+                        offset, reinterpret_cast<uint64_t>(iov), count);
+  }
+
+ private:
+  async_simple::coro::Lazy<int> async_submit(uint8_t opcode, int fd, int slot,
+                                             uint64_t offset, uint64_t addr,
+                                             uint32_t len) {
+    if (!available()) {
+      co_return -error_.value();
+    }
+    callback_awaitor<int> awaitor;
+    co_return co_await awaitor.await_resume([&](auto) {
+      asio::dispatch(ctx_, [this, opcode, fd, slot, offset, addr, len,
+                            awaitor = &awaitor] {
+        prepare(opcode, fd, slot, offset, addr, len, awaitor);
+      });
+    });
+  }
+
+  using handler_t = callback_awaitor<int>::awaitor_handler;
+
+  std::error_code register_buffers_here(std::vector<iovec> buffers) {
+    if (!buffers_.empty()) {
+      sys_register(IORING_UNREGISTER_BUFFERS, nullptr, 0);
+      buffers_.clear();
+    }
+    if (sys_register(IORING_REGISTER_BUFFERS, buffers.data(),
+                     buffers.size()) < 0) {
+      return std::error_code(errno, std::system_category());
+    }
+    buffers_ = std::move(buffers);
+    return {};
+  }
+
+  void shutdown() override {
+    {
+      std::lock_guard lock(files_->mutex);
+      files_->shut_down = true;
+    }
+    std::error_code ec;
+    eventfd_.close(ec);
+  }
+
+  void init() {
+    io_uring_params params{};
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) {
+      error_ = std::error_code(errno, std::system_category());
+      ELOG_WARN << "io_uring_setup failed: " << error_.message();
+      return;
+    }
+    ring_fd_ = fd;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+      sq_ring_size_ = cq_ring_size_ = (std::max)(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ring_ = map(sq_ring_size_, IORING_OFF_SQ_RING);
+    cq_ring_ = single_mmap ? sq_ring_ : map(cq_ring_size_, IORING_OFF_CQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(map(sqes_size_, IORING_OFF_SQES));
+    if (sq_ring_ == nullptr || cq_ring_ == nullptr || sqes_ == nullptr) {
+      fail("mmap io_uring");
+      return;
+    }
+
+    auto sq = static_cast<char*>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_flags_ = reinterpret_cast<unsigned*>(sq + params.sq_off.flags);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    auto cq = static_cast<char*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    sq_local_tail_ = *sq_tail_;
+
+    int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (efd < 0) {
+      fail("eventfd");
+      return;
+    }
+    eventfd_.assign(efd);
+    if (sys_register(IORING_REGISTER_EVENTFD, &efd, 1) < 0) {
+      fail("register eventfd");
+      return;
+    }
+
+    // a sparse file table, filled by register_file().
+    std::vector<int> files(max_registered_files, -1);
+    if (sys_register(IORING_REGISTER_FILES, files.data(), files.size()) ==
+        0) {
+      for (int slot = max_registered_files - 1; slot >= 0; --slot) {
+        files_->free_slots.push_back(slot);
+      }
+    }
+  }
+
+  void* map(std::size_t size, off_t offset) {
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ring_fd_, offset);
+    return ptr == MAP_FAILED ? nullptr : ptr;
+  }
+
+  void fail(const char* what) {
+    error_ = std::error_code(errno, std::system_category());
+    ELOG_WARN << what << " failed: " << error_.message();
+    release();
+  }
+
+  void release() {
+    if (sqes_) {
+      munmap(sqes_, sqes_size_);
+      sqes_ = nullptr;
+    }
+    if (cq_ring_ && cq_ring_ != sq_ring_) {
+      munmap(cq_ring_, cq_ring_size_);
+    }
+    cq_ring_ = nullptr;
+    if (sq_ring_) {
+      munmap(sq_ring_, sq_ring_size_);
+      sq_ring_ = nullptr;
+    }
+    if (ring_fd_ >= 0) {
+      ::close(ring_fd_);
+      ring_fd_ = -1;
+    }
+  }
+
+  int sys_register(unsigned opcode, void* arg, unsigned nr_args) {
+    return static_cast<int>(
+        syscall(__NR_io_uring_register, ring_fd_, opcode, arg, nr_args));
+  }
+
+  int update_file(int slot, int fd) {
+    io_uring_files_update update{};
+    update.offset = slot;
+    update.fds = reinterpret_cast<uint64_t>(&fd);
+    return sys_register(IORING_REGISTER_FILES_UPDATE, &update, 1);
+  }
+
+  // on the io_context's thread from here on.
+
+  void prepare(uint8_t opcode, int fd, int slot, uint64_t offset,
+               uint64_t addr, uint32_t len, callback_awaitor<int>* awaitor) {
+    if (sq_local_tail_ - load_acquire(sq_head_) == sq_entries_) {
+      submit();
+      if (sq_local_tail_ - load_acquire(sq_head_) == sq_entries_) {
+        asio::post(ctx_, [awaitor] {
+          handler_t{awaitor}.set_value_then_resume(-EAGAIN);
+        });
+        return;
+      }
+    }
+    unsigned index = sq_local_tail_ & sq_mask_;
+    io_uring_sqe& sqe = sqes_[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = opcode;
+    if (slot >= 0) {
+      sqe.fd = slot;
+      sqe.flags |= IOSQE_FIXED_FILE;
+    }
+    else {
+      sqe.fd = fd;
+    }
+    sqe.off = offset;
+    sqe.addr = addr;
+    sqe.len = len;
+    sqe.user_data = reinterpret_cast<uint64_t>(awaitor);
+    if (opcode == IORING_OP_READ || opcode == IORING_OP_WRITE) {
+      for (std::size_t i = 0; i < buffers_.size(); ++i) {
+        auto base = reinterpret_cast<uint64_t>(buffers_[i].iov_base);
+        if (addr >= base && addr + len <= base + buffers_[i].iov_len) {
+          sqe.opcode = opcode == IORING_OP_READ ? IORING_OP_READ_FIXED
+                                                : IORING_OP_WRITE_FIXED;
+          sqe.buf_index = static_cast<uint16_t>(i);
+          break;
+        }
+      }
+    }
+    sq_array_[index] = index;
+    ++sq_local_tail_;
+    ++in_flight_;
+    if (!waiting_) {
+      wait_completions();
+    }
+    if (!submit_scheduled_) {
+      // after the other ready handlers, which may prepare more.
+      submit_scheduled_ = true;
+      asio::post(ctx_, [this] {
+        submit_scheduled_ = false;
+        submit();
+      });
+    }
+  }
+
+  void submit() {
+    unsigned to_submit = sq_local_tail_ - load_acquire(sq_head_);
+    if (to_submit == 0) {
+      return;
+    }
+    std::atomic_ref<unsigned>(*sq_tail_).store(sq_local_tail_,
+                                               std::memory_order_release);
+    int ret;
+    do {
+      ret = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd_, to_submit,
+                                     0, 0, nullptr, 0));
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0) {
+      int err = errno;
+      // e.g. EBUSY while completions overflow: retried after reaping the
+      // completions of the other requests in flight.
+      if ((err == EBUSY || err == EAGAIN) && in_flight_ > to_submit) {
+        ELOG_DEBUG << "io_uring_enter failed: " << std::strerror(err);
+        return;
+      }
+      // nothing else would complete and retry them.
+      ELOG_WARN << "io_uring_enter failed: " << std::strerror(err);
+      fail_unsubmitted(-err);
+    }
+  }
+
+  // Take back the sqes the kernel hasn't consumed, and resume their
+  // coroutines with res.
+  void fail_unsubmitted(int res) {
+    unsigned head = load_acquire(sq_head_);
+    for (unsigned i = head; i != sq_local_tail_; ++i) {
+      auto awaitor = reinterpret_cast<callback_awaitor<int>*>(
+          sqes_[sq_array_[i & sq_mask_]].user_data);
+      --in_flight_;
+      asio::post(ctx_, [awaitor, res] {
+        handler_t{awaitor}.set_value_then_resume(res);
+      });
+    }
+    sq_local_tail_ = head;
+    // the kernel only reads the tail in io_uring_enter.
+    std::atomic_ref<unsigned>(*sq_tail_).store(head, std::memory_order_release);
+    if (in_flight_ == 0 && waiting_) {
+      std::error_code ec;
+      eventfd_.cancel(ec);
+    }
+  }
+
+  // only waits while requests are in flight, so that io_context::run()
+  // returns once the work is done.
+  void wait_completions() {
+    waiting_ = true;
+    eventfd_.async_wait(asio::posix::stream_descriptor::wait_read,
+                        [this](const std::error_code& ec) {
+                          waiting_ = false;
+                          if (ec == asio::error::bad_descriptor) {
+                            return;
+                          }
+                          uint64_t count;
+                          (void)::read(eventfd_.native_handle(), &count,
+                                       sizeof(count));
+                          reap();
+                          if (in_flight_ > 0 && !waiting_) {
+                            wait_completions();
+                          }
+                        });
+    // the reactor is edge triggered, a completion posted before the wait was
+    // queued doesn't wake it.
+    if (*cq_head_ != load_acquire(cq_tail_)) {
+      asio::post(ctx_, [this] {
+        reap();
+      });
+    }
+  }
+
+  void reap() {
+    while (true) {
+      unsigned head = *cq_head_;
+      while (head != load_acquire(cq_tail_)) {
+        io_uring_cqe& cqe = cqes_[head & cq_mask_];
+        auto awaitor = reinterpret_cast<callback_awaitor<int>*>(cqe.user_data);
+        int res = cqe.res;
+        std::atomic_ref<unsigned>(*cq_head_).store(++head,
+                                                   std::memory_order_release);
+        --in_flight_;
+        handler_t{awaitor}.set_value_then_resume(res);
+      }
+      if (!(load_acquire(sq_flags_) & IORING_SQ_CQ_OVERFLOW)) {
+        break;
+      }
+      // move the completions the kernel kept aside into the ring.
+      syscall(__NR_io_uring_enter, ring_fd_, 0, 0, IORING_ENTER_GETEVENTS,
+              nullptr, 0);
+    }
+    submit();
+    if (in_flight_ == 0 && waiting_) {
+      std::error_code ec;
+      eventfd_.cancel(ec);
+    }
+  }
+
+  static unsigned load_acquire(unsigned* ptr) {
+    return std::atomic_ref<unsigned>(*ptr).load(std::memory_order_acquire);
+  }
+
+  asio::io_context& ctx_;
+  asio::posix::stream_descriptor eventfd_;
+  int ring_fd_ = -1;
+  std::error_code error_;
+
+  void* sq_ring_ = nullptr;
+  void* cq_ring_ = nullptr;
+  std::size_t sq_ring_size_ = 0;
+  std::size_t cq_ring_size_ = 0;
+  io_uring_sqe* sqes_ = nullptr;
+  std::size_t sqes_size_ = 0;
+  unsigned* sq_head_ = nullptr;
+  unsigned* sq_tail_ = nullptr;
+  unsigned* sq_flags_ = nullptr;
+  unsigned* sq_array_ = nullptr;
+  unsigned sq_mask_ = 0;
+  unsigned sq_entries_ = 0;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned cq_mask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+  // sqes prepared up to here, the kernel sees them after submit().
+  unsigned sq_local_tail_ = 0;
+  bool submit_scheduled_ = false;
+  std::size_t in_flight_ = 0;
+  bool waiting_ = false;
+
+  std::vector<iovec> buffers_;
+
+  // shared with the file_unregisterer()s, which may outlive the service.
+  struct files_state {
+    std::mutex mutex;
+    bool shut_down = false;
+    std::vector<int> free_slots;
+  };
+  std::shared_ptr<files_state> files_ = std::make_shared<files_state>();
+};
+
+}  // namespace coro_io
+#endif
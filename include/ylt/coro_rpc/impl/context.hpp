@@ -15,12 +15,14 @@
  */
 #pragma once
 
+#include <async_simple/coro/Generator.h>
 #include <async_simple/coro/Lazy.h>
 
 #include <any>
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <ranges>
 #include <type_traits>
 #include <utility>
 #include <variant>
@@ -81,6 +83,7 @@ class context_base {
       AS_UNLIKELY { return; };
     self_->conn_->template response_error<rpc_protocol>(
         error_code, error_msg, self_->req_head_, self_->is_delay_);
+    self_->conn_->release_concurrency_slot(*self_);
   }
   void response_error(coro_rpc::err_code error_code) {
     response_error(error_code, error_code.message());
@@ -110,6 +113,7 @@ class context_base {
                 self_->is_delay_);
           },
           *rpc_protocol::get_serialize_protocol(self_->req_head_));
+      self_->conn_->release_concurrency_slot(*self_);
     }
     else {
       static_assert(
@@ -128,6 +132,7 @@ class context_base {
                 self_->is_delay_);
           },
           *rpc_protocol::get_serialize_protocol(self_->req_head_));
+      self_->conn_->release_concurrency_slot(*self_);
 
       // response_handler_(std::move(conn_), std::move(ret));
     }
@@ -151,6 +156,14 @@ class context_base {
    */
   uint64_t get_connection_id() { return self_->conn_->conn_id_; }
 
+  /*!
+   * Get the coalesced write counters of the connection
+   * @return a ref of the connection's write_stats
+   */
+  const coro_connection::write_stats &get_write_stats() const {
+    return self_->conn_->get_write_stats();
+  }
+
   /*!
    * Set the response_attachment
    * @return a ref of response_attachment
@@ -169,6 +182,16 @@ class context_base {
     self_->resp_attachment_ = std::move(attachment);
   }
 
+  /*!
+   * Get the request body, which std::string_view, std::span<const T> and
+   * struct_pack::trivial_view<T> arguments of the rpc function point into.
+   *
+   * The body belongs to this request's context: it stays valid until the
+   * response is sent, or as long as a context holding set_delay() lives.
+   * @return the serialized arguments
+   */
+  std::string_view get_request_body() const { return self_->req_body_; }
+
   /*!
    * Get the request attachment
    * @return connection id
@@ -204,6 +227,29 @@ struct get_type_t<async_simple::coro::Lazy<T>> {
   using type = T;
 };
 
+// a streaming rpc function ends its stream with a void response.
+template <typename Ref, typename V, typename Allocator>
+struct get_type_t<async_simple::coro::Generator<Ref, V, Allocator>> {
+  using type = void;
+};
+
+template <typename T>
+inline constexpr bool is_generator_v =
+    util::is_specialization_v<T, async_simple::coro::Generator>;
+
+/*!
+ * Whether `func` is a streaming rpc function, i.e. it returns an
+ * async_simple::coro::Generator, whose items are sent one by one.
+ */
+template <auto func>
+inline constexpr bool is_stream_function_v =
+    is_generator_v<util::function_return_type_t<decltype(func)>>;
+
+// the item type of a streaming rpc function
+template <auto func>
+using stream_item_t =
+    std::ranges::range_value_t<util::function_return_type_t<decltype(func)>>;
+
 template <auto func>
 inline auto get_return_type() {
   using T = decltype(func);
@@ -17,19 +17,30 @@
 #include <async_simple/Executor.h>
 #include <async_simple/coro/SyncAwait.h>
 
+#include <algorithm>
 #include <any>
 #include <array>
 #include <asio/buffer.hpp>
+#include <asio/buffered_read_stream.hpp>
 #include <atomic>
 #include <cstdint>
 #include <functional>
+#include <iterator>
 #include <memory>
+#include <optional>
+#include <span>
 #include <string_view>
 #include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 #include <ylt/easylog.hpp>
 
+#include "ylt/coro_io/concurrency_limiter.hpp"
 #include "ylt/coro_io/coro_io.hpp"
+#include "ylt/coro_io/rate_limiter.hpp"
 #include "ylt/coro_rpc/impl/errno.h"
 #ifdef UNIT_TEST_INJECT
 #include "inject_action.hpp"
@@ -50,8 +61,13 @@ struct context_info_t {
   };
   std::atomic<bool> has_response_ = false;
   bool is_delay_ = false;
+  // when the request was read, it holds a slot of the connection's
+  // concurrency limiter until its response is sent.
+  std::chrono::steady_clock::time_point read_time_;
+  std::atomic<bool> holds_concurrency_slot_ = false;
   context_info_t(std::shared_ptr<coro_connection> &&conn)
       : conn_(std::move(conn)) {}
+  ~context_info_t();
 };
 /*!
  * TODO: add doc
@@ -151,13 +167,29 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
     auto context_info =
         std::make_shared<context_info_t<rpc_protocol>>(shared_from_this());
     std::string resp_error_msg;
+    // Reads go through a per-connection buffer: one recv fetches as much as
+    // is available, so pipelined small requests are parsed without a syscall
+    // per header/payload. Writes still go to the socket directly.
+    asio::buffered_read_stream<Socket &> stream(
+        socket, coro_io::default_read_buffer_size);
     while (true) {
+      if (max_concurrent_calls_ != 0 &&
+          concurrent_calls_ >= max_concurrent_calls_) {
+        // backpressure: read again once one of them has finished.
+        coro_io::callback_awaitor<void> awaitor;
+        co_await awaitor.await_resume([this](auto handler) {
+          concurrent_call_waiter_.emplace(std::move(handler));
+        });
+      }
       auto &req_head = context_info->req_head_;
       auto &body = context_info->req_body_;
       auto &req_attachment = context_info->req_attachment_;
       reset_timer();
-      auto ec = co_await rpc_protocol::read_head(socket, req_head);
+      auto ec = co_await rpc_protocol::read_head(stream, req_head);
       cancel_timer();
+      if (concurrency_limiter_) {
+        context_info->read_time_ = std::chrono::steady_clock::now();
+      }
       // `co_await async_read` uses asio::async_read underlying.
       // If eof occurred, the bytes_transferred of `co_await async_read` must
       // less than RPC_HEAD_LEN. Incomplete data will be discarded.
@@ -167,6 +199,13 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
         close();
         break;
       }
+      if constexpr (requires { rpc_protocol::stream_ack_msg; }) {
+        if (req_head.msg_type != rpc_protocol::request_msg)
+          AS_UNLIKELY {
+            on_stream_msg<rpc_protocol>(req_head);
+            continue;
+          }
+      }
 
 #ifdef UNIT_TEST_INJECT
       client_id_ = req_head.seq_num;
@@ -195,7 +234,7 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
       std::string_view payload;
       // rpc_protocol::buffer_type maybe from user, default from framework.
 
-      ec = co_await rpc_protocol::read_payload(socket, req_head, body,
+      ec = co_await rpc_protocol::read_payload(stream, req_head, body,
                                                req_attachment);
       payload = std::string_view{body};
 
@@ -210,15 +249,53 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
       std::pair<coro_rpc::errc, std::string> pair{};
 
       auto key = rpc_protocol::get_route_key(req_head);
-      auto handler = router.get_handler(key);
-      if (!handler) {
-        auto coro_handler = router.get_coro_handler(key);
-        pair = co_await router.route_coro(coro_handler, payload, context_info,
-                                          serialize_proto.value(), key);
-      }
+      // rejected requests aren't deserialized. Unlike other errors, a
+      // rejection keeps the connection open for the calls after it.
+      bool rejected = false;
+      if (auto admission = admit(key); admission != coro_rpc::errc::ok)
+        AS_UNLIKELY {
+          pair = {admission,
+                  std::string(coro_rpc::make_error_message(admission))};
+          rejected = true;
+        }
       else {
-        pair = router.route(handler, payload, context_info,
-                            serialize_proto.value(), key);
+        context_info->holds_concurrency_slot_ = !!concurrency_limiter_;
+        if (auto handler = router.get_handler(key); !handler) {
+          auto coro_handler = router.get_coro_handler(key);
+          if (coro_handler &&
+              (coro_handler->stream ||
+               (coro_handler->concurrent && max_concurrent_calls_ != 0))) {
+            // answered like a delayed response, so a slow function doesn't
+            // hold up the requests after it. A stream waits for the acks
+            // read here, so it isn't counted in max_concurrent_calls.
+            ++delay_resp_cnt;
+            if (coro_handler->stream) {
+              open_stream<rpc_protocol>(req_head);
+            }
+            else {
+              ++concurrent_calls_;
+            }
+            dispatch_coro<rpc_protocol>(router, *coro_handler,
+                                        std::move(context_info),
+                                        serialize_proto.value(), key)
+                .via(executor_)
+                .detach();
+            context_info = std::make_shared<context_info_t<rpc_protocol>>(
+                shared_from_this());
+            continue;
+          }
+          pair = co_await router.route_coro(coro_handler, payload,
+                                            context_info,
+                                            serialize_proto.value(), key);
+        }
+        else {
+          pair = router.route(handler, payload, context_info,
+                              serialize_proto.value(), key);
+        }
+        // a delayed response gives its slot back when it's sent.
+        if (rpc_call_type_ != rpc_call_type::callback_with_delay) {
+          release_concurrency_slot(*context_info);
+        }
       }
 
       auto &[resp_err, resp_buf] = pair;
@@ -228,12 +305,19 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
         case rpc_call_type::non_callback:
           break;
         case rpc_call_type::callback_with_delay:
+          recycle_buffer(std::move(resp_buf));
           ++delay_resp_cnt;
           rpc_call_type_ = rpc_call_type::non_callback;
+          // the delayed response still needs this request's header (seq_num),
+          // so the next request must not overwrite it.
+          context_info =
+              std::make_shared<context_info_t<rpc_protocol>>(shared_from_this());
           continue;
         case rpc_call_type::callback_finished:
+          recycle_buffer(std::move(resp_buf));
           continue;
         case rpc_call_type::callback_started:
+          recycle_buffer(std::move(resp_buf));
           coro_io::callback_awaitor<void> awaitor;
           rpc_call_type_ = rpc_call_type::callback_finished;
           co_await awaitor.await_resume([this](auto handler) {
@@ -249,8 +333,18 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
       resp_error_msg.clear();
       if (!!resp_err)
         AS_UNLIKELY { std::swap(resp_buf, resp_error_msg); }
-      std::string header_buf = rpc_protocol::prepare_response(
-          resp_buf, req_head, 0, resp_err, resp_error_msg);
+      std::string header_buf = take_buffer();
+      if constexpr (requires {
+                      rpc_protocol::prepare_response_to(header_buf, resp_buf,
+                                                        req_head, 0);
+                    }) {
+        rpc_protocol::prepare_response_to(header_buf, resp_buf, req_head, 0,
+                                          resp_err, resp_error_msg);
+      }
+      else {
+        header_buf = rpc_protocol::prepare_response(resp_buf, req_head, 0,
+                                                    resp_err, resp_error_msg);
+      }
 
 #ifdef UNIT_TEST_INJECT
       if (g_action == inject_action::close_socket_after_send_length) {
@@ -278,11 +372,11 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
                                     [] {
                                       return std::string_view{};
                                     });
-          if (write_queue_.size() == 1) {
+          if (!is_writing_) {
             send_data().start([self = shared_from_this()](auto &&) {
             });
           }
-          if (!!resp_err)
+          if (!!resp_err && !rejected)
             AS_UNLIKELY { break; }
         }
     }
@@ -323,6 +417,51 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
         .detach();
   }
 
+  /*!
+   * Send an item of a streaming response, and wait until it has been
+   * written. Once the items acked by the client have been sent, it first
+   * waits for the next ack. So the function producing the items is paced by
+   * the peer reading them. Only call it on the connection's executor.
+   *
+   * @return false if the connection has been closed or the stream canceled
+   */
+  template <typename rpc_protocol>
+  async_simple::coro::Lazy<bool> write_stream_item(
+      std::string &&body_buf,
+      const typename rpc_protocol::req_header &req_head) {
+    auto it = streams_.find(req_head.seq_num);
+    if (it != streams_.end() && it->second.credit == 0 &&
+        !it->second.canceled && !has_closed()) {
+      // the client hasn't read the items sent so far.
+      coro_io::callback_awaitor<void> awaitor;
+      co_await awaitor.await_resume([&](auto handler) {
+        it->second.waiter.emplace(std::move(handler));
+      });
+      it = streams_.find(req_head.seq_num);
+    }
+    if (has_closed() || it == streams_.end() || it->second.canceled)
+      AS_UNLIKELY { co_return false; }
+    --it->second.credit;
+    std::string header_buf = take_buffer();
+    rpc_protocol::prepare_stream_item_to(header_buf, body_buf, req_head);
+    write_queue_.emplace_back(std::move(header_buf), std::move(body_buf),
+                              [] {
+                                return std::string_view{};
+                              });
+    if (!is_writing_) {
+      co_await send_data();
+    }
+    else {
+      // a delayed response is being written, the write loop will take this
+      // item too.
+      coro_io::callback_awaitor<void> awaitor;
+      co_await awaitor.await_resume([this](auto handler) {
+        written_waiters_.push_back(std::move(handler));
+      });
+    }
+    co_return !has_closed();
+  }
+
   void set_rpc_call_type(enum rpc_call_type r) { rpc_call_type_ = r; }
 
   /*!
@@ -359,9 +498,180 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
   std::any &tag() { return tag_; }
   const std::any &tag() const { return tag_; }
 
+  /*!
+   * Admit requests through limiter, keyed by the client ip, or by the
+   * function with by_function. Call it before start().
+   */
+  void set_request_rate_limiter(
+      std::shared_ptr<coro_io::keyed_rate_limiter> limiter, bool by_function) {
+    request_rate_limiter_ = std::move(limiter);
+    rate_limit_by_function_ = by_function;
+    if (!by_function) {
+      client_ip_ = coro_io::remote_ip(socket_);
+    }
+  }
+
+  /*!
+   * Requests beyond the limit of limiter fail with errc::server_busy. A
+   * request holds its slot from when it's read until its function returns,
+   * or until its response is sent when it's delayed.
+   */
+  void set_concurrency_limiter(
+      std::shared_ptr<coro_io::concurrency_limiter> limiter) {
+    concurrency_limiter_ = std::move(limiter);
+  }
+
+  /*!
+   * Run up to n calls of coroutine functions without a context concurrently,
+   * see coro_rpc_config_base::max_concurrent_calls. Call it before start().
+   */
+  void set_max_concurrent_calls(uint32_t n) { max_concurrent_calls_ = n; }
+
   auto &get_executor() { return *executor_; }
 
+  /*!
+   * Give back the concurrency limiter slot of a request, its latency counts
+   * from when it was read. May be called from any thread.
+   */
+  template <typename rpc_protocol>
+  void release_concurrency_slot(context_info_t<rpc_protocol> &info) {
+    if (info.holds_concurrency_slot_.exchange(false)) {
+      concurrency_limiter_->release(std::chrono::steady_clock::now() -
+                                    info.read_time_);
+    }
+  }
+
+  /*!
+   * Counters of the coalesced response writes, only read them on the
+   * connection's executor (e.g. from a non-delayed rpc function).
+   */
+  struct write_stats {
+    // number of scatter-gather writes issued
+    uint64_t flush_count = 0;
+    // number of responses written
+    uint64_t message_count = 0;
+    // most responses written by a single flush
+    uint64_t max_coalesced = 0;
+  };
+
+  const write_stats &get_write_stats() const { return write_stats_; }
+
+  /*!
+   * Get an empty buffer for a response, reusing the memory of an already
+   * written one when possible. Only call it on the connection's executor.
+   */
+  std::string take_buffer() {
+    if (buffer_pool_.empty()) {
+      return {};
+    }
+    std::string buffer = std::move(buffer_pool_.back());
+    buffer_pool_.pop_back();
+    return buffer;
+  }
+
+  /*!
+   * Give a buffer back to the pool of take_buffer(). Only call it on the
+   * connection's executor.
+   */
+  void recycle_buffer(std::string &&buffer) {
+    // small string optimized buffers have no memory worth keeping.
+    if (buffer_pool_.size() >= max_pooled_buffer_cnt ||
+        buffer.capacity() <= std::string{}.capacity() ||
+        buffer.capacity() > max_pooled_buffer_size) {
+      return;
+    }
+    buffer.clear();
+    buffer_pool_.push_back(std::move(buffer));
+  }
+
  private:
+  // runs a concurrent coroutine function and sends its response.
+  template <typename rpc_protocol, typename coro_handler_t>
+  async_simple::coro::Lazy<void> dispatch_coro(
+      typename rpc_protocol::router &router, coro_handler_t handler,
+      std::shared_ptr<context_info_t<rpc_protocol>> context_info,
+      typename rpc_protocol::supported_serialize_protocols protocols,
+      typename rpc_protocol::route_key_t key) noexcept {
+    auto [resp_err, resp_buf] =
+        co_await router.route_coro(&handler, context_info->req_body_,
+                                   context_info, protocols, key);
+    release_concurrency_slot(*context_info);
+    // the function may have finished on another executor.
+    executor_->schedule([self = shared_from_this(), context_info,
+                         is_stream = handler.stream] {
+      if (is_stream) {
+        self->close_stream<rpc_protocol>(context_info->req_head_);
+        return;
+      }
+      --self->concurrent_calls_;
+      if (self->concurrent_call_waiter_) {
+        auto waiter = *self->concurrent_call_waiter_;
+        self->concurrent_call_waiter_.reset();
+        waiter.resume();
+      }
+    });
+    if (!resp_err)
+      AS_LIKELY {
+        response_msg<rpc_protocol>(
+            std::move(resp_buf),
+            [] {
+              return std::string_view{};
+            },
+            context_info->req_head_, true);
+      }
+    else {
+      response_error<rpc_protocol>(resp_err, resp_buf, context_info->req_head_,
+                                   true);
+    }
+  }
+
+  // Only call the stream functions below on executor_.
+  template <typename rpc_protocol>
+  void open_stream(const typename rpc_protocol::req_header &req_head) {
+    if constexpr (requires { rpc_protocol::stream_ack_msg; }) {
+      streams_[req_head.seq_num] = {};
+    }
+  }
+
+  template <typename rpc_protocol>
+  void close_stream(const typename rpc_protocol::req_header &req_head) {
+    if constexpr (requires { rpc_protocol::stream_ack_msg; }) {
+      streams_.erase(req_head.seq_num);
+    }
+  }
+
+  // a stream_ack_msg or stream_cancel_msg, the ones of finished streams are
+  // ignored.
+  template <typename rpc_protocol>
+  void on_stream_msg(const typename rpc_protocol::req_header &req_head) {
+    auto it = streams_.find(req_head.seq_num);
+    if (it == streams_.end()) {
+      return;
+    }
+    auto &stream = it->second;
+    if (req_head.msg_type == rpc_protocol::stream_ack_msg) {
+      stream.credit += req_head.function_id;
+    }
+    else {
+      stream.canceled = true;
+    }
+    if (stream.waiter) {
+      auto waiter = *stream.waiter;
+      stream.waiter.reset();
+      waiter.resume();
+    }
+  }
+
+  void resume_stream_waiters() {
+    for (auto &[_, stream] : streams_) {
+      if (stream.waiter) {
+        auto waiter = *stream.waiter;
+        stream.waiter.reset();
+        waiter.resume();
+      }
+    }
+  }
+
   async_simple::coro::Lazy<void> response(
       std::string header_buf, std::string body_buf,
       std::function<std::string_view()> resp_attachment, rpc_conn self,
@@ -384,7 +694,7 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
       assert(delay_resp_cnt >= 0);
       reset_timer();
     }
-    if (write_queue_.size() == 1) {
+    if (!is_writing_) {
       co_await send_data();
     }
     if (!is_delay) {
@@ -402,8 +712,8 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
 
   async_simple::coro::Lazy<void> send_data() {
     std::pair<std::error_code, size_t> ret;
+    is_writing_ = true;
     while (!write_queue_.empty()) {
-      auto &msg = write_queue_.front();
 #ifdef UNIT_TEST_INJECT
       if (g_action == inject_action::force_inject_connection_close_socket) {
         ELOGV(
@@ -412,50 +722,77 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
             "client_id %d",
             conn_id_, client_id_);
         close();
+        resume_written_waiters();
         co_return;
       }
 #endif
-      auto attachment = std::get<2>(msg)();
-      if (attachment.empty()) {
-        std::array<asio::const_buffer, 2> buffers{
-            asio::buffer(std::get<0>(msg)), asio::buffer(std::get<1>(msg))};
-#ifdef YLT_ENABLE_SSL
-        if (use_ssl_) {
-          assert(ssl_stream_);
-          ret = co_await coro_io::async_write(*ssl_stream_, buffers);
+      // Gather the queued responses into one scatter-gather write, bounded
+      // by max_write_iov_cnt and max_write_bytes. The first message is
+      // always taken, however big it is. They are moved to sending_ before
+      // the buffers are taken, as write_queue_ may grow (and reallocate)
+      // while the write is pending.
+      std::size_t msg_cnt = 0;
+      std::size_t iov_cnt = 0;
+      std::size_t bytes = 0;
+      for (auto &msg : write_queue_) {
+        auto attachment_len = std::get<2>(msg)().size();
+        std::size_t len =
+            std::get<0>(msg).size() + std::get<1>(msg).size() + attachment_len;
+        std::size_t cnt = attachment_len == 0 ? 2 : 3;
+        if (msg_cnt > 0 && (iov_cnt + cnt > max_write_iov_cnt ||
+                            bytes + len > max_write_bytes)) {
+          break;
         }
-        else {
-#endif
-          ret = co_await coro_io::async_write(socket_, buffers);
-#ifdef YLT_ENABLE_SSL
+        ++msg_cnt;
+        iov_cnt += cnt;
+        bytes += len;
+      }
+      std::move(write_queue_.begin(), write_queue_.begin() + msg_cnt,
+                std::back_inserter(sending_));
+      write_queue_.erase(write_queue_.begin(),
+                         write_queue_.begin() + msg_cnt);
+      write_buffers_.clear();
+      for (auto &msg : sending_) {
+        write_buffers_.push_back(asio::buffer(std::get<0>(msg)));
+        write_buffers_.push_back(asio::buffer(std::get<1>(msg)));
+        auto attachment = std::get<2>(msg)();
+        if (!attachment.empty()) {
+          write_buffers_.push_back(asio::buffer(attachment));
         }
-#endif
       }
-      else {
-        std::array<asio::const_buffer, 3> buffers{
-            asio::buffer(std::get<0>(msg)), asio::buffer(std::get<1>(msg)),
-            asio::buffer(attachment)};
+      // a span, so that asio doesn't copy the vector of buffers.
+      std::span<const asio::const_buffer> buffers{write_buffers_};
 #ifdef YLT_ENABLE_SSL
-        if (use_ssl_) {
-          assert(ssl_stream_);
-          ret = co_await coro_io::async_write(*ssl_stream_, buffers);
-        }
-        else {
+      if (use_ssl_) {
+        assert(ssl_stream_);
+        ret = co_await coro_io::async_write(*ssl_stream_, buffers);
+      }
+      else {
 #endif
-          ret = co_await coro_io::async_write(socket_, buffers);
+        ret = co_await coro_io::async_write(socket_, buffers);
 #ifdef YLT_ENABLE_SSL
-        }
-#endif
       }
+#endif
       if (ret.first)
         AS_UNLIKELY {
           ELOGV(ERROR, "%s, %s", ret.first.message().data(),
                 "async_write error");
           close();
+          resume_written_waiters();
           co_return;
         }
-      write_queue_.pop_front();
+      ++write_stats_.flush_count;
+      write_stats_.message_count += msg_cnt;
+      write_stats_.max_coalesced =
+          (std::max<uint64_t>)(write_stats_.max_coalesced, msg_cnt);
+      for (auto &msg : sending_) {
+        recycle_buffer(std::move(std::get<0>(msg)));
+        recycle_buffer(std::move(std::get<1>(msg)));
+      }
+      sending_.clear();
     }
+    is_writing_ = false;
+    resume_written_waiters();
     if (!!resp_err_)
       AS_UNLIKELY {
         ELOGV(ERROR, "%s, %s", make_error_message(resp_err_), "resp_err_");
@@ -476,6 +813,16 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
 #endif
   }
 
+  void resume_written_waiters() {
+    if (written_waiters_.empty())
+      AS_LIKELY { return; }
+    auto waiters = std::move(written_waiters_);
+    written_waiters_.clear();
+    for (auto &waiter : waiters) {
+      waiter.resume();
+    }
+  }
+
   void close() {
     if (has_closed_) {
       return;
@@ -484,11 +831,35 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
     asio::error_code ignored_ec;
     socket_.shutdown(asio::ip::tcp::socket::shutdown_both, ignored_ec);
     socket_.close(ignored_ec);
+    resume_stream_waiters();
     if (quit_callback_) {
       quit_callback_(conn_id_);
     }
   }
 
+  // errc::ok if the request may run, it then holds a slot of
+  // concurrency_limiter_, see release_concurrency_slot().
+  template <typename Key>
+  coro_rpc::errc admit(const Key &key) {
+    if (request_rate_limiter_ &&
+        !request_rate_limiter_->try_acquire(rate_limit_key(key))) {
+      return coro_rpc::errc::too_many_requests;
+    }
+    if (concurrency_limiter_ && !concurrency_limiter_->try_acquire()) {
+      return coro_rpc::errc::server_busy;
+    }
+    return coro_rpc::errc::ok;
+  }
+
+  template <typename Key>
+  std::string_view rate_limit_key(const Key &key) const {
+    if (rate_limit_by_function_) {
+      static_assert(std::is_trivially_copyable_v<Key>);
+      return {reinterpret_cast<const char *>(&key), sizeof(key)};
+    }
+    return client_ip_;
+  }
+
   void reset_timer() {
     if (!enable_check_timeout_ || delay_resp_cnt != 0) {
       return;
@@ -521,12 +892,42 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
 
   coro_io::callback_awaitor<void>::awaitor_handler callback_awaitor_handler_{
       nullptr};
+  // calls run by dispatch_coro(), only used on executor_.
+  uint32_t max_concurrent_calls_ = 0;
+  uint32_t concurrent_calls_ = 0;
+  std::optional<coro_io::callback_awaitor<void>::awaitor_handler>
+      concurrent_call_waiter_;
   async_simple::Executor *executor_;
   asio::ip::tcp::socket socket_;
-  // FIXME: queue's performance can be imporved.
-  std::deque<
-      std::tuple<std::string, std::string, std::function<std::string_view()>>>
-      write_queue_;
+  using message_t =
+      std::tuple<std::string, std::string, std::function<std::string_view()>>;
+  // responses waiting to be written, and the ones of the pending write.
+  // Both keep their capacity, so queueing a response doesn't allocate.
+  std::vector<message_t> write_queue_;
+  std::vector<message_t> sending_;
+  bool is_writing_ = false;
+  // limits of a single coalesced write, the iov cap matches the number of
+  // buffers asio passes to one writev.
+  static constexpr std::size_t max_write_iov_cnt = 64;
+  static constexpr std::size_t max_write_bytes = 1024 * 1024;
+  std::vector<asio::const_buffer> write_buffers_;
+  // stream items waiting for the write loop to finish, see
+  // write_stream_item()
+  std::vector<coro_io::callback_awaitor<void>::awaitor_handler>
+      written_waiters_;
+  // the items a stream may still send before the next ack of the client
+  struct stream_credit {
+    uint32_t credit = 0;
+    bool canceled = false;
+    std::optional<coro_io::callback_awaitor<void>::awaitor_handler> waiter;
+  };
+  // the running streams by seq_num, only used on executor_
+  std::unordered_map<uint32_t, stream_credit> streams_;
+  write_stats write_stats_;
+  // recycled response buffers, see take_buffer()
+  static constexpr std::size_t max_pooled_buffer_cnt = 64;
+  static constexpr std::size_t max_pooled_buffer_size = 64 * 1024;
+  std::vector<std::string> buffer_pool_;
   coro_rpc::errc resp_err_;
   rpc_call_type rpc_call_type_{non_callback};
 
@@ -543,6 +944,11 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
 
   std::any tag_;
 
+  std::shared_ptr<coro_io::keyed_rate_limiter> request_rate_limiter_;
+  bool rate_limit_by_function_ = false;
+  std::string client_ip_;
+  std::shared_ptr<coro_io::concurrency_limiter> concurrency_limiter_;
+
 #ifdef YLT_ENABLE_SSL
   std::unique_ptr<asio::ssl::stream<asio::ip::tcp::socket &>> ssl_stream_ =
       nullptr;
@@ -553,4 +959,12 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
 #endif
 };
 
+// a delayed request which is never responded gives its slot back here.
+template <typename rpc_protocol>
+context_info_t<rpc_protocol>::~context_info_t() {
+  if (conn_) {
+    conn_->release_concurrency_slot(*this);
+  }
+}
+
 }  // namespace coro_rpc
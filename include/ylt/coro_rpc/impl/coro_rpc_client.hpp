@@ -17,6 +17,7 @@
 #include <async_simple/Future.h>
 #include <async_simple/coro/FutureAwaiter.h>
 #include <async_simple/coro/Lazy.h>
+#include <async_simple/coro/Mutex.h>
 #include <async_simple/coro/SyncAwait.h>
 
 #include <array>
@@ -25,14 +26,19 @@
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <filesystem>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <system_error>
 #include <thread>
 #include <tuple>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <variant>
 #include <ylt/easylog.hpp>
@@ -104,6 +110,32 @@ using rpc_return_type_t = typename rpc_return_type<T>::type;
  *   syncAwait(show_rpc_call(client));
  * }
  * ```
+ *
+ * Calls are multiplexed on one connection: many coroutines can `call` the same
+ * client concurrently, requests are pipelined and each response is matched to
+ * its call by `seq_num`. On the server, delayed responses run beside the
+ * later requests, and so do coroutine functions without a context parameter
+ * when the server sets max_concurrent_calls, then a slow call doesn't hold up
+ * the others. Otherwise a function runs before the connection reads its next
+ * request.
+ *
+ * A streaming rpc function, one returning async_simple::coro::Generator<T>, is
+ * called by `call_stream`, and its items are read one at a time. It runs
+ * beside the other calls of the client, each stream has its own window of
+ * items, see call_stream():
+ *
+ * ```cpp
+ * Generator<int> count_to(int n) {
+ *   for (int i = 0; i < n; ++i) co_yield i;
+ * }
+ *
+ * auto stream = co_await client.call_stream<count_to>(100);
+ * while (true) {
+ *   auto item = co_await stream->next();
+ *   if (!item || !item.value()) break;  // error, or end of the stream
+ *   std::cout << *item.value() << std::endl;
+ * }
+ * ```
  */
 class coro_rpc_client {
   using coro_rpc_protocol = coro_rpc::protocol::coro_rpc_protocol;
@@ -117,6 +149,8 @@ class coro_rpc_client {
         std::chrono::milliseconds{5000};
     std::string host;
     std::string port;
+    // how many items of a stream the server may send ahead of its reader.
+    std::size_t stream_window = 16;
 #ifdef YLT_ENABLE_SSL
     std::filesystem::path ssl_cert_path;
     std::string ssl_domain;
@@ -280,65 +314,134 @@ class coro_rpc_client {
   async_simple::coro::Lazy<
       rpc_result<decltype(get_return_type<func>()), coro_rpc_protocol>>
   call_for(auto duration, Args... args) {
-    using R = decltype(get_return_type<func>());
+    std::string resp_attachment;
+    auto ret = co_await call_for_impl<func>(duration, resp_attachment,
+                                            std::move(args)...);
+    resp_attachment_buf_ = std::move(resp_attachment);
+    co_return ret;
+  }
+
+  /*!
+   * The result of a call together with the attachment of its response.
+   */
+  template <typename T>
+  struct call_result {
+    rpc_result<T, coro_rpc_protocol> result;
+    std::string resp_attachment;
+  };
+
+  /*!
+   * Call RPC function with default timeout (5 second), and return the
+   * attachment of the response with the result. Unlike
+   * get_resp_attachment(), it's not overwritten by other calls in flight on
+   * this client.
+   */
+  template <auto func, typename... Args>
+  async_simple::coro::Lazy<call_result<decltype(get_return_type<func>())>>
+  call_with_attachment(Args... args) {
+    return call_for_with_attachment<func>(std::chrono::seconds(5),
+                                          std::move(args)...);
+  }
+
+  /*!
+   * Like call_with_attachment(), with the timeout set explicitly.
+   */
+  template <auto func, typename... Args>
+  async_simple::coro::Lazy<call_result<decltype(get_return_type<func>())>>
+  call_for_with_attachment(auto duration, Args... args) {
+    call_result<decltype(get_return_type<func>())> ret;
+    ret.result = co_await call_for_impl<func>(duration, ret.resp_attachment,
+                                              std::move(args)...);
+    co_return ret;
+  }
+
+  template <typename T>
+  class stream;
 
+  /*!
+   * Call a streaming RPC function, which returns
+   * async_simple::coro::Generator<T>
+   *
+   * The items are read by the returned stream. The server sends at most
+   * `config::stream_window` items ahead of the reader, the reader acks them
+   * as it goes, so a slow reader slows the server down instead of piling up
+   * items. The other calls of the client aren't held up meanwhile. A stream
+   * has no timeout, close the client to give up. Destroying the stream
+   * cancels it, the server stops at its next item.
+   *
+   * Only responses are streamed; the arguments are sent as one request, there
+   * is no client-to-server streaming.
+   *
+   * @tparam func the address of RPC function
+   * @tparam Args the type of arguments
+   * @param args RPC function arguments
+   * @return the stream, or the error of sending the request
+   */
+  template <auto func, typename... Args>
+  async_simple::coro::Lazy<
+      rpc_result<stream<stream_item_t<func>>, coro_rpc_protocol>>
+  call_stream(Args... args) {
+    static_assert(is_stream_function_v<func>,
+                  "call_stream needs a function returning a Generator");
+    using result_t =
+        rpc_result<stream<stream_item_t<func>>, coro_rpc_protocol>;
     if (has_closed_)
       AS_UNLIKELY {
         ELOGV(ERROR, "client has been closed, please re-connect");
-        auto ret = rpc_result<R, coro_rpc_protocol>{
+        co_return result_t{
             unexpect_t{},
             coro_rpc_protocol::rpc_error{
                 errc::io_error, "client has been closed, please re-connect"}};
-        co_return ret;
       }
-
-    rpc_result<R, coro_rpc_protocol> ret;
-#ifdef YLT_ENABLE_SSL
-    if (!ssl_init_ret_) {
-      ret = rpc_result<R, coro_rpc_protocol>{
-          unexpect_t{},
-          coro_rpc_protocol::rpc_error{
-              errc::not_connected,
-              std::string{make_error_message(errc::not_connected)}}};
-      co_return ret;
-    }
-#endif
-
     static_check<func, Args...>();
 
-    async_simple::Promise<async_simple::Unit> promise;
-    coro_io::period_timer timer(&executor);
-    timeout(timer, duration, promise, "rpc call timer canceled")
-        .via(&executor)
-        .detach();
+    auto seq_num = next_seq_num_.fetch_add(1, std::memory_order_relaxed);
+    auto control = control_;
+    auto state = register_stream(control, seq_num);
+    stream<stream_item_t<func>> reader(control, state, seq_num,
+                                       stream_msg_sender(control, seq_num));
 
-#ifdef YLT_ENABLE_SSL
-    if (!config_.ssl_cert_path.empty()) {
-      assert(ssl_stream_);
-      ret = co_await call_impl<func>(*ssl_stream_, std::move(args)...);
+    auto buffer = prepare_buffer<func>(std::move(args)...);
+    auto req_attachment = std::exchange(req_attachment_, {});
+    if (buffer.empty()) {
+      co_return result_t{
+          unexpect_t{},
+          coro_rpc_protocol::rpc_error{errc::message_too_large,
+                                       "rpc body serialize size too big"}};
     }
-    else {
+    ((coro_rpc_protocol::req_header *)buffer.data())->seq_num = seq_num;
+    // the first ack opens the window.
+    auto window = static_cast<uint32_t>(state->window_);
+    std::error_code ec;
+    {
+      auto lock = co_await control->write_mutex_.coScopedLock();
+#ifdef YLT_ENABLE_SSL
+      if (!config_.ssl_cert_path.empty()) {
+        assert(ssl_stream_);
+        ec = co_await write_request(*ssl_stream_, buffer, req_attachment);
+        if (!ec) {
+          ec = co_await write_stream_msg(
+              *ssl_stream_, coro_rpc_protocol::stream_ack_msg, seq_num, window);
+        }
+      }
+      else {
 #endif
-      ret = co_await call_impl<func>(*socket_, std::move(args)...);
+        ec = co_await write_request(*socket_, buffer, req_attachment);
+        if (!ec) {
+          ec = co_await write_stream_msg(
+              *socket_, coro_rpc_protocol::stream_ack_msg, seq_num, window);
+        }
 #ifdef YLT_ENABLE_SSL
-    }
+      }
 #endif
-
-    std::error_code err_code;
-    timer.cancel(err_code);
-
-    if (is_timeout_) {
-      ret = rpc_result<R, coro_rpc_protocol>{
-          unexpect_t{},
-          coro_rpc_protocol::rpc_error{errc::timed_out, "rpc call timed out"}};
     }
-
-    co_await promise.getFuture();
-#ifdef UNIT_TEST_INJECT
-    ELOGV(INFO, "client_id %d call %s %s", config_.client_id,
-          get_func_name<func>().data(), ret ? "ok" : "failed");
-#endif
-    co_return ret;
+    if (ec) {
+      close();
+      co_return result_t{unexpect_t{},
+                         coro_rpc_protocol::rpc_error{errc::io_error,
+                                                      ec.message()}};
+    }
+    co_return std::move(reader);
   }
 
   /*!
@@ -366,6 +469,11 @@ class coro_rpc_client {
     return true;
   }
 
+  /*!
+   * The attachment of the response of the last call()/call_for() which
+   * finished. Another call finishing concurrently on this client overwrites
+   * it, use call_with_attachment() when calls run concurrently.
+   */
   std::string_view get_resp_attachment() const { return resp_attachment_buf_; }
 
   std::string release_resp_attachment() {
@@ -382,14 +490,243 @@ class coro_rpc_client {
     bool value = false;
   };
 
+  /*!
+   * A complete response read from the connection, or the error which
+   * prevented it from being read.
+   */
+  struct response_t {
+    std::error_code ec;
+    coro_rpc_protocol::resp_header header;
+    std::string body;
+    std::string attachment;
+  };
+
+  /*!
+   * The messages of a streaming call read from the connection but not yet by
+   * the stream. `reader_waiter_` is set while the stream waits for a message.
+   * `unacked_` counts the items read since the last ack, there are at most
+   * `window_` of them in flight.
+   */
+  struct stream_state_t {
+    std::mutex mtx_;
+    std::deque<response_t> messages_;
+    std::optional<async_simple::Promise<async_simple::Unit>> reader_waiter_;
+    std::size_t window_ = 16;
+    std::size_t unacked_ = 0;
+    bool abandoned_ = false;
+  };
+
+  /*!
+   * Per-connection state shared by all in-flight calls and the reader
+   * coroutine. The reader may outlive the client, so it holds its own copy.
+   */
+  struct control_t {
+    control_t(asio::io_context::executor_type executor) : executor_(executor) {}
+    std::mutex mtx_;
+    std::unordered_map<uint32_t, async_simple::Promise<response_t>>
+        pending_calls_;
+    std::unordered_map<uint32_t, std::shared_ptr<stream_state_t>> streams_;
+    bool is_recving_ = false;
+    coro_io::ExecutorWrapper<> executor_;
+    // requests of concurrent calls and stream acks must not interleave on
+    // the wire.
+    async_simple::coro::Mutex write_mutex_;
+  };
+
+  // writes a stream message of a stream started by call_stream()
+  using stream_msg_sender_t = std::function<async_simple::coro::Lazy<void>(
+      coro_rpc_protocol::req_msg_type, uint32_t)>;
+
+ public:
+  /*!
+   * The reader of a streaming call, see call_stream().
+   */
+  template <typename T>
+  class stream {
+   public:
+    stream() = default;
+    stream(stream &&) = default;
+    stream &operator=(stream &&other) {
+      if (this != &other) {
+        abandon();
+        control_ = std::move(other.control_);
+        state_ = std::move(other.state_);
+        seq_num_ = other.seq_num_;
+        send_msg_ = std::move(other.send_msg_);
+      }
+      return *this;
+    }
+    ~stream() { abandon(); }
+
+    /*!
+     * Read the next item of the stream.
+     *
+     * @return the item, std::nullopt once the stream has ended, or the error
+     * of the call.
+     */
+    async_simple::coro::Lazy<rpc_result<std::optional<T>, coro_rpc_protocol>>
+    next() {
+      using result_t = rpc_result<std::optional<T>, coro_rpc_protocol>;
+      if (!state_)
+        AS_UNLIKELY { co_return result_t{}; }
+      response_t resp;
+      std::size_t ack = 0;
+      while (true) {
+        std::optional<async_simple::Future<async_simple::Unit>> wait;
+        {
+          std::lock_guard lock(state_->mtx_);
+          if (!state_->messages_.empty()) {
+            resp = std::move(state_->messages_.front());
+            state_->messages_.pop_front();
+            // ack every half window, so the server rarely waits for us.
+            if (resp.header.msg_type == coro_rpc_protocol::stream_item_msg &&
+                ++state_->unacked_ >= (state_->window_ + 1) / 2) {
+              ack = std::exchange(state_->unacked_, 0);
+            }
+          }
+          else {
+            async_simple::Promise<async_simple::Unit> promise;
+            wait = promise.getFuture();
+            state_->reader_waiter_ = std::move(promise);
+          }
+        }
+        if (!wait) {
+          break;
+        }
+        co_await std::move(*wait);
+      }
+      if (ack != 0) {
+        co_await send_msg_(coro_rpc_protocol::stream_ack_msg,
+                           static_cast<uint32_t>(ack));
+      }
+
+      if (resp.ec)
+        AS_UNLIKELY {
+          state_ = nullptr;
+          co_return result_t{unexpect_t{},
+                             coro_rpc_protocol::rpc_error{
+                                 errc::io_error, resp.ec.message()}};
+        }
+      if (resp.header.msg_type == coro_rpc_protocol::stream_item_msg &&
+          resp.header.err_code == 0)
+        AS_LIKELY {
+          T item;
+          if (struct_pack::deserialize_to(item, resp.body))
+            AS_UNLIKELY {
+              abandon();
+              co_return result_t{
+                  unexpect_t{},
+                  coro_rpc_protocol::rpc_error{
+                      errc::invalid_argument,
+                      "failed to deserialize rpc stream item"}};
+            }
+          co_return std::optional<T>{std::move(item)};
+        }
+      // the end of the stream: the void result of the call, or its error.
+      state_ = nullptr;
+      bool error_happen = false;
+      auto ret =
+          handle_response_buffer<void>(resp.body, resp.header.err_code,
+                                       error_happen);
+      if (!ret)
+        AS_UNLIKELY {
+          co_return result_t{unexpect_t{}, std::move(ret.error())};
+        }
+      co_return result_t{};
+    }
+
+   private:
+    friend class coro_rpc_client;
+    stream(std::shared_ptr<control_t> control,
+           std::shared_ptr<stream_state_t> state, uint32_t seq_num,
+           stream_msg_sender_t send_msg)
+        : control_(std::move(control)),
+          state_(std::move(state)),
+          seq_num_(seq_num),
+          send_msg_(std::move(send_msg)) {}
+
+    // cancel the stream if it is still running, the items already sent are
+    // discarded as they come in, until its end.
+    void abandon() {
+      if (!state_) {
+        return;
+      }
+      bool is_running;
+      {
+        std::lock_guard lock(control_->mtx_);
+        is_running = control_->streams_.contains(seq_num_);
+      }
+      {
+        std::lock_guard lock(state_->mtx_);
+        state_->abandoned_ = true;
+        state_->messages_.clear();
+      }
+      if (is_running) {
+        send_msg_(coro_rpc_protocol::stream_cancel_msg, 0)
+            .via(&control_->executor_)
+            .start([](auto &&) {
+            });
+      }
+      state_ = nullptr;
+    }
+
+    std::shared_ptr<control_t> control_;
+    std::shared_ptr<stream_state_t> state_;
+    uint32_t seq_num_ = 0;
+    stream_msg_sender_t send_msg_;
+  };
+
+ private:
+
   void reset() {
     close_socket(socket_);
     socket_ =
         std::make_shared<asio::ip::tcp::socket>(executor.get_asio_executor());
+    control_ = std::make_shared<control_t>(executor.get_asio_executor());
     is_timeout_ = false;
     has_closed_ = false;
   }
   static bool is_ok(coro_rpc::err_code ec) noexcept { return !ec; }
+
+  // The std::errc of a failed call, for the outlier detection of
+  // coro_io::client_pool. Errors returned by the function itself have none,
+  // the host did answer.
+  static std::optional<std::errc> error_errc(coro_rpc::err_code code) noexcept {
+    switch (code.ec) {
+      case errc::ok:
+        return std::nullopt;
+      case errc::io_error:
+        return std::errc::io_error;
+      case errc::not_connected:
+        return std::errc::not_connected;
+      case errc::timed_out:
+        return std::errc::timed_out;
+      case errc::operation_canceled:
+        return std::errc::operation_canceled;
+      case errc::interrupted:
+        return std::errc::interrupted;
+      case errc::protocol_error:
+      case errc::unknown_protocol_version:
+        return std::errc::protocol_error;
+      case errc::message_too_large:
+        return std::errc::message_size;
+      case errc::too_many_requests:
+      case errc::server_busy:
+        return std::errc::resource_unavailable_try_again;
+      default:
+        return std::nullopt;
+    }
+  }
+  template <typename T>
+  static std::optional<std::errc> result_errc(
+      const rpc_result<T, coro_rpc_protocol> &ret) noexcept {
+    return ret ? std::nullopt : error_errc(ret.error().code);
+  }
+  template <typename T>
+  static std::optional<std::errc> result_errc(
+      const call_result<T> &ret) noexcept {
+    return result_errc(ret.result);
+  }
   [[nodiscard]] async_simple::coro::Lazy<coro_rpc::err_code> connect(
       is_reconnect_t is_reconnect = is_reconnect_t{false}) {
 #ifdef YLT_ENABLE_SSL
@@ -469,7 +806,7 @@ class coro_rpc_client {
       ssl_ctx_.set_verify_callback(
           asio::ssl::host_name_verification(config_.ssl_domain));
       ssl_stream_ =
-          std::make_unique<asio::ssl::stream<asio::ip::tcp::socket &>>(
+          std::make_shared<asio::ssl::stream<asio::ip::tcp::socket &>>(
               *socket_, ssl_ctx_);
       ssl_init_ret_ = true;
     } catch (std::exception &e) {
@@ -543,22 +880,348 @@ class coro_rpc_client {
     }
   }
 
+  async_simple::coro::Lazy<void> call_timeout(auto &timer, auto duration,
+                                              auto &promise,
+                                              control_t &control,
+                                              uint32_t seq_num,
+                                              std::atomic<bool> &is_writing) {
+    timer.expires_after(duration);
+    bool is_timeout = co_await timer.async_await();
+#ifdef UNIT_TEST_INJECT
+    ELOGV(INFO, "client_id %d seq_num %d rpc call timer canceled, %d",
+          config_.client_id, seq_num, is_timeout);
+#endif
+    if (is_timeout) {
+      // A stalled write can't be withdrawn without corrupting the stream, so
+      // the connection is closed in that case. Otherwise only this call
+      // fails and its late response will be discarded by the reader.
+      if (is_writing) {
+        close();
+      }
+      finish_call(control, seq_num,
+                  std::make_error_code(std::errc::timed_out));
+    }
+    promise.setValue(async_simple::Unit());
+  }
+
+  async_simple::Future<response_t> register_call(
+      const std::shared_ptr<control_t> &control, uint32_t seq_num) {
+    async_simple::Promise<response_t> promise;
+    auto future = promise.getFuture();
+    bool need_start_recv = false;
+    {
+      std::lock_guard lock(control->mtx_);
+      control->pending_calls_.emplace(seq_num, std::move(promise));
+      need_start_recv = !std::exchange(control->is_recving_, true);
+    }
+    if (need_start_recv) {
+      start_recv(control);
+    }
+    return future;
+  }
+
+  std::shared_ptr<stream_state_t> register_stream(
+      const std::shared_ptr<control_t> &control, uint32_t seq_num) {
+    auto state = std::make_shared<stream_state_t>();
+    state->window_ = (std::max<std::size_t>)(config_.stream_window, 1);
+    bool need_start_recv = false;
+    {
+      std::lock_guard lock(control->mtx_);
+      control->streams_.emplace(seq_num, state);
+      need_start_recv = !std::exchange(control->is_recving_, true);
+    }
+    if (need_start_recv) {
+      start_recv(control);
+    }
+    return state;
+  }
+
+  void start_recv(const std::shared_ptr<control_t> &control) {
+#ifdef YLT_ENABLE_SSL
+    if (!config_.ssl_cert_path.empty()) {
+      assert(ssl_stream_);
+      recv_loop(control, ssl_stream_, socket_)
+          .via(&control->executor_)
+          .start([](auto &&) {
+          });
+      return;
+    }
+#endif
+    recv_loop(control, socket_, socket_)
+        .via(&control->executor_)
+        .start([](auto &&) {
+        });
+  }
+
+  /*!
+   * Queue a message for the stream's reader. The server sends no more than
+   * a window of items ahead of the acks, so the queue stays short.
+   */
+  static void push_stream_message(stream_state_t &state, response_t &&resp) {
+    std::optional<async_simple::Promise<async_simple::Unit>> reader_waiter;
+    {
+      std::lock_guard lock(state.mtx_);
+      if (state.abandoned_) {
+        return;
+      }
+      state.messages_.push_back(std::move(resp));
+      reader_waiter = std::exchange(state.reader_waiter_, std::nullopt);
+    }
+    if (reader_waiter) {
+      reader_waiter->setValue(async_simple::Unit{});
+    }
+  }
+
+  stream_msg_sender_t stream_msg_sender(std::shared_ptr<control_t> control,
+                                        uint32_t seq_num) {
+#ifdef YLT_ENABLE_SSL
+    if (!config_.ssl_cert_path.empty()) {
+      assert(ssl_stream_);
+      return [control, stream = ssl_stream_, socket = socket_, seq_num](
+                 coro_rpc_protocol::req_msg_type msg_type, uint32_t count) {
+        return send_stream_msg(control, stream, socket, msg_type, seq_num,
+                               count);
+      };
+    }
+#endif
+    return [control, socket = socket_, seq_num](
+               coro_rpc_protocol::req_msg_type msg_type, uint32_t count) {
+      return send_stream_msg(control, socket, socket, msg_type, seq_num,
+                             count);
+    };
+  }
+
+  // a broken connection is reported to the stream by the reader, so the
+  // error of the write is ignored.
+  template <typename Stream>
+  static async_simple::coro::Lazy<void> send_stream_msg(
+      std::shared_ptr<control_t> control, std::shared_ptr<Stream> stream,
+      std::shared_ptr<asio::ip::tcp::socket> socket,
+      coro_rpc_protocol::req_msg_type msg_type, uint32_t seq_num,
+      uint32_t count) {
+    auto lock = co_await control->write_mutex_.coScopedLock();
+    co_await write_stream_msg(*stream, msg_type, seq_num, count);
+  }
+
+  template <typename Socket>
+  static async_simple::coro::Lazy<std::error_code> write_stream_msg(
+      Socket &socket, coro_rpc_protocol::req_msg_type msg_type,
+      uint32_t seq_num, uint32_t count) {
+    auto header = coro_rpc_protocol::make_stream_msg(msg_type, seq_num, count);
+    auto ret = co_await coro_io::async_write(
+        socket, asio::buffer(&header, sizeof(header)));
+    co_return ret.first;
+  }
+
+  /*!
+   * Complete the call `seq_num` with an error if it is still pending.
+   *
+   * @return false if the call has already been completed.
+   */
+  static bool finish_call(control_t &control, uint32_t seq_num,
+                          std::error_code ec) {
+    async_simple::Promise<response_t> promise;
+    {
+      std::lock_guard lock(control.mtx_);
+      auto iter = control.pending_calls_.find(seq_num);
+      if (iter == control.pending_calls_.end()) {
+        return false;
+      }
+      promise = std::move(iter->second);
+      control.pending_calls_.erase(iter);
+    }
+    promise.setValue(response_t{.ec = ec});
+    return true;
+  }
+
+  static void finish_all_calls(control_t &control, std::error_code ec) {
+    std::unordered_map<uint32_t, async_simple::Promise<response_t>> calls;
+    std::unordered_map<uint32_t, std::shared_ptr<stream_state_t>> streams;
+    {
+      std::lock_guard lock(control.mtx_);
+      calls = std::move(control.pending_calls_);
+      control.pending_calls_.clear();
+      streams = std::move(control.streams_);
+      control.streams_.clear();
+      control.is_recving_ = false;
+    }
+    for (auto &[_, promise] : calls) {
+      promise.setValue(response_t{.ec = ec});
+    }
+    for (auto &[_, state] : streams) {
+      push_stream_message(*state, response_t{.ec = ec});
+    }
+  }
+
+  /*!
+   * Read responses from the connection and dispatch them to the pending calls
+   * by sequence number, until no call is waiting or the connection breaks.
+   * Responses of calls which have already timed out are discarded.
+   */
+  template <typename Stream>
+  static async_simple::coro::Lazy<void> recv_loop(
+      std::shared_ptr<control_t> control, std::shared_ptr<Stream> stream,
+      std::shared_ptr<asio::ip::tcp::socket> socket) {
+    while (true) {
+      response_t resp;
+      auto &header = resp.header;
+      auto ret = co_await coro_io::async_read(
+          *stream,
+          asio::buffer((char *)&header, coro_rpc_protocol::RESP_HEAD_LEN));
+      if (!ret.first) {
+        struct_pack::detail::resize(resp.body, header.length);
+        if (header.attach_length == 0) {
+          ret = co_await coro_io::async_read(
+              *stream, asio::buffer(resp.body.data(), resp.body.size()));
+        }
+        else {
+          struct_pack::detail::resize(resp.attachment, header.attach_length);
+          std::array<asio::mutable_buffer, 2> iov{
+              asio::mutable_buffer{resp.body.data(), resp.body.size()},
+              asio::mutable_buffer{resp.attachment.data(),
+                                   resp.attachment.size()}};
+          ret = co_await coro_io::async_read(*stream, iov);
+        }
+      }
+      if (ret.first) {
+        finish_all_calls(*control, ret.first);
+        co_return;
+      }
+
+      async_simple::Promise<response_t> promise;
+      std::shared_ptr<stream_state_t> stream_state;
+      bool has_call = false;
+      {
+        std::lock_guard lock(control->mtx_);
+        auto iter = control->pending_calls_.find(header.seq_num);
+        if (iter != control->pending_calls_.end()) {
+          promise = std::move(iter->second);
+          control->pending_calls_.erase(iter);
+          has_call = true;
+        }
+        else if (auto it = control->streams_.find(header.seq_num);
+                 it != control->streams_.end()) {
+          stream_state = it->second;
+          if (header.msg_type != coro_rpc_protocol::stream_item_msg ||
+              header.err_code != 0) {
+            control->streams_.erase(it);
+          }
+        }
+      }
+      if (has_call) {
+        promise.setValue(std::move(resp));
+      }
+      else if (stream_state) {
+        push_stream_message(*stream_state, std::move(resp));
+      }
+      else {
+        ELOGV(WARN, "discard response of seq_num %d, the call has finished",
+              header.seq_num);
+      }
+
+      std::lock_guard lock(control->mtx_);
+      if (control->pending_calls_.empty() && control->streams_.empty()) {
+        control->is_recving_ = false;
+        co_return;
+      }
+    }
+  }
+
+  // the attachment of the response is moved to resp_attachment.
+  template <auto func, typename... Args>
+  async_simple::coro::Lazy<
+      rpc_result<decltype(get_return_type<func>()), coro_rpc_protocol>>
+  call_for_impl(auto duration, std::string &resp_attachment, Args... args) {
+    static_assert(!is_stream_function_v<func>,
+                  "call a streaming rpc function by call_stream");
+    using R = decltype(get_return_type<func>());
+
+    if (has_closed_)
+      AS_UNLIKELY {
+        ELOGV(ERROR, "client has been closed, please re-connect");
+        auto ret = rpc_result<R, coro_rpc_protocol>{
+            unexpect_t{},
+            coro_rpc_protocol::rpc_error{
+                errc::io_error, "client has been closed, please re-connect"}};
+        co_return ret;
+      }
+
+    rpc_result<R, coro_rpc_protocol> ret;
+#ifdef YLT_ENABLE_SSL
+    if (!ssl_init_ret_) {
+      ret = rpc_result<R, coro_rpc_protocol>{
+          unexpect_t{},
+          coro_rpc_protocol::rpc_error{
+              errc::not_connected,
+              std::string{make_error_message(errc::not_connected)}}};
+      co_return ret;
+    }
+#endif
+
+    static_check<func, Args...>();
+
+    // Every call gets its own sequence number, so that many calls can be in
+    // flight on one connection and the responses can come back in any order.
+    auto seq_num = next_seq_num_.fetch_add(1, std::memory_order_relaxed);
+    auto control = control_;
+    auto future = register_call(control, seq_num);
+    std::atomic<bool> is_writing = false;
+
+    async_simple::Promise<async_simple::Unit> promise;
+    coro_io::period_timer timer(&executor);
+    call_timeout(timer, duration, promise, *control, seq_num, is_writing)
+        .via(&executor)
+        .detach();
+
+#ifdef YLT_ENABLE_SSL
+    if (!config_.ssl_cert_path.empty()) {
+      assert(ssl_stream_);
+      ret = co_await call_impl<func>(*ssl_stream_, control, seq_num,
+                                     std::move(future), is_writing,
+                                     resp_attachment, std::move(args)...);
+    }
+    else {
+#endif
+      ret = co_await call_impl<func>(*socket_, control, seq_num,
+                                     std::move(future), is_writing,
+                                     resp_attachment, std::move(args)...);
+#ifdef YLT_ENABLE_SSL
+    }
+#endif
+
+    std::error_code err_code;
+    timer.cancel(err_code);
+
+    co_await promise.getFuture();
+#ifdef UNIT_TEST_INJECT
+    ELOGV(INFO, "client_id %d call %s %s", config_.client_id,
+          get_func_name<func>().data(), ret ? "ok" : "failed");
+#endif
+    co_return ret;
+  }
+
   template <auto func, typename Socket, typename... Args>
   async_simple::coro::Lazy<
       rpc_result<decltype(get_return_type<func>()), coro_rpc_protocol>>
-  call_impl(Socket &socket, Args... args) {
+  call_impl(Socket &socket, std::shared_ptr<control_t> control,
+            uint32_t seq_num, async_simple::Future<response_t> future,
+            std::atomic<bool> &is_writing, std::string &resp_attachment,
+            Args... args) {
     using R = decltype(get_return_type<func>());
 
     auto buffer = prepare_buffer<func>(std::move(args)...);
+    auto req_attachment = std::exchange(req_attachment_, {});
 
     rpc_result<R, coro_rpc_protocol> r{};
     if (buffer.empty()) {
+      finish_call(*control, seq_num, {});
       r = rpc_result<R, coro_rpc_protocol>{
           unexpect_t{},
           coro_rpc_protocol::rpc_error{errc::message_too_large,
                                        "rpc body serialize size too big"}};
       co_return r;
     }
+    ((coro_rpc_protocol::req_header *)buffer.data())->seq_num = seq_num;
 #ifdef GENERATE_BENCHMARK_DATA
     std::ofstream file(
         benchmark_file_path + std::string{get_func_name<func>()} + ".in",
@@ -567,111 +1230,101 @@ class coro_rpc_client {
     file.close();
 #endif
     std::pair<std::error_code, size_t> ret;
+    {
+      auto lock = co_await control->write_mutex_.coScopedLock();
+      is_writing = true;
 #ifdef UNIT_TEST_INJECT
-    if (g_action == inject_action::client_send_bad_header) {
-      buffer[0] = (std::byte)(uint8_t(buffer[0]) + 1);
-    }
-    if (g_action == inject_action::client_close_socket_after_send_header) {
-      ret = co_await coro_io::async_write(
-          socket, asio::buffer(buffer.data(), coro_rpc_protocol::REQ_HEAD_LEN));
-      ELOGV(INFO, "client_id %d close socket", config_.client_id);
-      close();
-      r = rpc_result<R, coro_rpc_protocol>{
-          unexpect_t{},
-          coro_rpc_protocol::rpc_error{errc::io_error, ret.first.message()}};
-      co_return r;
-    }
-    else if (g_action ==
-             inject_action::client_close_socket_after_send_partial_header) {
-      ret = co_await coro_io::async_write(
-          socket,
-          asio::buffer(buffer.data(), coro_rpc_protocol::REQ_HEAD_LEN - 1));
-      ELOGV(INFO, "client_id %d close socket", config_.client_id);
-      close();
-      r = rpc_result<R, coro_rpc_protocol>{
-          unexpect_t{},
-          coro_rpc_protocol::rpc_error{errc::io_error, ret.first.message()}};
-      co_return r;
-    }
-    else if (g_action ==
-             inject_action::client_shutdown_socket_after_send_header) {
-      ret = co_await coro_io::async_write(
-          socket, asio::buffer(buffer.data(), coro_rpc_protocol::REQ_HEAD_LEN));
-      ELOGV(INFO, "client_id %d shutdown", config_.client_id);
-      socket_->shutdown(asio::ip::tcp::socket::shutdown_send);
-      r = rpc_result<R, coro_rpc_protocol>{
-          unexpect_t{},
-          coro_rpc_protocol::rpc_error{errc::io_error, ret.first.message()}};
-      co_return r;
-    }
-    else {
-#endif
-      if (req_attachment_.empty()) {
+      if (g_action == inject_action::client_send_bad_header) {
+        buffer[0] = (std::byte)(uint8_t(buffer[0]) + 1);
+      }
+      if (g_action == inject_action::client_close_socket_after_send_header) {
         ret = co_await coro_io::async_write(
-            socket, asio::buffer(buffer.data(), buffer.size()));
+            socket,
+            asio::buffer(buffer.data(), coro_rpc_protocol::REQ_HEAD_LEN));
+        ELOGV(INFO, "client_id %d close socket", config_.client_id);
+        close();
+        finish_call(*control, seq_num, ret.first);
+        r = rpc_result<R, coro_rpc_protocol>{
+            unexpect_t{},
+            coro_rpc_protocol::rpc_error{errc::io_error, ret.first.message()}};
+        co_return r;
       }
-      else {
-        std::array<asio::const_buffer, 2> iov{
-            asio::const_buffer{buffer.data(), buffer.size()},
-            asio::const_buffer{req_attachment_.data(), req_attachment_.size()}};
-        ret = co_await coro_io::async_write(socket, iov);
-        req_attachment_ = {};
+      else if (g_action ==
+               inject_action::client_close_socket_after_send_partial_header) {
+        ret = co_await coro_io::async_write(
+            socket,
+            asio::buffer(buffer.data(), coro_rpc_protocol::REQ_HEAD_LEN - 1));
+        ELOGV(INFO, "client_id %d close socket", config_.client_id);
+        close();
+        finish_call(*control, seq_num, ret.first);
+        r = rpc_result<R, coro_rpc_protocol>{
+            unexpect_t{},
+            coro_rpc_protocol::rpc_error{errc::io_error, ret.first.message()}};
+        co_return r;
       }
-#ifdef UNIT_TEST_INJECT
-    }
-#endif
-    if (!ret.first) {
-#ifdef UNIT_TEST_INJECT
-      if (g_action == inject_action::client_close_socket_after_send_payload) {
-        ELOGV(INFO, "client_id %d client_close_socket_after_send_payload",
-              config_.client_id);
+      else if (g_action ==
+               inject_action::client_shutdown_socket_after_send_header) {
+        ret = co_await coro_io::async_write(
+            socket,
+            asio::buffer(buffer.data(), coro_rpc_protocol::REQ_HEAD_LEN));
+        ELOGV(INFO, "client_id %d shutdown", config_.client_id);
+        socket_->shutdown(asio::ip::tcp::socket::shutdown_send);
+        finish_call(*control, seq_num, ret.first);
         r = rpc_result<R, coro_rpc_protocol>{
             unexpect_t{},
             coro_rpc_protocol::rpc_error{errc::io_error, ret.first.message()}};
-        close();
         co_return r;
       }
+      else {
 #endif
-      coro_rpc_protocol::resp_header header;
-      ret = co_await coro_io::async_read(
-          socket,
-          asio::buffer((char *)&header, coro_rpc_protocol::RESP_HEAD_LEN));
-      if (!ret.first) {
-        uint32_t body_len = header.length;
-        struct_pack::detail::resize(read_buf_, body_len);
-        if (header.attach_length == 0) {
-          ret = co_await coro_io::async_read(
-              socket, asio::buffer(read_buf_.data(), body_len));
-          resp_attachment_buf_.clear();
-        }
-        else {
-          struct_pack::detail::resize(resp_attachment_buf_,
-                                      header.attach_length);
-          std::array<asio::mutable_buffer, 2> iov{
-              asio::mutable_buffer{read_buf_.data(), body_len},
-              asio::mutable_buffer{resp_attachment_buf_.data(),
-                                   resp_attachment_buf_.size()}};
-          ret = co_await coro_io::async_read(socket, iov);
-        }
-        if (!ret.first) {
+        ret.first = co_await write_request(socket, buffer, req_attachment);
+#ifdef UNIT_TEST_INJECT
+      }
+#endif
+      is_writing = false;
+    }
+    if (ret.first) {
+      finish_call(*control, seq_num, ret.first);
+    }
+#ifdef UNIT_TEST_INJECT
+    else if (g_action == inject_action::client_close_socket_after_send_payload) {
+      ELOGV(INFO, "client_id %d client_close_socket_after_send_payload",
+            config_.client_id);
+      finish_call(*control, seq_num, ret.first);
+      r = rpc_result<R, coro_rpc_protocol>{
+          unexpect_t{},
+          coro_rpc_protocol::rpc_error{errc::io_error, ret.first.message()}};
+      close();
+      co_return r;
+    }
+#endif
+
+    auto resp = co_await std::move(future);
+    if (!resp.ec) {
 #ifdef GENERATE_BENCHMARK_DATA
-          std::ofstream file(
-              benchmark_file_path + std::string{get_func_name<func>()} + ".out",
-              std::ofstream::binary | std::ofstream::out);
-          file << std::string_view{(char *)&header,
-                                   coro_rpc_protocol::RESP_HEAD_LEN};
-          file << read_buf_;
-          file << resp_attachment_buf_;
-          file.close();
+      std::ofstream file(
+          benchmark_file_path + std::string{get_func_name<func>()} + ".out",
+          std::ofstream::binary | std::ofstream::out);
+      file << std::string_view{(char *)&resp.header,
+                               coro_rpc_protocol::RESP_HEAD_LEN};
+      file << resp.body;
+      file << resp.attachment;
+      file.close();
 #endif
-          bool ec = false;
-          r = handle_response_buffer<R>(read_buf_, header.err_code, ec);
-          if (ec) {
-            close();
-          }
-          co_return r;
-        }
+      resp_attachment = std::move(resp.attachment);
+      bool ec = false;
+      r = handle_response_buffer<R>(resp.body, resp.header.err_code, ec);
+      if (ec) {
+        close();
       }
+      co_return r;
+    }
+    if (resp.ec == std::errc::timed_out) {
+      // only this call timed out, the connection is still usable.
+      r = rpc_result<R, coro_rpc_protocol>{
+          unexpect_t{},
+          coro_rpc_protocol::rpc_error{.code = errc::timed_out, .msg = {}}};
+      co_return r;
     }
 #ifdef UNIT_TEST_INJECT
     if (g_action == inject_action::force_inject_client_write_data_timeout) {
@@ -687,11 +1340,30 @@ class coro_rpc_client {
       r = rpc_result<R, coro_rpc_protocol>{
           unexpect_t{},
           coro_rpc_protocol::rpc_error{.code = errc::io_error,
-                                       .msg = ret.first.message()}};
+                                       .msg = resp.ec.message()}};
     }
     close();
     co_return r;
   }
+  // write a request prepared by prepare_buffer, with its attachment.
+  template <typename Socket>
+  static async_simple::coro::Lazy<std::error_code> write_request(
+      Socket &socket, const std::vector<std::byte> &buffer,
+      std::string_view req_attachment) {
+    std::pair<std::error_code, size_t> ret;
+    if (req_attachment.empty()) {
+      ret = co_await coro_io::async_write(
+          socket, asio::buffer(buffer.data(), buffer.size()));
+    }
+    else {
+      std::array<asio::const_buffer, 2> iov{
+          asio::const_buffer{buffer.data(), buffer.size()},
+          asio::const_buffer{req_attachment.data(), req_attachment.size()}};
+      ret = co_await coro_io::async_write(socket, iov);
+    }
+    co_return ret.first;
+  }
+
   /*
    * buffer layout
    * ┌────────────────┬────────────────┐
@@ -718,7 +1390,6 @@ class coro_rpc_client {
     header.function_id = func_id<func>();
     header.attach_length = req_attachment_.size();
 #ifdef UNIT_TEST_INJECT
-    header.seq_num = config_.client_id;
     if (g_action == inject_action::client_send_bad_magic_num) {
       header.magic = coro_rpc_protocol::magic_number + 1;
     }
@@ -740,9 +1411,8 @@ class coro_rpc_client {
   }
 
   template <typename T>
-  rpc_result<T, coro_rpc_protocol> handle_response_buffer(std::string &buffer,
-                                                          uint8_t rpc_errc,
-                                                          bool &error_happen) {
+  static rpc_result<T, coro_rpc_protocol> handle_response_buffer(
+      std::string &buffer, uint8_t rpc_errc, bool &error_happen) {
     rpc_return_type_t<T> ret;
     struct_pack::err_code ec;
     coro_rpc_protocol::rpc_error err;
@@ -763,7 +1433,9 @@ class coro_rpc_client {
       if (rpc_errc != UINT8_MAX) {
         ec = struct_pack::deserialize_to(err.msg, buffer);
         if SP_LIKELY (!ec) {
-          error_happen = true;
+          // the server keeps the connection open after rejecting a request.
+          error_happen = err.code != errc::too_many_requests &&
+                         err.code != errc::server_busy;
           return rpc_result<T, coro_rpc_protocol>{unexpect_t{}, std::move(err)};
         }
       }
@@ -834,13 +1506,15 @@ class coro_rpc_client {
  private:
   coro_io::ExecutorWrapper<> executor;
   std::shared_ptr<asio::ip::tcp::socket> socket_;
-  std::string read_buf_, resp_attachment_buf_;
+  std::shared_ptr<control_t> control_ =
+      std::make_shared<control_t>(executor.get_asio_executor());
+  std::atomic<uint32_t> next_seq_num_ = 0;
+  std::string resp_attachment_buf_;
   std::string_view req_attachment_;
   config config_;
-  constexpr static std::size_t default_read_buf_size_ = 256;
 #ifdef YLT_ENABLE_SSL
   asio::ssl::context ssl_ctx_{asio::ssl::context::sslv23};
-  std::unique_ptr<asio::ssl::stream<asio::ip::tcp::socket &>> ssl_stream_;
+  std::shared_ptr<asio::ssl::stream<asio::ip::tcp::socket &>> ssl_stream_;
   bool ssl_init_ret_ = true;
 #endif
   bool is_timeout_ = false;
@@ -84,7 +84,29 @@ class coro_rpc_server_base {
         acceptor_(pool_.get_executor()->get_asio_executor()),
         port_(config.port),
         conn_timeout_duration_(config.conn_timeout_duration),
-        flag_{stat::init} {}
+        flag_{stat::init} {
+    if constexpr (requires { config.reuse_port; }) {
+      reuse_port_ = config.reuse_port;
+    }
+    if constexpr (requires { config.request_rate_limiter; }) {
+      accept_rate_limiter_ = config.accept_rate_limiter;
+      request_rate_limiter_ = config.request_rate_limiter;
+      rate_limit_by_function_ = config.rate_limit_by_function;
+    }
+    if constexpr (requires { config.concurrency_limiter; }) {
+      concurrency_limiter_ = config.concurrency_limiter;
+    }
+    if constexpr (requires { config.max_concurrent_calls; }) {
+      max_concurrent_calls_ = config.max_concurrent_calls;
+    }
+    if constexpr (requires {
+                    pool_.set_cpu_affinity(*config.cpu_affinity);
+                  }) {
+      if (config.cpu_affinity) {
+        pool_.set_cpu_affinity(*config.cpu_affinity);
+      }
+    }
+  }
 
   ~coro_rpc_server_base() {
     ELOGV(INFO, "coro_rpc_server will quit");
@@ -133,6 +155,11 @@ class coro_rpc_server_base {
       }
       ec = listen();
       if (!ec) {
+        // registered functions are known by now, switch the router to its
+        // flat dispatch table.
+        if constexpr (requires { router_.freeze(); }) {
+          router_.freeze();
+        }
         if constexpr (requires(typename server_config::executor_pool_t & pool) {
                         pool.run();
                       }) {
@@ -147,16 +174,22 @@ class coro_rpc_server_base {
       }
     }
     if (!ec) {
+      for (auto &extra : reuse_port_acceptors_) {
+        accept(extra->acceptor, extra->close_waiter, extra->executor)
+            .via(extra->executor)
+            .detach();
+      }
       async_simple::Promise<coro_rpc::err_code> promise;
       auto future = promise.getFuture();
-      accept().start([p = std::move(promise)](auto &&res) mutable {
-        if (res.hasError()) {
-          p.setValue(coro_rpc::err_code{coro_rpc::errc::io_error});
-        }
-        else {
-          p.setValue(res.value());
-        }
-      });
+      accept(acceptor_, acceptor_close_waiter_, acceptor_owner())
+          .start([p = std::move(promise)](auto &&res) mutable {
+            if (res.hasError()) {
+              p.setValue(coro_rpc::err_code{coro_rpc::errc::io_error});
+            }
+            else {
+              p.setValue(res.value());
+            }
+          });
       return std::move(future);
     }
     else {
@@ -285,6 +318,100 @@ class coro_rpc_server_base {
   auto &get_io_context_pool() noexcept { return pool_; }
 
  private:
+  using executor_t = std::remove_pointer_t<
+      decltype(std::declval<typename server_config::executor_pool_t &>()
+                   .get_executor())>;
+
+  // an extra listening socket bound to the same port with SO_REUSEPORT, owned
+  // by one io thread.
+  struct reuse_port_acceptor {
+    reuse_port_acceptor(executor_t *executor)
+        : executor(executor), acceptor(executor->get_asio_executor()) {}
+    executor_t *executor;
+    asio::ip::tcp::acceptor acceptor;
+    std::promise<void> close_waiter;
+  };
+
+  // reuse_port needs SO_REUSEPORT and a pool whose executors can be addressed
+  // one by one.
+  bool use_reuse_port() {
+    if constexpr (coro_io::has_reuse_port &&
+                  requires(typename server_config::executor_pool_t & pool) {
+                    pool.get_executor(size_t{});
+                    pool.pool_size();
+                  }) {
+      return reuse_port_;
+    }
+    else {
+      if (reuse_port_) {
+        ELOGV(WARN, "reuse_port isn't supported, use one acceptor");
+      }
+      return false;
+    }
+  }
+
+  // with reuse_port, the executor which runs acceptor_, so that its
+  // connections stay on that thread. Otherwise nullptr.
+  executor_t *acceptor_owner() {
+    if constexpr (requires(typename server_config::executor_pool_t & pool) {
+                    pool.get_executor(size_t{});
+                    pool.pool_size();
+                  }) {
+      if (!reuse_port_acceptors_.empty()) {
+        for (size_t i = 0; i < pool_.pool_size(); ++i) {
+          auto executor = pool_.get_executor(i);
+          if (&executor->context() == &acceptor_.get_executor().context()) {
+            return executor;
+          }
+        }
+      }
+    }
+    return nullptr;
+  }
+
+  coro_rpc::err_code listen_reuse_port() {
+    if constexpr (requires(typename server_config::executor_pool_t & pool) {
+                    pool.get_executor(size_t{});
+                    pool.pool_size();
+                  }) {
+      using asio::ip::tcp;
+      auto endpoint = tcp::endpoint(tcp::v4(), port_);
+      for (size_t i = 0; i < pool_.pool_size(); ++i) {
+        auto executor = pool_.get_executor(i);
+        if (&executor->context() == &acceptor_.get_executor().context()) {
+          continue;
+        }
+        auto extra = std::make_unique<reuse_port_acceptor>(executor);
+        asio::error_code ec;
+        extra->acceptor.open(endpoint.protocol(), ec);
+        if (!ec) {
+          extra->acceptor.set_option(tcp::acceptor::reuse_address(true), ec);
+          coro_io::set_reuse_port(extra->acceptor, ec);
+          extra->acceptor.bind(endpoint, ec);
+        }
+        if (!ec) {
+          extra->acceptor.listen(asio::socket_base::max_listen_connections, ec);
+        }
+        if (ec) {
+          ELOGV(ERROR, "bind reuse_port acceptor %zu of port %d error : %s", i,
+                port_.load(), ec.message().data());
+          extra->acceptor.close(ec);
+          for (auto &acceptor : reuse_port_acceptors_) {
+            acceptor->acceptor.close(ec);
+          }
+          reuse_port_acceptors_.clear();
+          acceptor_.cancel(ec);
+          acceptor_.close(ec);
+          return coro_rpc::errc::address_in_use;
+        }
+        reuse_port_acceptors_.push_back(std::move(extra));
+      }
+      ELOGV(INFO, "listen port %d with %zu reuse_port acceptors", port_.load(),
+            reuse_port_acceptors_.size() + 1);
+    }
+    return {};
+  }
+
   coro_rpc::err_code listen() {
     ELOGV(INFO, "begin to listen");
     using asio::ip::tcp;
@@ -293,6 +420,11 @@ class coro_rpc_server_base {
 #ifdef __GNUC__
     acceptor_.set_option(tcp::acceptor::reuse_address(true));
 #endif
+    bool reuse_port = use_reuse_port();
+    if (reuse_port) {
+      asio::error_code ignored_ec;
+      coro_io::set_reuse_port(acceptor_, ignored_ec);
+    }
     asio::error_code ec;
     acceptor_.bind(endpoint, ec);
     if (ec) {
@@ -316,14 +448,25 @@ class coro_rpc_server_base {
     port_ = end_point.port();
 
     ELOGV(INFO, "listen port %d successfully", port_.load());
+    if (reuse_port) {
+      return listen_reuse_port();
+    }
     return {};
   }
 
-  async_simple::coro::Lazy<coro_rpc::err_code> accept() {
+  /*!
+   * Accept loop of one acceptor.
+   *
+   * @param owner with reuse_port, the executor of the acceptor, which runs all
+   * the connections it accepts. nullptr to spread connections round-robin.
+   */
+  async_simple::coro::Lazy<coro_rpc::err_code> accept(
+      asio::ip::tcp::acceptor &acceptor, std::promise<void> &close_waiter,
+      executor_t *owner) {
     for (;;) {
-      auto executor = pool_.get_executor();
+      auto executor = owner ? owner : pool_.get_executor();
       asio::ip::tcp::socket socket(executor->get_asio_executor());
-      auto error = co_await coro_io::async_accept(acceptor_, socket);
+      auto error = co_await coro_io::async_accept(acceptor, socket);
 #ifdef UNIT_TEST_INJECT
       if (g_action == inject_action::force_inject_server_accept_error) {
         asio::error_code ignored_ec;
@@ -338,12 +481,24 @@ class coro_rpc_server_base {
         ELOGV(INFO, "accept failed, error: %s", error.message().data());
         if (error == asio::error::operation_aborted ||
             error == asio::error::bad_descriptor) {
-          acceptor_close_waiter_.set_value();
+          close_waiter.set_value();
           co_return coro_rpc::errc::operation_canceled;
         }
         continue;
       }
 
+      if (accept_rate_limiter_) {
+        auto client_ip = coro_io::remote_ip(socket);
+        if (!accept_rate_limiter_->try_acquire(client_ip))
+          AS_UNLIKELY {
+            ELOGV(WARN, "too many connections from %s, close it",
+                  client_ip.data());
+            asio::error_code ignored_ec;
+            socket.close(ignored_ec);
+            continue;
+          }
+      }
+
       int64_t conn_id = ++conn_id_;
       ELOGV(INFO, "new client conn_id %d coming", conn_id);
       auto conn = std::make_shared<coro_connection>(executor, std::move(socket),
@@ -354,6 +509,14 @@ class coro_rpc_server_base {
             conns_.erase(id);
           },
           conn_id);
+      if (request_rate_limiter_) {
+        conn->set_request_rate_limiter(request_rate_limiter_,
+                                       rate_limit_by_function_);
+      }
+      if (concurrency_limiter_) {
+        conn->set_concurrency_limiter(concurrency_limiter_);
+      }
+      conn->set_max_concurrent_calls(max_concurrent_calls_);
 
       {
         std::unique_lock lock(conns_mtx_);
@@ -380,17 +543,27 @@ class coro_rpc_server_base {
       (void)acceptor_.close(ec);
     });
     acceptor_close_waiter_.get_future().wait();
+    for (auto &extra : reuse_port_acceptors_) {
+      asio::dispatch(extra->acceptor.get_executor(), [&extra]() {
+        asio::error_code ec;
+        (void)extra->acceptor.cancel(ec);
+        (void)extra->acceptor.close(ec);
+      });
+      extra->close_waiter.get_future().wait();
+    }
   }
 
   typename server_config::executor_pool_t pool_;
   asio::ip::tcp::acceptor acceptor_;
   std::promise<void> acceptor_close_waiter_;
+  bool reuse_port_ = false;
+  std::vector<std::unique_ptr<reuse_port_acceptor>> reuse_port_acceptors_;
 
   std::thread thd_;
   stat flag_;
 
   std::mutex start_mtx_;
-  uint64_t conn_id_ = 0;
+  std::atomic<uint64_t> conn_id_ = 0;
   std::unordered_map<uint64_t, std::shared_ptr<coro_connection>> conns_;
   std::mutex conns_mtx_;
 
@@ -398,6 +571,11 @@ class coro_rpc_server_base {
 
   std::atomic<uint16_t> port_;
   std::chrono::steady_clock::duration conn_timeout_duration_;
+  std::shared_ptr<coro_io::keyed_rate_limiter> accept_rate_limiter_;
+  std::shared_ptr<coro_io::keyed_rate_limiter> request_rate_limiter_;
+  bool rate_limit_by_function_ = false;
+  std::shared_ptr<coro_io::concurrency_limiter> concurrency_limiter_;
+  uint32_t max_concurrent_calls_ = 0;
 
 #ifdef YLT_ENABLE_SSL
   asio::ssl::context context_{asio::ssl::context::sslv23};
@@ -16,9 +16,13 @@
 #pragma once
 
 #include <chrono>
+#include <memory>
+#include <optional>
 #include <thread>
 
+#include "ylt/coro_io/concurrency_limiter.hpp"
 #include "ylt/coro_io/io_context_pool.hpp"
+#include "ylt/coro_io/rate_limiter.hpp"
 #include "ylt/coro_rpc/coro_rpc_server.hpp"
 #include "ylt/coro_rpc/impl/context.hpp"
 #include "ylt/coro_rpc/impl/protocol/coro_rpc_protocol.hpp"
@@ -31,6 +35,27 @@ struct coro_rpc_config_base {
   unsigned thread_num = std::thread::hardware_concurrency();
   std::chrono::steady_clock::duration conn_timeout_duration =
       std::chrono::seconds{0};
+  // open one SO_REUSEPORT acceptor per io thread, the kernel spreads new
+  // connections among them and each connection stays on its accepting thread.
+  bool reuse_port = false;
+  // pin the io threads, e.g. to the CPUs of the NIC's NUMA node.
+  std::optional<coro_io::cpu_affinity_policy> cpu_affinity;
+  // admission control. New connections beyond the rate of their client ip
+  // are closed right after accept.
+  std::shared_ptr<coro_io::keyed_rate_limiter> accept_rate_limiter;
+  // requests beyond the rate of their client ip, or of their function with
+  // rate_limit_by_function, fail with errc::too_many_requests. The connection
+  // stays open for the calls after them.
+  std::shared_ptr<coro_io::keyed_rate_limiter> request_rate_limiter;
+  bool rate_limit_by_function = false;
+  // an adaptive limit of the requests in flight, requests beyond it fail with
+  // errc::server_busy and their connection stays open.
+  std::shared_ptr<coro_io::concurrency_limiter> concurrency_limiter;
+  // up to this many calls of coroutine functions without a context parameter
+  // run concurrently on a connection, beside the requests read after them.
+  // The connection stops reading when that many are running. 0 runs them one
+  // at a time, in the order of their requests.
+  uint32_t max_concurrent_calls = 0;
 };
 
 struct coro_rpc_default_config : public coro_rpc_config_base {
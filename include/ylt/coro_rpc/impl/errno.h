@@ -32,6 +32,8 @@ enum class errc : uint16_t {
   unknown_protocol_version,
   message_too_large,
   server_has_ran,
+  too_many_requests,
+  server_busy,
 };
 inline constexpr std::string_view make_error_message(errc ec) noexcept {
   switch (ec) {
@@ -59,6 +61,10 @@ inline constexpr std::string_view make_error_message(errc ec) noexcept {
       return "message_too_large";
     case errc::server_has_ran:
       return "server_has_ran";
+    case errc::too_many_requests:
+      return "too_many_requests";
+    case errc::server_busy:
+      return "server_busy";
     default:
       return "unknown_user-defined_error";
   }
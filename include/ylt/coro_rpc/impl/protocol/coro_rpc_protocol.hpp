@@ -74,6 +74,24 @@ struct coro_rpc_protocol {
     uint32_t attach_length;  //!< reserved field
   };
 
+  /*!
+   * resp_header::msg_type of a response
+   */
+  enum resp_msg_type : uint8_t {
+    response_msg = 0,     //!< the response of a call, it also ends a stream
+    stream_item_msg = 1,  //!< an item of a streaming call, more will follow
+  };
+
+  /*!
+   * req_header::msg_type of a request. The stream messages have no body, they
+   * name the stream by its seq_num.
+   */
+  enum req_msg_type : uint8_t {
+    request_msg = 0,        //!< a call
+    stream_ack_msg = 1,     //!< the client read function_id more items
+    stream_cancel_msg = 2,  //!< the client doesn't want more items
+  };
+
   using supported_serialize_protocols = std::variant<struct_pack_protocol>;
   using route_key_t = uint32_t;
   using router = coro_rpc::protocol::router<coro_rpc_protocol>;
@@ -94,7 +112,8 @@ struct coro_rpc_protocol {
   template <typename Socket>
   static async_simple::coro::Lazy<std::error_code> read_head(
       Socket& socket, req_header& req_head) {
-    // TODO: add a connection-level buffer in parameter to reuse memory
+    // `socket` is the connection's buffered stream, so this is usually served
+    // from memory already read along with a previous request.
     auto [ec, _] = co_await coro_io::async_read(
         socket, asio::buffer((char*)&req_head, sizeof(req_header)));
     if (ec)
@@ -135,9 +154,25 @@ struct coro_rpc_protocol {
                                       coro_rpc::errc rpc_err_code = {},
                                       std::string_view err_msg = {},
                                       bool is_user_defined_error = false) {
-    std::string err_msg_buf;
     std::string header_buf;
-    header_buf.resize(RESP_HEAD_LEN);
+    prepare_response_to(header_buf, rpc_result, req_header, attachment_len,
+                        rpc_err_code, err_msg, is_user_defined_error);
+    return header_buf;
+  }
+
+  /*!
+   * Same as prepare_response, but writes the header into `header_buf` so
+   * that the caller can reuse its memory.
+   */
+  static void prepare_response_to(std::string& header_buf,
+                                  std::string& rpc_result,
+                                  const req_header& req_header,
+                                  std::size_t attachment_len,
+                                  coro_rpc::errc rpc_err_code = {},
+                                  std::string_view err_msg = {},
+                                  bool is_user_defined_error = false) {
+    std::string err_msg_buf;
+    header_buf.assign(RESP_HEAD_LEN, '\0');
     auto& resp_head = *(resp_header*)header_buf.data();
     resp_head.magic = magic_number;
     resp_head.version = VERSION_NUMBER;
@@ -177,7 +212,32 @@ struct coro_rpc_protocol {
         }
       }
     resp_head.length = rpc_result.size();
-    return header_buf;
+  }
+
+  /*!
+   * Write the header of an item sent by a streaming rpc function into
+   * `header_buf`. The stream is ended by a normal response.
+   */
+  static void prepare_stream_item_to(std::string& header_buf,
+                                     std::string& item,
+                                     const req_header& req_header) {
+    prepare_response_to(header_buf, item, req_header, 0);
+    ((resp_header*)header_buf.data())->msg_type = stream_item_msg;
+  }
+
+  /*!
+   * Make the header of a stream_ack_msg, allowing the server to send `count`
+   * more items of the stream `seq_num`, or of a stream_cancel_msg.
+   */
+  static req_header make_stream_msg(req_msg_type msg_type, uint32_t seq_num,
+                                    uint32_t count = 0) {
+    req_header header{};
+    header.magic = magic_number;
+    header.version = VERSION_NUMBER;
+    header.msg_type = msg_type;
+    header.seq_num = seq_num;
+    header.function_id = count;
+    return header;
   }
 
   /*!
@@ -19,6 +19,8 @@
 #include <ylt/util/function_name.h>
 #include <ylt/util/type_traits.h>
 
+#include <algorithm>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <sstream>
@@ -46,20 +48,61 @@ template <typename rpc_protocol,
           template <typename...> typename map_t = std::unordered_map>
 
 class router {
-  using router_handler_t = std::function<std::optional<std::string>(
-      std::string_view, rpc_context<rpc_protocol> &context_info,
-      typename rpc_protocol::supported_serialize_protocols protocols)>;
+  using serialize_protocols =
+      typename rpc_protocol::supported_serialize_protocols;
+
+  // A registered rpc function is a plain function pointer plus the object of
+  // a member function, so calling it costs no std::function indirection.
+  struct router_handler_t {
+    std::optional<std::string> (*func)(void *self, std::string_view data,
+                                       rpc_context<rpc_protocol> &context_info,
+                                       serialize_protocols protocols);
+    void *self;
+    std::optional<std::string> operator()(
+        std::string_view data, rpc_context<rpc_protocol> &context_info,
+        serialize_protocols protocols) const {
+      return func(self, data, context_info, protocols);
+    }
+  };
 
-  using coro_router_handler_t =
-      std::function<async_simple::coro::Lazy<std::optional<std::string>>(
-          std::string_view, rpc_context<rpc_protocol> &context_info,
-          typename rpc_protocol::supported_serialize_protocols protocols)>;
+  struct coro_router_handler_t {
+    async_simple::coro::Lazy<std::optional<std::string>> (*func)(
+        void *self, std::string_view data,
+        rpc_context<rpc_protocol> &context_info, serialize_protocols protocols);
+    void *self;
+    // a function taking neither a context nor streaming only needs its
+    // request, so the connection can run it beside the next requests.
+    bool concurrent;
+    // a streaming function, always run beside the next requests as its
+    // items are paced by the client's acks.
+    bool stream;
+    async_simple::coro::Lazy<std::optional<std::string>> operator()(
+        std::string_view data, rpc_context<rpc_protocol> &context_info,
+        serialize_protocols protocols) const {
+      return func(self, data, context_info, protocols);
+    }
+  };
 
   using route_key = typename rpc_protocol::route_key_t;
   std::unordered_map<route_key, router_handler_t> handlers_;
   std::unordered_map<route_key, coro_router_handler_t> coro_handlers_;
   std::unordered_map<route_key, std::string> id2name_;
 
+  // The dispatch table built by freeze(): open addressing over a power of two
+  // number of slots, with the handler stored inline.
+  struct alignas(32) frozen_entry {
+    enum kind_t : uint8_t { empty, sync, coro };
+    route_key key;
+    kind_t kind;
+    union {
+      router_handler_t handler;
+      coro_router_handler_t coro_handler;
+    };
+  };
+  std::vector<frozen_entry> frozen_table_;
+  uint32_t frozen_seed_ = 0;
+  std::size_t frozen_max_probe_ = 0;
+
  private:
   const std::string &get_name(const route_key &key) {
     static std::string empty_string;
@@ -80,8 +123,14 @@ class router {
     template <typename serialize_protocol>
     async_simple::coro::Lazy<std::optional<std::string>> operator()(
         const serialize_protocol &) {
-      return internal::execute_coro<rpc_protocol, serialize_protocol, Func>(
-          data, context_info, self);
+      if constexpr (is_stream_function_v<Func>) {
+        return internal::execute_stream<rpc_protocol, serialize_protocol,
+                                        Func>(data, context_info, self);
+      }
+      else {
+        return internal::execute_coro<rpc_protocol, serialize_protocol, Func>(
+            data, context_info, self);
+      }
     }
   };
 
@@ -92,11 +141,66 @@ class router {
     template <typename serialize_protocol>
     async_simple::coro::Lazy<std::optional<std::string>> operator()(
         const serialize_protocol &) {
-      return internal::execute_coro<rpc_protocol, serialize_protocol, Func>(
-          data, context_info);
+      if constexpr (is_stream_function_v<Func>) {
+        return internal::execute_stream<rpc_protocol, serialize_protocol,
+                                        Func>(data, context_info);
+      }
+      else {
+        return internal::execute_coro<rpc_protocol, serialize_protocol, Func>(
+            data, context_info);
+      }
     }
   };
 
+  template <auto func, typename Self>
+  static std::optional<std::string> invoke(
+      void *self, std::string_view data,
+      rpc_context<rpc_protocol> &context_info, serialize_protocols protocols) {
+    return std::visit(
+        [data, &context_info, self]<typename serialize_protocol>(
+            const serialize_protocol &obj) mutable {
+          if constexpr (std::is_void_v<Self>) {
+            return internal::execute<rpc_protocol, serialize_protocol, func>(
+                data, context_info);
+          }
+          else {
+            return internal::execute<rpc_protocol, serialize_protocol, func>(
+                data, context_info, static_cast<Self *>(self));
+          }
+        },
+        protocols);
+  }
+
+  template <auto func, typename Self>
+  static async_simple::coro::Lazy<std::optional<std::string>> invoke_coro(
+      void *self, std::string_view data,
+      rpc_context<rpc_protocol> &context_info, serialize_protocols protocols) {
+    if constexpr (std::is_void_v<Self>) {
+      execute_visitor<func, void> visitor{data, context_info};
+      return std::visit(visitor, protocols);
+    }
+    else {
+      execute_visitor<func, Self> visitor{data, context_info,
+                                          static_cast<Self *>(self)};
+      return std::visit(visitor, protocols);
+    }
+  }
+
+  template <auto func>
+  static constexpr bool is_concurrent_coro() {
+    using param_type = util::function_parameters_t<decltype(func)>;
+    if constexpr (is_stream_function_v<func>) {
+      return false;
+    }
+    else if constexpr (std::is_void_v<param_type>) {
+      return true;
+    }
+    else {
+      using First = std::tuple_element_t<0, param_type>;
+      return !requires { typename First::return_type; };
+    }
+  }
+
   template <auto func, typename Self>
   void regist_one_handler(Self *self) {
     if (self == nullptr)
@@ -129,40 +233,29 @@ class router {
 
     constexpr auto name = get_func_name<func>();
     using return_type = util::function_return_type_t<decltype(func)>;
+    // streaming functions are run as coroutines too, as they wait for the
+    // peer between items.
     if constexpr (util::is_specialization_v<return_type,
-                                            async_simple::coro::Lazy>) {
+                                            async_simple::coro::Lazy> ||
+                  is_generator_v<return_type>) {
       auto it = coro_handlers_.emplace(
-          key,
-          [self](
-              std::string_view data, rpc_context<rpc_protocol> &context_info,
-              typename rpc_protocol::supported_serialize_protocols protocols) {
-            execute_visitor<func, Self> visitor{data, context_info, self};
-            return std::visit(visitor, protocols);
-          });
+          key, coro_router_handler_t{&invoke_coro<func, Self>, self,
+                                     is_concurrent_coro<func>(),
+                                     is_stream_function_v<func>});
       if (!it.second) {
         ELOGV(CRITICAL, "duplication function %s register!", name.data());
       }
     }
     else {
-      auto it = handlers_.emplace(
-          key,
-          [self](
-              std::string_view data, rpc_context<rpc_protocol> &context_info,
-              typename rpc_protocol::supported_serialize_protocols protocols) {
-            return std::visit(
-                [data, &context_info, self]<typename serialize_protocol>(
-                    const serialize_protocol &obj) mutable {
-                  return internal::execute<rpc_protocol, serialize_protocol,
-                                           func>(data, context_info, self);
-                },
-                protocols);
-          });
+      auto it =
+          handlers_.emplace(key, router_handler_t{&invoke<func, Self>, self});
       if (!it.second) {
         ELOGV(CRITICAL, "duplication function %s register!", name.data());
       }
     }
 
     id2name_.emplace(key, name);
+    refreeze();
   }
 
   template <auto func>
@@ -185,40 +278,137 @@ class router {
 
     constexpr auto name = get_func_name<func>();
     if constexpr (util::is_specialization_v<return_type,
-                                            async_simple::coro::Lazy>) {
+                                            async_simple::coro::Lazy> ||
+                  is_generator_v<return_type>) {
       auto it = coro_handlers_.emplace(
-          key,
-          [](std::string_view data, rpc_context<rpc_protocol> &context_info,
-             typename rpc_protocol::supported_serialize_protocols protocols) {
-            execute_visitor<func, void> visitor{data, context_info};
-            return std::visit(visitor, protocols);
-          });
+          key, coro_router_handler_t{&invoke_coro<func, void>, nullptr,
+                                     is_concurrent_coro<func>(),
+                                     is_stream_function_v<func>});
       if (!it.second) {
         ELOGV(CRITICAL, "duplication function %s register!", name.data());
       }
     }
     else {
       auto it = handlers_.emplace(
-          key,
-          [](std::string_view data, rpc_context<rpc_protocol> &context_info,
-             typename rpc_protocol::supported_serialize_protocols protocols) {
-            return std::visit(
-                [data, &context_info]<typename serialize_protocol>(
-                    const serialize_protocol &obj) mutable {
-                  return internal::execute<rpc_protocol, serialize_protocol,
-                                           func>(data, context_info);
-                },
-                protocols);
-          });
+          key, router_handler_t{&invoke<func, void>, nullptr});
       if (!it.second) {
         ELOGV(CRITICAL, "duplication function %s register!", name.data());
       }
     }
     id2name_.emplace(key, name);
+    refreeze();
+  }
+
+  static std::size_t frozen_slot(const route_key &key, uint32_t seed,
+                                 std::size_t size) {
+    // multiply-shift hash, then map the 32 bits onto [0, size).
+    uint32_t h = static_cast<uint32_t>(key) * seed;
+    return static_cast<std::size_t>((uint64_t{h} * size) >> 32);
+  }
+
+  // Fill a table of `size` slots by linear probing, return the longest probe
+  // sequence.
+  std::size_t build_frozen_table(std::vector<frozen_entry> &table,
+                                 uint32_t seed, std::size_t size) {
+    table.assign(size, frozen_entry{});
+    std::size_t max_probe = 0;
+    auto insert = [&](const route_key &key, auto kind, auto &&fill) {
+      std::size_t probe = 0;
+      std::size_t i = frozen_slot(key, seed, size);
+      while (table[i].kind != frozen_entry::empty) {
+        i = (i + 1) & (size - 1);
+        ++probe;
+      }
+      table[i].key = key;
+      table[i].kind = kind;
+      fill(table[i]);
+      max_probe = (std::max)(max_probe, probe);
+    };
+    for (auto &[key, handler] : handlers_) {
+      insert(key, frozen_entry::sync, [&](frozen_entry &e) {
+        e.handler = handler;
+      });
+    }
+    for (auto &[key, handler] : coro_handlers_) {
+      insert(key, frozen_entry::coro, [&](frozen_entry &e) {
+        e.coro_handler = handler;
+      });
+    }
+    return max_probe;
+  }
+
+  void refreeze() {
+    if (!frozen_table_.empty()) {
+      freeze();
+    }
+  }
+
+  const frozen_entry *find_frozen(const route_key &key) const {
+    const auto size = frozen_table_.size();
+    std::size_t i = frozen_slot(key, frozen_seed_, size);
+    for (std::size_t probe = 0; probe <= frozen_max_probe_; ++probe) {
+      auto &entry = frozen_table_[i];
+      if (entry.kind == frozen_entry::empty) {
+        return nullptr;
+      }
+      if (entry.key == key) {
+        return &entry;
+      }
+      i = (i + 1) & (size - 1);
+    }
+    return nullptr;
   }
 
  public:
+  /*!
+   * Build the flat dispatch table from the registered functions.
+   *
+   * After freezing, get_handler and get_coro_handler look the id up in one
+   * flat array, usually with a single probe, instead of two hash maps. Of a
+   * few hash seeds the one with the shortest probe sequences is kept; with
+   * no collision at all the table is a perfect hash. Registering a function
+   * later rebuilds the table. Not thread safe, like registration itself.
+   */
+  void freeze() {
+    if constexpr (std::is_integral_v<route_key>) {
+      const std::size_t cnt = handlers_.size() + coro_handlers_.size();
+      if (cnt == 0) {
+        return;
+      }
+      // load factor <= 1/2
+      std::size_t size = 2;
+      while (size < cnt * 2) {
+        size *= 2;
+      }
+      std::vector<frozen_entry> table;
+      std::vector<frozen_entry> best_table;
+      std::size_t best_probe = SIZE_MAX;
+      uint32_t best_seed = 0;
+      uint32_t seed = 0x9E3779B1u;  // golden ratio, then odd multiples
+      for (int i = 0; i < 16 && best_probe > 0; ++i, seed += 0x3C6EF372u) {
+        auto probe = build_frozen_table(table, seed | 1u, size);
+        if (probe < best_probe) {
+          best_probe = probe;
+          best_seed = seed | 1u;
+          std::swap(best_table, table);
+        }
+      }
+      frozen_table_ = std::move(best_table);
+      frozen_seed_ = best_seed;
+      frozen_max_probe_ = best_probe;
+    }
+  }
+
+  bool is_frozen() const { return !frozen_table_.empty(); }
+
   router_handler_t *get_handler(uint32_t id) {
+    if (!frozen_table_.empty())
+      AS_LIKELY {
+        auto entry = find_frozen(id);
+        return entry && entry->kind == frozen_entry::sync
+                   ? const_cast<router_handler_t *>(&entry->handler)
+                   : nullptr;
+      }
     if (auto it = handlers_.find(id); it != handlers_.end()) {
       return &it->second;
     }
@@ -226,6 +416,13 @@ class router {
   }
 
   coro_router_handler_t *get_coro_handler(uint32_t id) {
+    if (!frozen_table_.empty())
+      AS_LIKELY {
+        auto entry = find_frozen(id);
+        return entry && entry->kind == frozen_entry::coro
+                   ? const_cast<coro_router_handler_t *>(&entry->coro_handler)
+                   : nullptr;
+      }
     if (auto it = coro_handlers_.find(id); it != coro_handlers_.end()) {
       return &it->second;
     }
@@ -48,6 +48,25 @@ template <typename rpc_protocol>
 using rpc_context = std::shared_ptr<context_info_t<rpc_protocol>>;
 
 using rpc_conn = std::shared_ptr<coro_connection>;
+
+// Serialize the result of a synchronous rpc function into a buffer reused
+// from the connection, if the serialize protocol can append to a buffer.
+template <typename serialize_proto, typename rpc_protocol, typename... T>
+inline std::string serialize_response(rpc_context<rpc_protocol> &context_info,
+                                      const T &...t) {
+  if constexpr (requires(std::string &buffer) {
+                  serialize_proto::serialize_to(buffer, t...);
+                }) {
+    if (context_info->conn_)
+      AS_LIKELY {
+        std::string buffer = context_info->conn_->take_buffer();
+        serialize_proto::serialize_to(buffer, t...);
+        return buffer;
+      }
+  }
+  return serialize_proto::serialize(t...);
+}
+
 template <typename rpc_protocol, typename serialize_proto, auto func,
           typename Self = void>
 inline std::optional<std::string> execute(
@@ -117,14 +136,17 @@ inline std::optional<std::string> execute(
       if constexpr (std::is_void_v<Self>) {
         // call return_type func(args...)
 
-        return serialize_proto::serialize(std::apply(func, std::move(args)));
+        return serialize_response<serialize_proto>(
+            context_info, std::apply(func, std::move(args)));
       }
       else {
         auto &o = *self;
         // call return_type o.func(args...)
 
-        return serialize_proto::serialize(std::apply(
-            func, std::tuple_cat(std::forward_as_tuple(o), std::move(args))));
+        return serialize_response<serialize_proto>(
+            context_info,
+            std::apply(func, std::tuple_cat(std::forward_as_tuple(o),
+                                            std::move(args))));
       }
     }
   }
@@ -139,14 +161,15 @@ inline std::optional<std::string> execute(
     }
     else {
       if constexpr (std::is_void_v<Self>) {
-        return serialize_proto::serialize(func());
+        return serialize_response<serialize_proto>(context_info, func());
       }
       else {
-        return serialize_proto::serialize((self->*func)());
+        return serialize_response<serialize_proto>(context_info,
+                                                  (self->*func)());
       }
     }
   }
-  return serialize_proto::serialize();
+  return serialize_response<serialize_proto>(context_info);
 }
 
 template <typename rpc_protocol, typename serialize_proto, auto func,
@@ -250,4 +273,56 @@ inline async_simple::coro::Lazy<std::optional<std::string>> execute_coro(
   }
   co_return serialize_proto::serialize();
 }
-}  // namespace coro_rpc::internal
\ No newline at end of file
+
+// Run a streaming rpc function: each item the generator yields is sent as its
+// own message before the next one is produced, then the stream is ended by
+// the returned (void) response.
+template <typename rpc_protocol, typename serialize_proto, auto func,
+          typename Self = void>
+inline async_simple::coro::Lazy<std::optional<std::string>> execute_stream(
+    std::string_view data, rpc_context<rpc_protocol> &context_info,
+    Self *self = nullptr) {
+  using T = decltype(func);
+  using param_type = util::function_parameters_t<T>;
+  using item_type = stream_item_t<func>;
+
+  auto generator = [&]() -> std::optional<util::function_return_type_t<T>> {
+    if constexpr (!std::is_void_v<param_type>) {
+      using First = std::tuple_element_t<0, param_type>;
+      static_assert(!requires { typename First::return_type; },
+                    "a streaming rpc function can't take a context");
+      auto args = util::get_args<false, param_type>();
+      if (!serialize_proto::deserialize_to(args, data))
+        AS_UNLIKELY { return std::nullopt; }
+      // the generator takes its arguments by value, so `args` may go away.
+      if constexpr (std::is_void_v<Self>) {
+        return std::apply(func, std::move(args));
+      }
+      else {
+        return std::apply(func, std::tuple_cat(std::forward_as_tuple(*self),
+                                               std::move(args)));
+      }
+    }
+    else {
+      if constexpr (std::is_void_v<Self>) {
+        return func();
+      }
+      else {
+        return (self->*func)();
+      }
+    }
+  }();
+  if (!generator)
+    AS_UNLIKELY { co_return std::nullopt; }
+
+  auto &conn = context_info->conn_;
+  for (auto &&item : *generator) {
+    bool ok = co_await conn->template write_stream_item<rpc_protocol>(
+        serialize_proto::serialize(static_cast<const item_type &>(item)),
+        context_info->req_head_);
+    if (!ok)
+      AS_UNLIKELY { break; }
+  }
+  co_return serialize_proto::serialize();
+}
+}  // namespace coro_rpc::internal
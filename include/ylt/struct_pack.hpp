@@ -15,8 +15,13 @@
  */
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <iterator>
 #include <memory>
+#include <string_view>
+#include <thread>
 #include <type_traits>
 #include <utility>
 
@@ -269,6 +274,69 @@ template <uint64_t conf,
   return buffer;
 }
 
+/*!
+ * Serialize container t in parallel: its elements are split into chunk_count
+ * chunks, whose sizes are calculated and which are serialized on executor at
+ * the same time, each into its own part of the buffer. The result is the same
+ * as serialize_to(buffer, t), so it's deserialized as usual.
+ *
+ * Executor::schedule(std::function<void()>) runs a task, such as the one of
+ * async_simple::Executor. A chunk is serialized on the calling thread, which
+ * blocks until the others are done, so the executor must not need it to make
+ * progress. If the executor has currentThreadInExecutor() and it returns
+ * true, e.g. when called from a coroutine on a single threaded executor, all
+ * the chunks are serialized on the calling thread instead. The first
+ * exception thrown by a chunk is rethrown.
+ *
+ * Types with compatible fields aren't supported.
+ */
+template <uint64_t conf = sp_config::DEFAULT,
+#if __cpp_concepts >= 201907L
+          detail::struct_pack_buffer Buffer,
+#else
+          typename Buffer,
+#endif
+          typename T, typename Executor>
+void serialize_to_parallel(
+    Buffer &buffer, Executor &executor, const T &t,
+    std::size_t chunk_count = std::thread::hardware_concurrency()) {
+#if __cpp_concepts < 201907L
+  static_assert(detail::struct_pack_buffer<Buffer>,
+                "The buffer is not satisfied struct_pack_buffer requirement!");
+#endif
+  detail::serialize_to_parallel<conf>(buffer, executor, t, chunk_count);
+}
+
+template <
+#if __cpp_concepts >= 201907L
+    detail::struct_pack_buffer Buffer = std::vector<char>,
+#else
+    typename Buffer = std::vector<char>,
+#endif
+    typename T, typename Executor>
+[[nodiscard]] Buffer serialize_parallel(
+    Executor &executor, const T &t,
+    std::size_t chunk_count = std::thread::hardware_concurrency()) {
+  Buffer buffer;
+  serialize_to_parallel(buffer, executor, t, chunk_count);
+  return buffer;
+}
+
+template <uint64_t conf,
+#if __cpp_concepts >= 201907L
+          detail::struct_pack_buffer Buffer = std::vector<char>,
+#else
+          typename Buffer = std::vector<char>,
+#endif
+          typename T, typename Executor>
+[[nodiscard]] Buffer serialize_parallel(
+    Executor &executor, const T &t,
+    std::size_t chunk_count = std::thread::hardware_concurrency()) {
+  Buffer buffer;
+  serialize_to_parallel<conf>(buffer, executor, t, chunk_count);
+  return buffer;
+}
+
 #if __cpp_concepts >= 201907L
 template <uint64_t conf = sp_config::DEFAULT, typename T, typename... Args,
           struct_pack::detail::deserialize_view View>
@@ -363,6 +431,46 @@ template <uint64_t conf = sp_config::DEFAULT, typename T, typename... Args>
   return ret;
 }
 
+#ifdef STRUCT_PACK_ENABLE_PMR
+/*!
+ * Deserialize into t, where every std::pmr container (such as a
+ * std::pmr::string or std::pmr::vector) allocates from resource, however deep
+ * it's nested. With a std::pmr::monotonic_buffer_resource, the whole object
+ * is freed at once by releasing the resource, which must outlive t.
+ * Containers which aren't std::pmr ones still allocate as usual.
+ */
+#if __cpp_concepts >= 201907L
+template <uint64_t conf = sp_config::DEFAULT, typename T,
+          struct_pack::detail::deserialize_view View, typename Resource>
+  requires std::is_base_of_v<std::pmr::memory_resource, Resource>
+#else
+template <
+    uint64_t conf = sp_config::DEFAULT, typename T, typename View,
+    typename Resource,
+    typename = std::enable_if_t<
+        struct_pack::detail::deserialize_view<View> &&
+        std::is_base_of_v<std::pmr::memory_resource, Resource>>>
+#endif
+[[nodiscard]] struct_pack::err_code deserialize_to(T &t, const View &v,
+                                                   Resource &resource) {
+  detail::memory_reader reader{(const char *)v.data(),
+                               (const char *)v.data() + v.size()};
+  detail::unpacker<detail::memory_reader, conf> in(reader, resource);
+  return in.deserialize(t);
+}
+
+template <uint64_t conf = sp_config::DEFAULT, typename T, typename Resource,
+          typename = std::enable_if_t<
+              std::is_base_of_v<std::pmr::memory_resource, Resource>>>
+[[nodiscard]] struct_pack::err_code deserialize_to(T &t, const char *data,
+                                                   size_t size,
+                                                   Resource &resource) {
+  detail::memory_reader reader{data, data + size};
+  detail::unpacker<detail::memory_reader, conf> in(reader, resource);
+  return in.deserialize(t);
+}
+#endif
+
 #if __cpp_concepts >= 201907L
 template <uint64_t conf = sp_config::DEFAULT, typename T, typename... Args,
           struct_pack::detail::deserialize_view View>
@@ -454,6 +562,36 @@ template <typename... Args>
   return ret;
 }
 
+#ifdef STRUCT_PACK_ENABLE_PMR
+#if __cpp_concepts >= 201907L
+template <typename T, struct_pack::detail::deserialize_view View>
+#else
+template <
+    typename T, typename View,
+    typename = std::enable_if_t<struct_pack::detail::deserialize_view<View>>>
+#endif
+[[nodiscard]] auto deserialize(const View &v,
+                               std::pmr::memory_resource &resource) {
+  expected<T, struct_pack::err_code> ret;
+  auto errc = deserialize_to(ret.value(), v, resource);
+  if SP_UNLIKELY (errc) {
+    ret = unexpected<struct_pack::err_code>{errc};
+  }
+  return ret;
+}
+
+template <typename T>
+[[nodiscard]] auto deserialize(const char *data, size_t size,
+                               std::pmr::memory_resource &resource) {
+  expected<T, struct_pack::err_code> ret;
+  auto errc = deserialize_to(ret.value(), data, size, resource);
+  if SP_UNLIKELY (errc) {
+    ret = unexpected<struct_pack::err_code>{errc};
+  }
+  return ret;
+}
+#endif
+
 #if __cpp_concepts >= 201907L
 template <uint64_t conf, typename... Args,
           struct_pack::detail::deserialize_view View>
@@ -641,6 +779,316 @@ template <typename T, size_t I, uint64_t conf = sp_config::DEFAULT,
   }
   return ret;
 }
+namespace detail {
+struct lazy_view_builder;
+}
+
+/*!
+ * A serialized T whose fields are deserialized on demand. Creating it with
+ * get_lazy_view() scans the buffer once and records where each field starts,
+ * so get<I>() then reads only the Ith field, without walking the fields
+ * before it as get_field does.
+ *
+ * A field can be read as a view type, such as a std::string as
+ * std::string_view or a std::vector<int> as std::span<int>, and view<I>()
+ * indexes a nested struct the same way. Peeking at a few fields of a large
+ * message this way allocates nothing:
+ *
+ * ```cpp
+ * auto view = struct_pack::get_lazy_view<request>(buffer);
+ * auto name = view->get<2, std::string_view>();
+ * auto header = view->view<0>();
+ * ```
+ *
+ * A type which is serialized as a whole has a constant layout, and nothing is
+ * scanned for it. The buffer must outlive the view. Types with compatible
+ * fields or fast varints aren't supported.
+ */
+template <typename T, uint64_t conf = sp_config::DEFAULT>
+class lazy_view {
+ public:
+  static constexpr std::size_t field_count = members_count<T>;
+
+  template <size_t I>
+  using field_type = std::tuple_element_t<I, decltype(detail::get_types<T>())>;
+
+  lazy_view() = default;
+
+  /*!
+   * Deserialize the Ith field into dst, whose type may be a view of the type
+   * of the field.
+   */
+  template <size_t I, typename Field>
+  [[nodiscard]] struct_pack::err_code get_to(Field &dst) const {
+    static_assert(I < field_count, "out of range");
+    static_assert(detail::get_types_code<Field>() ==
+                      detail::get_types_code<field_type<I>>(),
+                  "The dst's type is not correct. It should be the type of "
+                  "the T's Ith field or a view of it");
+    detail::memory_reader reader{data_ + offsets_[I], data_ + offsets_[I + 1]};
+    detail::unpacker<detail::memory_reader, conf> in(reader);
+    return in.template get_indexed_field<T>(dst, size_type_);
+  }
+
+  template <size_t I, typename Field = field_type<I>>
+  [[nodiscard]] expected<Field, struct_pack::err_code> get() const {
+    expected<Field, struct_pack::err_code> ret;
+    auto ec = get_to<I>(ret.value());
+    if SP_UNLIKELY (ec) {
+      ret = unexpected<struct_pack::err_code>{ec};
+    }
+    return ret;
+  }
+
+  /*!
+   * Index the Ith field, which is a struct.
+   */
+  template <size_t I>
+  [[nodiscard]] expected<lazy_view<field_type<I>, conf>, struct_pack::err_code>
+  view() const;
+
+  /*!
+   * The serialized bytes of the Ith field.
+   */
+  template <size_t I>
+  std::string_view field_data() const {
+    static_assert(I < field_count, "out of range");
+    return {data_ + offsets_[I], offsets_[I + 1] - offsets_[I]};
+  }
+
+ private:
+  friend struct detail::lazy_view_builder;
+
+  const char *data_ = nullptr;
+  unsigned char size_type_ = 0;
+  // the offsets of the fields from data_, and where T ends.
+  std::array<std::size_t, field_count + 1> offsets_{};
+};
+
+namespace detail {
+struct lazy_view_builder {
+  template <typename T, uint64_t conf>
+  static struct_pack::err_code build(lazy_view<T, conf> &view,
+                                     const char *data, size_t size) {
+    memory_reader reader{data, data + size};
+    unpacker<memory_reader, conf> in(reader);
+    view.data_ = data;
+    auto ec = in.template index_fields<T>(view.offsets_, view.size_type_);
+    for (auto &offset : view.offsets_) {
+      offset -= (std::size_t)data;
+    }
+    return ec;
+  }
+
+  template <typename T, uint64_t conf, typename Parent>
+  static struct_pack::err_code build_nested(lazy_view<T, conf> &view,
+                                            const Parent &parent,
+                                            std::string_view field) {
+    memory_reader reader{field.data(), field.data() + field.size()};
+    unpacker<memory_reader, conf> in(reader);
+    view.data_ = parent.data_;
+    view.size_type_ = parent.size_type_;
+    auto ec = in.template index_nested_fields<T>(view.offsets_,
+                                                 view.size_type_);
+    for (auto &offset : view.offsets_) {
+      offset -= (std::size_t)view.data_;
+    }
+    return ec;
+  }
+};
+}  // namespace detail
+
+template <typename T, uint64_t conf>
+template <size_t I>
+expected<lazy_view<typename lazy_view<T, conf>::template field_type<I>, conf>,
+         struct_pack::err_code>
+lazy_view<T, conf>::view() const {
+  expected<lazy_view<field_type<I>, conf>, struct_pack::err_code> ret;
+  auto ec = detail::lazy_view_builder::build_nested(ret.value(), *this,
+                                                    field_data<I>());
+  if SP_UNLIKELY (ec) {
+    ret = unexpected<struct_pack::err_code>{ec};
+  }
+  return ret;
+}
+
+#if __cpp_concepts >= 201907L
+template <typename T, uint64_t conf = sp_config::DEFAULT,
+          struct_pack::detail::deserialize_view View>
+#else
+template <
+    typename T, uint64_t conf = sp_config::DEFAULT, typename View,
+    typename = std::enable_if_t<struct_pack::detail::deserialize_view<View>>>
+#endif
+[[nodiscard]] expected<lazy_view<T, conf>, struct_pack::err_code>
+get_lazy_view(const View &v) {
+  expected<lazy_view<T, conf>, struct_pack::err_code> ret;
+  auto ec = detail::lazy_view_builder::build(
+      ret.value(), (const char *)v.data(), (size_t)v.size());
+  if SP_UNLIKELY (ec) {
+    ret = unexpected<struct_pack::err_code>{ec};
+  }
+  return ret;
+}
+
+template <typename T, uint64_t conf = sp_config::DEFAULT>
+[[nodiscard]] expected<lazy_view<T, conf>, struct_pack::err_code>
+get_lazy_view(const char *data, size_t size) {
+  expected<lazy_view<T, conf>, struct_pack::err_code> ret;
+  auto ec = detail::lazy_view_builder::build(ret.value(), data, size);
+  if SP_UNLIKELY (ec) {
+    ret = unexpected<struct_pack::err_code>{ec};
+  }
+  return ret;
+}
+
+/*!
+ * Reads the elements of a serialized container T from a reader one at a time,
+ * so that a dump of millions of elements is processed in constant memory
+ * instead of being deserialized into a T as a whole:
+ *
+ * ```cpp
+ * std::ifstream ifs("records.bin", std::ios::binary);
+ * auto records = struct_pack::get_element_reader<std::vector<record>>(ifs);
+ * for (auto &r : *records) {
+ *   process(r);
+ * }
+ * if (records->error()) {
+ *   // the dump is truncated or corrupted
+ * }
+ * ```
+ *
+ * Every element is deserialized into the same object, so one which is kept
+ * must be moved out. read() deserializes the next element into an object of
+ * the caller instead, which lets it reuse its own buffers.
+ *
+ * The reader must outlive the element_reader. After the last element it's at
+ * the end of the container, where the next object of a stream starts. Types
+ * with compatible fields aren't supported.
+ */
+template <typename T, uint64_t conf, typename Reader>
+class element_reader {
+  template <typename U, bool = detail::map_container<U>>
+  struct element_of {
+    using type = typename U::value_type;
+  };
+  template <typename U>
+  struct element_of<U, true> {
+    using type = std::pair<typename U::key_type, typename U::mapped_type>;
+  };
+
+ public:
+  using value_type = typename element_of<T>::type;
+
+  class iterator {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = typename element_reader::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = value_type *;
+    using reference = value_type &;
+
+    iterator() = default;
+
+    reference operator*() const { return owner_->current_; }
+    pointer operator->() const { return &owner_->current_; }
+
+    iterator &operator++() {
+      if (!owner_->remaining_ || owner_->read(owner_->current_)) {
+        owner_ = nullptr;
+      }
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+
+    friend bool operator==(const iterator &a, const iterator &b) {
+      return a.owner_ == b.owner_;
+    }
+    friend bool operator!=(const iterator &a, const iterator &b) {
+      return a.owner_ != b.owner_;
+    }
+
+   private:
+    friend class element_reader;
+    explicit iterator(element_reader *owner) : owner_(owner) {}
+
+    element_reader *owner_ = nullptr;
+  };
+
+  /*!
+   * Read the metainfo and the length of the container, check error() for
+   * whether it failed.
+   */
+  explicit element_reader(Reader &reader) : reader_(&reader) {
+    detail::unpacker<Reader, conf> in(reader);
+    ec_ = in.template deserialize_container_head<T>(size_, size_type_);
+    remaining_ = ec_ ? 0 : size_;
+  }
+
+  /*!
+   * Deserialize the next element into element. It's an error if no element
+   * is left, and after an error no element can be read anymore.
+   */
+  [[nodiscard]] struct_pack::err_code read(value_type &element) {
+    if SP_UNLIKELY (remaining_ == 0) {
+      if (ec_) {
+        return ec_;
+      }
+      return struct_pack::errc::no_buffer_space;
+    }
+    detail::unpacker<Reader, conf> in(*reader_);
+    auto ec = in.deserialize_element(element, size_type_);
+    if SP_UNLIKELY (ec) {
+      ec_ = ec;
+      remaining_ = 0;
+      return ec;
+    }
+    --remaining_;
+    return {};
+  }
+
+  /*!
+   * Iterate over the elements left, which reads the first of them.
+   */
+  iterator begin() {
+    if (remaining_ == 0 || read(current_)) {
+      return iterator{};
+    }
+    return iterator{this};
+  }
+  iterator end() { return iterator{}; }
+
+  // the length of the container.
+  std::size_t size() const { return size_; }
+  std::size_t remaining() const { return remaining_; }
+  // the first error, which stopped the reading.
+  struct_pack::err_code error() const { return ec_; }
+
+ private:
+  Reader *reader_;
+  std::size_t size_ = 0;
+  std::size_t remaining_ = 0;
+  unsigned char size_type_ = 0;
+  struct_pack::err_code ec_;
+  value_type current_{};
+};
+
+#if __cpp_concepts >= 201907L
+template <typename T, uint64_t conf = sp_config::DEFAULT,
+          struct_pack::reader_t Reader>
+#else
+template <typename T, uint64_t conf = sp_config::DEFAULT, typename Reader,
+          typename = std::enable_if_t<struct_pack::reader_t<Reader>>>
+#endif
+[[nodiscard]] expected<element_reader<T, conf, Reader>, struct_pack::err_code>
+get_element_reader(Reader &reader) {
+  element_reader<T, conf, Reader> elements(reader);
+  if SP_UNLIKELY (elements.error()) {
+    return unexpected<struct_pack::err_code>{elements.error()};
+  }
+  return elements;
+}
+
 #if __cpp_concepts >= 201907L
 template <typename BaseClass, typename... DerivedClasses,
           struct_pack::reader_t Reader>
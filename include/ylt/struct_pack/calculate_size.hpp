@@ -386,6 +386,10 @@ calculate_fast_varint_size(const Args &...items) {
 template <uint64_t conf, typename... Args>
 STRUCT_PACK_INLINE constexpr serialize_buffer_size get_serialize_runtime_info(
     const Args &...args);
+
+template <uint64_t conf, typename... Args>
+STRUCT_PACK_INLINE constexpr serialize_buffer_size
+get_serialize_runtime_info_by_size(const size_info &sz_info);
 }  // namespace detail
 struct serialize_buffer_size {
  private:
@@ -401,11 +405,24 @@ struct serialize_buffer_size {
   template <uint64_t conf, typename... Args>
   friend STRUCT_PACK_INLINE constexpr serialize_buffer_size
   struct_pack::detail::get_serialize_runtime_info(const Args &...args);
+  template <uint64_t conf, typename... Args>
+  friend STRUCT_PACK_INLINE constexpr serialize_buffer_size
+  struct_pack::detail::get_serialize_runtime_info_by_size(
+      const size_info &sz_info);
 };
 namespace detail {
 template <uint64_t conf, typename... Args>
 [[nodiscard]] STRUCT_PACK_INLINE constexpr serialize_buffer_size
 get_serialize_runtime_info(const Args &...args) {
+  return get_serialize_runtime_info_by_size<conf, Args...>(
+      calculate_payload_size(args...));
+}
+
+// the payload size of args has been calculated as sz_info, which is summed up
+// from its parts when they're calculated separately.
+template <uint64_t conf, typename... Args>
+[[nodiscard]] STRUCT_PACK_INLINE constexpr serialize_buffer_size
+get_serialize_runtime_info_by_size(const size_info &sz_info) {
   using Type = get_args_type<Args...>;
   constexpr bool has_compatible = serialize_static_config<Type>::has_compatible;
   constexpr bool has_type_literal = check_if_add_type_literal<conf, Type>();
@@ -414,7 +431,6 @@ get_serialize_runtime_info(const Args &...args) {
   constexpr bool has_compile_time_determined_meta_info =
       check_has_metainfo<conf, Type>();
   serialize_buffer_size ret;
-  auto sz_info = calculate_payload_size(args...);
   if constexpr (has_compile_time_determined_meta_info) {
     ret.len_ = sizeof(unsigned char);
   }
@@ -15,9 +15,16 @@
  */
 #pragma once
 #include <bitset>
+#include <cassert>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <mutex>
 #include <type_traits>
+#include <vector>
 
 #include "calculate_size.hpp"
 #include "endian_wrapper.hpp"
@@ -238,6 +245,75 @@ class packer {
     }
   }
 
+  template <std::size_t size_type>
+  STRUCT_PACK_INLINE void serialize_container_size(std::size_t size) {
+    if constexpr (size_type == 1) {
+      low_bytes_write_wrapper<size_type>(writer_, size);
+    }
+    else {
+#ifdef STRUCT_PACK_OPTIMIZE
+      constexpr bool struct_pack_optimize = true;
+#else
+      constexpr bool struct_pack_optimize = false;
+#endif
+      if constexpr (force_optimize || struct_pack_optimize) {
+        if constexpr (size_type == 2) {
+          low_bytes_write_wrapper<size_type>(writer_, size);
+        }
+        else if constexpr (size_type == 4) {
+          low_bytes_write_wrapper<size_type>(writer_, size);
+        }
+        else if constexpr (size_type == 8) {
+          if constexpr (sizeof(std::size_t) >= 8) {
+            low_bytes_write_wrapper<size_type>(writer_, size);
+          }
+          else {
+            std::uint64_t sz = size;
+            low_bytes_write_wrapper<size_type>(writer_, sz);
+          }
+        }
+        else {
+          static_assert(!size_type, "illegal size_type.");
+        }
+      }
+      else {
+        switch ((info_.metainfo() & 0b11000) >> 3) {
+          case 1:
+            low_bytes_write_wrapper<2>(writer_, size);
+            break;
+          case 2:
+            low_bytes_write_wrapper<4>(writer_, size);
+            break;
+          case 3:
+            if constexpr (sizeof(std::size_t) >= 8) {
+              low_bytes_write_wrapper<8>(writer_, size);
+            }
+            else {
+              unreachable();
+            }
+            break;
+          default:
+            unreachable();
+        }
+      }
+    }
+  }
+
+  // Write the metainfo and the length of container t, so that its elements
+  // can be written by serialize_elements, in several parts if wanted.
+  template <uint64_t conf, std::size_t size_type, typename T>
+  STRUCT_PACK_INLINE void serialize_container_head(const T &t) {
+    serialize_metainfo<conf, size_type == 1, T>();
+    serialize_container_size<size_type>(t.size());
+  }
+
+  template <std::size_t size_type, typename Iter>
+  STRUCT_PACK_INLINE void serialize_elements(Iter first, Iter last) {
+    for (; first != last; ++first) {
+      serialize_one<size_type, UINT64_MAX>(*first);
+    }
+  }
+
   template <std::size_t size_type, uint64_t version, uint64_t parent_tag = 0,
             typename T>
   constexpr void inline serialize_one(const T &item) {
@@ -306,58 +382,7 @@ class packer {
         }
       }
       else if constexpr (map_container<type> || container<type>) {
-        auto size = item.size();
-
-        if constexpr (size_type == 1) {
-          low_bytes_write_wrapper<size_type>(writer_, size);
-        }
-        else {
-#ifdef STRUCT_PACK_OPTIMIZE
-          constexpr bool struct_pack_optimize = true;
-#else
-          constexpr bool struct_pack_optimize = false;
-#endif
-          if constexpr (force_optimize || struct_pack_optimize) {
-            if constexpr (size_type == 2) {
-              low_bytes_write_wrapper<size_type>(writer_, size);
-            }
-            else if constexpr (size_type == 4) {
-              low_bytes_write_wrapper<size_type>(writer_, size);
-            }
-            else if constexpr (size_type == 8) {
-              if constexpr (sizeof(std::size_t) >= 8) {
-                low_bytes_write_wrapper<size_type>(writer_, size);
-              }
-              else {
-                std::uint64_t sz = size;
-                low_bytes_write_wrapper<size_type>(writer_, sz);
-              }
-            }
-            else {
-              static_assert(!sizeof(item), "illegal size_type.");
-            }
-          }
-          else {
-            switch ((info_.metainfo() & 0b11000) >> 3) {
-              case 1:
-                low_bytes_write_wrapper<2>(writer_, size);
-                break;
-              case 2:
-                low_bytes_write_wrapper<4>(writer_, size);
-                break;
-              case 3:
-                if constexpr (sizeof(std::size_t) >= 8) {
-                  low_bytes_write_wrapper<8>(writer_, size);
-                }
-                else {
-                  unreachable();
-                }
-                break;
-              default:
-                unreachable();
-            }
-          }
-        }
+        serialize_container_size<size_type>(item.size());
         if constexpr (trivially_copyable_container<type> &&
                       is_little_endian_copyable<sizeof(
                           typename type::value_type)>) {
@@ -588,4 +613,197 @@ STRUCT_PACK_MAY_INLINE void serialize_to(Writer &writer,
     };
   }
 }
-}  // namespace struct_pack::detail
\ No newline at end of file
+
+// Serialize the elements [first, last) of container t, after the metainfo and
+// the length of t when with_head. Written one after another, the parts are
+// the same bytes as serialize_to<conf>(writer, info, t).
+template <uint64_t conf, typename Writer, typename T, typename Iter>
+STRUCT_PACK_MAY_INLINE void serialize_container_part_to(
+    Writer &writer, const serialize_buffer_size &info, const T &t, Iter first,
+    Iter last, bool with_head) {
+  detail::packer<Writer, T> o(writer, info);
+  auto serialize = [&](auto size_type) {
+    constexpr std::size_t sz = decltype(size_type)::value;
+    if (with_head) {
+      o.template serialize_container_head<conf, sz>(t);
+    }
+    o.template serialize_elements<sz>(first, last);
+  };
+  switch ((info.metainfo() & 0b11000) >> 3) {
+    case 0:
+      serialize(std::integral_constant<std::size_t, 1>{});
+      break;
+#ifdef STRUCT_PACK_OPTIMIZE
+    case 1:
+      serialize(std::integral_constant<std::size_t, 2>{});
+      break;
+    case 2:
+      serialize(std::integral_constant<std::size_t, 4>{});
+      break;
+    case 3:
+      if constexpr (sizeof(std::size_t) >= 8) {
+        serialize(std::integral_constant<std::size_t, 8>{});
+      }
+      else {
+        unreachable();
+      }
+      break;
+#else
+    case 1:
+    case 2:
+    case 3:
+      serialize(std::integral_constant<std::size_t, 2>{});
+      break;
+#endif
+    default:
+      detail::unreachable();
+      break;
+  };
+}
+
+#if __cpp_concepts >= 201907L
+template <typename Executor>
+concept has_current_thread_in_executor = requires(Executor &executor) {
+  executor.currentThreadInExecutor();
+};
+#else
+template <typename Executor, typename = void>
+struct has_current_thread_in_executor_impl : std::false_type {};
+
+template <typename Executor>
+struct has_current_thread_in_executor_impl<
+    Executor, std::void_t<decltype(std::declval<Executor &>()
+                                       .currentThreadInExecutor())>>
+    : std::true_type {};
+
+template <typename Executor>
+constexpr bool has_current_thread_in_executor =
+    has_current_thread_in_executor_impl<Executor>::value;
+#endif
+
+// Run task(0) ... task(n - 1) on executor, the last one on the calling thread,
+// and wait until all of them are done. The first exception thrown by a task is
+// rethrown. Called from a thread of the executor, they all run right there,
+// as waiting could block the thread the tasks are queued for.
+template <typename Executor, typename Task>
+void run_chunks(Executor &executor, std::size_t n, const Task &task) {
+  if constexpr (has_current_thread_in_executor<Executor>) {
+    if (executor.currentThreadInExecutor()) {
+      for (std::size_t i = 0; i < n; ++i) {
+        task(i);
+      }
+      return;
+    }
+  }
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::size_t pending = n - 1;
+  std::exception_ptr error;
+  auto run = [&](std::size_t i) {
+    try {
+      task(i);
+    } catch (...) {
+      std::lock_guard lock(mutex);
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  };
+  for (std::size_t i = 0; i + 1 < n; ++i) {
+    std::function<void()> job = [&, i] {
+      run(i);
+      std::lock_guard lock(mutex);
+      if (--pending == 0) {
+        cv.notify_one();
+      }
+    };
+    if constexpr (std::is_same_v<decltype(executor.schedule(job)), bool>) {
+      if (!executor.schedule(job)) {
+        job();
+      }
+    }
+    else {
+      executor.schedule(std::move(job));
+    }
+  }
+  run(n - 1);
+  std::unique_lock lock(mutex);
+  cv.wait(lock, [&] {
+    return pending == 0;
+  });
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+template <uint64_t conf, typename Buffer, typename T, typename Executor>
+void serialize_to_parallel(Buffer &buffer, Executor &executor, const T &t,
+                           std::size_t chunk_count) {
+  static_assert(container<T>, "only a container is serialized in parallel");
+  static_assert(!serialize_static_config<T>::has_compatible,
+                "the type with compatible fields isn't supported");
+  using iterator = decltype(std::begin(t));
+  std::size_t n = t.size();
+  chunk_count = (std::min)(chunk_count, n);
+  if (chunk_count <= 1) {
+    auto info = get_serialize_runtime_info<conf>(t);
+    auto data_offset = buffer.size();
+    resize(buffer, data_offset + info.size());
+    memory_writer writer{(char *)buffer.data() + data_offset};
+    serialize_to<conf>(writer, info, t);
+    return;
+  }
+
+  std::vector<iterator> bounds;
+  bounds.reserve(chunk_count + 1);
+  bounds.push_back(std::begin(t));
+  for (std::size_t i = 1; i <= chunk_count; ++i) {
+    bounds.push_back(std::next(bounds.back(), n * i / chunk_count -
+                                                  n * (i - 1) / chunk_count));
+  }
+
+  std::vector<size_info> sizes(chunk_count);
+  if constexpr (trivially_copyable_container<T>) {
+    for (std::size_t i = 0; i < chunk_count; ++i) {
+      sizes[i] = {static_cast<std::size_t>(bounds[i + 1] - bounds[i]) *
+                      sizeof(typename T::value_type),
+                  0, 0};
+    }
+  }
+  else {
+    run_chunks(executor, chunk_count, [&](std::size_t i) {
+      size_info sz{};
+      for (auto it = bounds[i]; it != bounds[i + 1]; ++it) {
+        sz += calculate_payload_size(*it);
+      }
+      sizes[i] = sz;
+    });
+  }
+
+  size_info total{0, 1, n};
+  for (auto &sz : sizes) {
+    total += sz;
+  }
+  auto info = get_serialize_runtime_info_by_size<conf, T>(total);
+  std::size_t size_width = std::size_t{1} << ((info.metainfo() & 0b11000) >> 3);
+
+  // offsets[i] is where chunk i starts, the head is written before chunk 0.
+  std::vector<std::size_t> offsets(chunk_count + 1);
+  offsets[chunk_count] = info.size();
+  for (std::size_t i = chunk_count; i > 0; --i) {
+    offsets[i - 1] =
+        offsets[i] - (sizes[i - 1].total + sizes[i - 1].size_cnt * size_width);
+  }
+  offsets[0] = 0;
+
+  auto data_offset = buffer.size();
+  resize(buffer, data_offset + info.size());
+  char *data = (char *)buffer.data() + data_offset;
+  run_chunks(executor, chunk_count, [&](std::size_t i) {
+    memory_writer writer{data + offsets[i]};
+    serialize_container_part_to<conf>(writer, info, t, bounds[i],
+                                      bounds[i + 1], i == 0);
+    assert(writer.buffer == data + offsets[i + 1]);
+  });
+}
+}  // namespace struct_pack::detail
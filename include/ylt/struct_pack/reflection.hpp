@@ -31,6 +31,13 @@
 #include <span>
 #endif
 
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#if __cpp_lib_memory_resource >= 201603L
+#define STRUCT_PACK_ENABLE_PMR
+#endif
+#endif
+
 #include "derived_helper.hpp"
 #include "foreach_macro.h"
 #include "marco.h"
@@ -497,6 +504,30 @@ template <typename T, typename = void>
   constexpr bool set_container = container<T> && set_container_impl<T>::value;
 #endif
 
+#ifdef STRUCT_PACK_ENABLE_PMR
+#if __cpp_concepts >= 201907L
+  template <typename Type>
+  concept pmr_container = container<Type> && requires {
+    requires std::is_same_v<typename remove_cvref_t<Type>::allocator_type,
+                            std::pmr::polymorphic_allocator<
+                                typename remove_cvref_t<Type>::value_type>>;
+  };
+#else
+  template <typename T, typename = void>
+  struct pmr_container_impl : std::false_type {};
+
+  template <typename T>
+  struct pmr_container_impl<T, std::void_t<
+    typename remove_cvref_t<T>::allocator_type>>
+      : std::is_same<typename remove_cvref_t<T>::allocator_type,
+                     std::pmr::polymorphic_allocator<
+                         typename remove_cvref_t<T>::value_type>> {};
+
+  template <typename T>
+  constexpr bool pmr_container = container<T> && pmr_container_impl<T>::value;
+#endif
+#endif
+
 #if __cpp_concepts >= 201907L
   template <typename Type>
   concept bitset = requires (Type t){
@@ -553,7 +553,7 @@ constexpr std::size_t calculate_compatible_version_size() {
   if constexpr (is_trivial_view_v<T>) {
     return 0;
   }
-  if constexpr (check_circle<T, ParentArgs...>())
+  else if constexpr (check_circle<T, ParentArgs...>())
     sz = 0;
   else if constexpr (id == type_id::compatible_t) {
     sz = 1;
@@ -880,7 +880,8 @@ constexpr auto get_types() {
                      varint_t<T> || string<T> || container<T> || optional<T> ||
                      unique_ptr<T> || is_variant_v<T> || expected<T> ||
                      array<T> || c_array<T> ||
-                     std::is_same_v<std::monostate, T> || bitset<T>
+                     std::is_same_v<std::monostate, T> || bitset<T> ||
+                     is_trivial_view_v<T>
 #if (__GNUC__ || __clang__) && defined(STRUCT_PACK_ENABLE_INT128)
                      || std::is_same_v<__int128, T> ||
                      std::is_same_v<unsigned __int128, T>
@@ -94,6 +94,16 @@ class unpacker {
 #endif
   }
 
+#ifdef STRUCT_PACK_ENABLE_PMR
+  // Every std::pmr container of the deserialized object allocates from
+  // resource.
+  STRUCT_PACK_INLINE unpacker(Reader &reader,
+                              std::pmr::memory_resource &resource)
+      : unpacker(reader) {
+    memory_resource_ = &resource;
+  }
+#endif
+
   template <std::size_t size_width, typename R, typename T>
   friend STRUCT_PACK_INLINE struct_pack::err_code read(Reader &reader, T &t);
 
@@ -279,6 +289,85 @@ class unpacker {
     return err_code;
   }
 
+  // Read the metainfo of U, then skip its fields and record where each of
+  // them starts (by tellg) in positions, with where U ends last. This is how
+  // lazy_view indexes a buffer.
+  template <typename U, typename Positions>
+  STRUCT_PACK_MAY_INLINE struct_pack::err_code index_fields(
+      Positions &positions, unsigned char &size_type) {
+    static_assert(
+        !check_if_compatible_element_exist<decltype(get_types<U>())>(),
+        "the fields of a type with compatible fields can't be indexed");
+    auto &&[err_code, buffer_len] = deserialize_metainfo<U>();
+    if SP_UNLIKELY (err_code) {
+      return err_code;
+    }
+    size_type = size_type_;
+    return index_nested_fields<U>(positions, size_type);
+  }
+
+  // The same for U as a field of a struct, which has no metainfo.
+  template <typename U, typename Positions>
+  STRUCT_PACK_MAY_INLINE struct_pack::err_code index_nested_fields(
+      Positions &positions, unsigned char size_type) {
+    static_assert(!is_enable_fast_varint_coding(get_parent_tag<U>()),
+                  "the fields of a type with fast varints can't be indexed");
+    size_type_ = size_type;
+    return visit_size_type([&](auto width) CONSTEXPR_INLINE_LAMBDA {
+      return index_fields_impl<decltype(width)::value, U>(positions);
+    });
+  }
+
+  // Deserialize a field of U which index_fields found at the reader.
+  template <typename U, typename Field>
+  STRUCT_PACK_MAY_INLINE struct_pack::err_code get_indexed_field(
+      Field &field, unsigned char size_type) {
+    size_type_ = size_type;
+    return visit_size_type([&](auto width) CONSTEXPR_INLINE_LAMBDA {
+      if constexpr (is_trivial_serializable<U>::value ||
+                    is_trivial_serializable<U, true>::value) {
+        return deserialize_one<decltype(width)::value, UINT64_MAX, true>(
+            field);
+      }
+      else {
+        constexpr uint64_t tag = get_parent_tag<U>();
+        return deserialize_one<decltype(width)::value, UINT64_MAX, true, tag>(
+            field);
+      }
+    });
+  }
+
+  // Read the metainfo and the length of the container T, but none of its
+  // elements, which are then read one at a time by deserialize_element. This
+  // is how element_reader streams a container.
+  template <typename T>
+  STRUCT_PACK_MAY_INLINE struct_pack::err_code deserialize_container_head(
+      std::size_t &size, unsigned char &size_type) {
+    static_assert(container<T> && !string<T>,
+                  "only the elements of a container can be streamed");
+    static_assert(
+        !check_if_compatible_element_exist<decltype(get_types<T>())>(),
+        "the elements of a type with compatible fields can't be streamed");
+    auto &&[err_code, buffer_len] = deserialize_metainfo<T>();
+    if SP_UNLIKELY (err_code) {
+      return err_code;
+    }
+    size_type = size_type_;
+    return visit_size_type([&](auto width) CONSTEXPR_INLINE_LAMBDA {
+      return deserialize_container_size<decltype(width)::value>(size);
+    });
+  }
+
+  template <typename Element>
+  STRUCT_PACK_MAY_INLINE struct_pack::err_code deserialize_element(
+      Element &element, unsigned char size_type) {
+    size_type_ = size_type;
+    return visit_size_type([&](auto width) CONSTEXPR_INLINE_LAMBDA {
+      return deserialize_one<decltype(width)::value, UINT64_MAX, true>(
+          element);
+    });
+  }
+
   template <typename T, typename... Args, size_t... I>
   STRUCT_PACK_INLINE struct_pack::err_code deserialize_compatibles(
       T &t, std::index_sequence<I...>, Args &...args) {
@@ -463,6 +552,172 @@ class unpacker {
     return err_code;
   }
 
+  template <typename Visitor>
+  STRUCT_PACK_INLINE struct_pack::err_code visit_size_type(Visitor &&visitor) {
+    switch (size_type_) {
+      case 0:
+        return visitor(std::integral_constant<std::size_t, 1>{});
+#ifdef STRUCT_PACK_OPTIMIZE
+      case 1:
+        return visitor(std::integral_constant<std::size_t, 2>{});
+      case 2:
+        return visitor(std::integral_constant<std::size_t, 4>{});
+      case 3:
+        if constexpr (sizeof(std::size_t) >= 8) {
+          return visitor(std::integral_constant<std::size_t, 8>{});
+        }
+        else {
+          return struct_pack::errc::invalid_width_of_container_length;
+        }
+#else
+      case 3:
+        if constexpr (sizeof(std::size_t) < 8) {
+          return struct_pack::errc::invalid_width_of_container_length;
+        }
+      case 2:
+      case 1:
+        return visitor(std::integral_constant<std::size_t, 2>{});
+#endif
+      default:
+        unreachable();
+    }
+  }
+
+#ifdef STRUCT_PACK_ENABLE_PMR
+  template <typename T>
+  STRUCT_PACK_INLINE void use_memory_resource(T &item) {
+    if (memory_resource_ != nullptr &&
+        item.get_allocator().resource() != memory_resource_) {
+      // the allocator of a container can't be replaced, so it's made again
+      // with the new one. It's going to be overwritten anyway.
+      item.~T();
+      new (&item) T(memory_resource_);
+    }
+  }
+#endif
+
+  template <size_t size_type>
+  STRUCT_PACK_INLINE struct_pack::err_code deserialize_container_size(
+      std::size_t &size) {
+    if constexpr (size_type == 1) {
+      if SP_UNLIKELY (!low_bytes_read_wrapper<size_type>(reader_, size)) {
+        return struct_pack::errc::no_buffer_space;
+      }
+    }
+    else {
+#ifdef STRUCT_PACK_OPTIMIZE
+      constexpr bool struct_pack_optimize = true;
+#else
+      constexpr bool struct_pack_optimize = false;
+#endif
+      if constexpr (force_optimize || struct_pack_optimize) {
+        if constexpr (size_type == 2) {
+          if SP_UNLIKELY (!low_bytes_read_wrapper<size_type>(reader_, size)) {
+            return struct_pack::errc::no_buffer_space;
+          }
+        }
+        else if constexpr (size_type == 4) {
+          if SP_UNLIKELY (!low_bytes_read_wrapper<size_type>(reader_, size)) {
+            return struct_pack::errc::no_buffer_space;
+          }
+        }
+        else if constexpr (size_type == 8) {
+          if constexpr (sizeof(std::size_t) >= 8) {
+            if SP_UNLIKELY (!low_bytes_read_wrapper<size_type>(reader_, size)) {
+              return struct_pack::errc::no_buffer_space;
+            }
+          }
+          else {
+            std::uint64_t sz;
+            if SP_UNLIKELY (!low_bytes_read_wrapper<size_type>(reader_, sz)) {
+              return struct_pack::errc::no_buffer_space;
+            }
+            if SP_UNLIKELY (sz > UINT32_MAX) {
+              return struct_pack::errc::invalid_width_of_container_length;
+            }
+            size = sz;
+          }
+        }
+        else {
+          static_assert(!size_type, "illegal size_type");
+        }
+      }
+      else {
+        switch (size_type_) {
+          case 1:
+            if SP_UNLIKELY (!low_bytes_read_wrapper<2>(reader_, size)) {
+              return struct_pack::errc::no_buffer_space;
+            }
+            break;
+          case 2:
+            if SP_UNLIKELY (!low_bytes_read_wrapper<4>(reader_, size)) {
+              return struct_pack::errc::no_buffer_space;
+            }
+            break;
+          case 3:
+            if constexpr (sizeof(std::size_t) >= 8) {
+              if SP_UNLIKELY (!low_bytes_read_wrapper<8>(reader_, size)) {
+                return struct_pack::errc::no_buffer_space;
+              }
+            }
+            else {
+              unreachable();
+            }
+            break;
+          default:
+            unreachable();
+        }
+      }
+    }
+    return {};
+  }
+
+  template <size_t size_type, typename U, typename Positions>
+  STRUCT_PACK_INLINE struct_pack::err_code index_fields_impl(
+      Positions &positions) {
+    static_assert(std::is_class_v<U> && !tuple<U>,
+                  "only the fields of a struct can be indexed");
+    U t;
+    auto start = reader_.tellg();
+    struct_pack::err_code code{};
+    if constexpr (is_trivial_serializable<U>::value &&
+                  is_little_endian_copyable<sizeof(U)>) {
+      // U is copied as a whole, so its fields are at their offsets in U.
+      visit_members(t, [&](auto &&...items) CONSTEXPR_INLINE_LAMBDA {
+        std::size_t i = 0;
+        ((positions[i++] =
+              start + ((const char *)&items - (const char *)&t)),
+         ...);
+      });
+      if SP_UNLIKELY (!reader_.ignore(sizeof(U))) {
+        return struct_pack::errc::no_buffer_space;
+      }
+    }
+    else {
+      visit_members(t, [&](auto &&...items) CONSTEXPR_INLINE_LAMBDA {
+        std::size_t i = 0;
+        auto f = [&](auto &&item) -> bool {
+          positions[i++] = reader_.tellg();
+          if constexpr (is_trivial_serializable<U>::value ||
+                        is_trivial_serializable<U, true>::value) {
+            code = deserialize_one<size_type, UINT64_MAX, false>(item);
+            if SP_LIKELY (!code) {
+              code = ignore_padding(align::padding_size<U>[i]);
+            }
+          }
+          else {
+            constexpr uint64_t tag = get_parent_tag<U>();
+            code = deserialize_one<size_type, UINT64_MAX, false, tag>(item);
+          }
+          return !code;
+        };
+        [[maybe_unused]] bool op = (f(items) && ...);
+      });
+    }
+    positions[struct_pack::members_count<U>] = reader_.tellg();
+    return code;
+  }
+
   template <typename size_type, typename version, typename NotSkip>
   struct variant_construct_helper {
     template <size_t index, typename unpack, typename variant_t>
@@ -874,81 +1129,15 @@ class unpacker {
         }
       }
       else if constexpr (container<type>) {
-        std::size_t size = 0;
-        bool result{};
-        if constexpr (size_type == 1) {
-          if SP_UNLIKELY (!low_bytes_read_wrapper<size_type>(reader_, size)) {
-            return struct_pack::errc::no_buffer_space;
-          }
+#ifdef STRUCT_PACK_ENABLE_PMR
+        if constexpr (NotSkip && pmr_container<type>) {
+          use_memory_resource(item);
         }
-        else {
-#ifdef STRUCT_PACK_OPTIMIZE
-          constexpr bool struct_pack_optimize = true;
-#else
-          constexpr bool struct_pack_optimize = false;
 #endif
-          if constexpr (force_optimize || struct_pack_optimize) {
-            if constexpr (size_type == 2) {
-              if SP_UNLIKELY (!low_bytes_read_wrapper<size_type>(reader_,
-                                                                 size)) {
-                return struct_pack::errc::no_buffer_space;
-              }
-            }
-            else if constexpr (size_type == 4) {
-              if SP_UNLIKELY (!low_bytes_read_wrapper<size_type>(reader_,
-                                                                 size)) {
-                return struct_pack::errc::no_buffer_space;
-              }
-            }
-            else if constexpr (size_type == 8) {
-              if constexpr (sizeof(std::size_t) >= 8) {
-                if SP_UNLIKELY (!low_bytes_read_wrapper<size_type>(reader_,
-                                                                   size)) {
-                  return struct_pack::errc::no_buffer_space;
-                }
-              }
-              else {
-                std::uint64_t sz;
-                if SP_UNLIKELY (!low_bytes_read_wrapper<size_type>(reader_,
-                                                                   sz)) {
-                  return struct_pack::errc::no_buffer_space;
-                }
-                if SP_UNLIKELY (sz > UINT32_MAX) {
-                  return struct_pack::errc::invalid_width_of_container_length;
-                }
-                size = sz;
-              }
-            }
-            else {
-              static_assert(!sizeof(T), "illegal size_type");
-            }
-          }
-          else {
-            switch (size_type_) {
-              case 1:
-                if SP_UNLIKELY (!low_bytes_read_wrapper<2>(reader_, size)) {
-                  return struct_pack::errc::no_buffer_space;
-                }
-                break;
-              case 2:
-                if SP_UNLIKELY (!low_bytes_read_wrapper<4>(reader_, size)) {
-                  return struct_pack::errc::no_buffer_space;
-                }
-                break;
-              case 3:
-                if constexpr (sizeof(std::size_t) >= 8) {
-                  if SP_UNLIKELY (!low_bytes_read_wrapper<8>(reader_, size)) {
-                    return struct_pack::errc::no_buffer_space;
-                  }
-                }
-                else {
-                  unreachable();
-                }
-                break;
-              default:
-                unreachable();
-            }
-          }
+        std::size_t size = 0;
+        code = deserialize_container_size<size_type>(size);
+        if SP_UNLIKELY (code) {
+          return code;
         }
         if (size == 0) {
           return {};
@@ -1091,6 +1280,45 @@ class unpacker {
                             "It's illegal to deserialize a span<T> which T "
                             "is a non-trival-serializable type.");
             }
+            else if constexpr (NotSkip && continuous_container<type> &&
+                               varint_t<value_type> &&
+                               checkable_reader_t<Reader>) {
+              // every varint takes a byte at least, so the size is checked
+              // before the container grows.
+              if SP_UNLIKELY (!reader_.check(size)) {
+                return struct_pack::errc::no_buffer_space;
+              }
+              resize(item, size);
+              auto *out = item.data();
+              std::size_t i = 0;
+              if constexpr (is_system_little_endian &&
+                            view_reader_t<Reader>) {
+                // decode blocks in place while the reader holds their longest
+                // encoding, so the varints need no bounds checks.
+                for (std::size_t block = 64; i < size; i += block) {
+                  block = (std::min)(block, size - i);
+                  while (block > 0 &&
+                         !reader_.check(block * max_varint_length)) {
+                    block /= 2;
+                  }
+                  if (block == 0) {
+                    break;
+                  }
+                  const char *begin = reader_.read_view(0);
+                  const char *end = begin;
+                  if SP_UNLIKELY (!decode_varint_run(end, out + i, block)) {
+                    return struct_pack::errc::invalid_buffer;
+                  }
+                  reader_.ignore(end - begin);
+                }
+              }
+              for (; i < size; ++i) {
+                code = detail::deserialize_varint(reader_, out[i]);
+                if SP_UNLIKELY (code) {
+                  return code;
+                }
+              }
+            }
             else if constexpr (NotSkip) {
               item.clear();
               if constexpr (can_reserve<type>) {
@@ -1423,6 +1651,9 @@ class unpacker {
  private:
   Reader &reader_;
   unsigned char size_type_;
+#ifdef STRUCT_PACK_ENABLE_PMR
+  std::pmr::memory_resource *memory_resource_ = nullptr;
+#endif
 };
 
 template <typename Reader>
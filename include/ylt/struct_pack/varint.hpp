@@ -15,6 +15,7 @@
  */
 #pragma once
 #include <cstdint>
+#include <cstring>
 #include <ostream>
 #include <system_error>
 #include <type_traits>
@@ -25,6 +26,8 @@ namespace struct_pack {
 
 namespace detail {
 
+constexpr inline std::size_t max_varint_length = sizeof(uint64_t) * 8 / 7 + 1;
+
 constexpr inline bool is_enable_fast_varint_coding(uint64_t tag) {
   return tag & struct_pack::USE_FAST_VARINT;
 }
@@ -270,6 +273,86 @@ STRUCT_PACK_INLINE void serialize_varint(writer& writer_, const T& t) {
     write_wrapper<sizeof(char)>(writer_, (char*)&tmp);
   }
 }
+
+template <typename T>
+STRUCT_PACK_INLINE void set_varint_value(T& t, uint64_t v) {
+  if constexpr (sintable_t<T>) {
+    t = decode_zigzag<int64_t>(v);
+  }
+  else if constexpr (std::is_enum_v<T>) {
+    t = static_cast<T>(v);
+  }
+  else {
+    t = v;
+  }
+}
+
+STRUCT_PACK_INLINE int countr_zero64(uint64_t v) {
+#if __cpp_lib_bitops >= 201907L
+  return std::countr_zero(v);
+#elif defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, v);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctzll(v);
+#endif
+}
+
+// Decode a varint of up to 8 bytes from 8 readable bytes at data, without
+// branching on its bytes. Return the length of the varint, or 0 if it's
+// longer.
+STRUCT_PACK_INLINE int decode_varint_fast(const char* data, uint64_t& v) {
+  uint64_t word;
+  memcpy(&word, data, sizeof(word));
+  // the high bit is clear in the last byte of a varint.
+  uint64_t stops = ~word & 0x8080808080808080ull;
+  if SP_UNLIKELY (stops == 0) {
+    return 0;
+  }
+  // the bytes up to and including the last one.
+  uint64_t mask = stops ^ (stops - 1);
+  // pack the 7 bit groups into 14, 28 and then 56 bits.
+  uint64_t x = word & mask & 0x7f7f7f7f7f7f7f7full;
+  x = (x & 0x007f007f007f007full) | ((x & 0x7f007f007f007f00ull) >> 1);
+  x = (x & 0x00003fff00003fffull) | ((x & 0x3fff00003fff0000ull) >> 2);
+  x = (x & 0x000000000fffffffull) | ((x & 0x0fffffff00000000ull) >> 4);
+  v = x;
+  return countr_zero64(stops) / 8 + 1;
+}
+
+/*
+ * Decode count varints from data into out and move data past them. data must
+ * have count * max_varint_length readable bytes, so that no varint needs a
+ * bounds check. Return false if one of them is too long.
+ */
+template <typename T>
+STRUCT_PACK_INLINE bool decode_varint_run(const char*& data, T* out,
+                                          std::size_t count) {
+  static_assert(is_system_little_endian);
+  for (std::size_t i = 0; i < count; ++i) {
+    uint64_t v;
+    int len = decode_varint_fast(data, v);
+    if SP_UNLIKELY (len == 0) {
+      v = 0;
+      for (std::size_t j = 0; j < max_varint_length; ++j) {
+        uint8_t now = data[j];
+        v |= (1ull * (now & 0x7fu)) << (j * 7);
+        if ((now & 0x80U) == 0) {
+          len = j + 1;
+          break;
+        }
+      }
+      if (len == 0) {
+        return false;
+      }
+    }
+    set_varint_value(out[i], v);
+    data += len;
+  }
+  return true;
+}
+
 #if __cpp_concepts >= 201907L
 template <reader_t Reader>
 #else
@@ -281,8 +364,7 @@ template <typename Reader>
   static_assert(reader_t<Reader>, "The writer type must satisfy requirements!");
 #endif
   uint8_t now;
-  constexpr const int8_t max_varint_length = sizeof(uint64_t) * 8 / 7 + 1;
-  for (int8_t i = 0; i < max_varint_length; ++i) {
+  for (std::size_t i = 0; i < max_varint_length; ++i) {
     if SP_UNLIKELY (!reader.read((char*)&now, sizeof(char))) {
       return struct_pack::errc::no_buffer_space;
     }
@@ -309,15 +391,7 @@ template <bool NotSkip = true,
   auto ec = deserialize_varint_impl(reader, v);
   if constexpr (NotSkip) {
     if SP_LIKELY (!ec) {
-      if constexpr (sintable_t<T>) {
-        t = decode_zigzag<int64_t>(v);
-      }
-      else if constexpr (std::is_enum_v<T>) {
-        t = static_cast<T>(v);
-      }
-      else {
-        t = v;
-      }
+      set_varint_value(t, v);
     }
   }
   return ec;
@@ -23,6 +23,7 @@
 #include "websocket.hpp"
 #include "ylt/coro_io/coro_file.hpp"
 #include "ylt/coro_io/coro_io.hpp"
+#include "ylt/coro_io/rate_limiter.hpp"
 
 namespace cinatra {
 struct websocket_result {
@@ -184,7 +185,11 @@ class coro_http_connection
         request_.set_body(body_);
       }
 
-      if (auto handler = router_.get_handler(key); handler) {
+      if (!admit(request_)) {
+        response_.set_status_and_content(status_type::too_many_requests,
+                                         "too many requests");
+      }
+      else if (auto handler = router_.get_handler(key); handler) {
         router_.route(handler, request_, response_, key);
       }
       else {
@@ -306,7 +311,11 @@ class coro_http_connection
               coro_http_request req(parser, this);
               coro_http_response resp(this);
               resp.need_date_head(response_.need_date());
-              if (auto handler = router_.get_handler(key); handler) {
+              if (!admit(req)) {
+                resp.set_status_and_content(status_type::too_many_requests,
+                                            "too many requests");
+              }
+              else if (auto handler = router_.get_handler(key); handler) {
                 router_.route(handler, req, resp, key);
               }
               else {
@@ -677,6 +686,18 @@ class coro_http_connection
 
   void set_ws_max_size(uint64_t max_size) { max_part_size_ = max_size; }
 
+  // admit requests through limiter, keyed by key_of(req), or by the client ip
+  // if key_of is empty.
+  void set_request_rate_limiter(
+      std::shared_ptr<coro_io::keyed_rate_limiter> limiter,
+      std::function<std::string_view(coro_http_request &)> key_of) {
+    request_rate_limiter_ = std::move(limiter);
+    rate_limit_key_of_ = std::move(key_of);
+    if (!rate_limit_key_of_) {
+      client_ip_ = coro_io::remote_ip(socket_);
+    }
+  }
+
   void set_shrink_to_fit(bool r) {
     need_shrink_every_time_ = r;
     response_.set_shrink_to_fit(r);
@@ -773,6 +794,14 @@ class coro_http_connection
   }
 
  private:
+  bool admit(coro_http_request &req) {
+    if (!request_rate_limiter_) {
+      return true;
+    }
+    return request_rate_limiter_->try_acquire(
+        rate_limit_key_of_ ? rate_limit_key_of_(req) : client_ip_);
+  }
+
   bool check_keep_alive() {
     if (parser_.has_close()) {
       return false;
@@ -822,6 +851,9 @@ class coro_http_connection
   uint64_t conn_id_{0};
   std::function<void(const uint64_t &conn_id)> quit_cb_ = nullptr;
   bool checkout_timeout_ = false;
+  std::shared_ptr<coro_io::keyed_rate_limiter> request_rate_limiter_;
+  std::function<std::string_view(coro_http_request &)> rate_limit_key_of_;
+  std::string client_ip_;
   std::atomic<std::chrono::system_clock::time_point> last_rwtime_;
   uint64_t max_part_size_ = 8 * 1024 * 1024;
   std::string resp_str_;
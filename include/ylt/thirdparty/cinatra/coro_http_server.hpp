@@ -38,6 +38,15 @@ class coro_http_server {
         acceptor_(pool_->get_executor()->get_asio_executor()),
         check_timer_(pool_->get_executor()->get_asio_executor()) {}
 
+  // pin the io threads by policy, e.g. to the CPUs of the NIC's NUMA node.
+  coro_http_server(size_t thread_num, unsigned short port,
+                   coro_io::cpu_affinity_policy policy)
+      : pool_(std::make_unique<coro_io::io_context_pool>(thread_num,
+                                                         std::move(policy))),
+        port_(port),
+        acceptor_(pool_->get_executor()->get_asio_executor()),
+        check_timer_(pool_->get_executor()->get_asio_executor()) {}
+
   ~coro_http_server() {
     CINATRA_LOG_INFO << "coro_http_server will quit";
     stop();
@@ -45,6 +54,28 @@ class coro_http_server {
 
   void set_no_delay(bool r) { no_delay_ = r; }
 
+  // call it before server start. Open one SO_REUSEPORT acceptor per io thread,
+  // the kernel spreads new connections among them and each connection stays on
+  // the thread which accepted it. Ignored with an outer io_context.
+  void set_reuse_port(bool r) { reuse_port_ = r; }
+
+  // call it before server start. New connections beyond the rate of their
+  // client ip are closed right after accept.
+  void set_accept_rate_limiter(
+      std::shared_ptr<coro_io::keyed_rate_limiter> limiter) {
+    accept_rate_limiter_ = std::move(limiter);
+  }
+
+  // call it before server start. Requests beyond the rate of their key get
+  // 429 Too Many Requests. The key is key_of(req), e.g. a tenant header, or
+  // the client ip if key_of is empty.
+  void set_request_rate_limiter(
+      std::shared_ptr<coro_io::keyed_rate_limiter> limiter,
+      std::function<std::string_view(coro_http_request &)> key_of = nullptr) {
+    request_rate_limiter_ = std::move(limiter);
+    rate_limit_key_of_ = std::move(key_of);
+  }
+
 #ifdef CINATRA_ENABLE_SSL
   void init_ssl(const std::string &cert_file, const std::string &key_file,
                 const std::string &passwd) {
@@ -76,14 +107,21 @@ class coro_http_server {
         });
       }
 
-      accept().start([p = std::move(promise)](auto &&res) mutable {
-        if (res.hasError()) {
-          p.setValue(std::errc::io_error);
-        }
-        else {
-          p.setValue(res.value());
-        }
-      });
+      for (auto &extra : reuse_port_acceptors_) {
+        accept(extra->acceptor, extra->close_waiter, extra->executor)
+            .via(extra->executor)
+            .detach();
+      }
+
+      accept(acceptor_, acceptor_close_waiter_, acceptor_owner())
+          .start([p = std::move(promise)](auto &&res) mutable {
+            if (res.hasError()) {
+              p.setValue(std::errc::io_error);
+            }
+            else {
+              p.setValue(res.value());
+            }
+          });
     }
     else {
       promise.setValue(ec);
@@ -489,6 +527,69 @@ class coro_http_server {
   }
 
  private:
+  // an extra listening socket bound to the same port with SO_REUSEPORT, owned
+  // by one io thread.
+  struct reuse_port_acceptor {
+    reuse_port_acceptor(coro_io::ExecutorWrapper<> *executor)
+        : executor(executor), acceptor(executor->get_asio_executor()) {}
+    coro_io::ExecutorWrapper<> *executor;
+    asio::ip::tcp::acceptor acceptor;
+    std::promise<void> close_waiter;
+  };
+
+  // with reuse_port, the executor which runs acceptor_. Otherwise nullptr.
+  coro_io::ExecutorWrapper<> *acceptor_owner() {
+    if (reuse_port_acceptors_.empty()) {
+      return nullptr;
+    }
+    for (size_t i = 0; i < pool_->pool_size(); ++i) {
+      auto executor = pool_->get_executor(i);
+      if (&executor->context() == &acceptor_.get_executor().context()) {
+        return executor;
+      }
+    }
+    return nullptr;
+  }
+
+  std::errc listen_reuse_port() {
+    using asio::ip::tcp;
+    auto endpoint = tcp::endpoint(tcp::v4(), port_);
+    for (size_t i = 0; i < pool_->pool_size(); ++i) {
+      auto executor = pool_->get_executor(i);
+      if (&executor->context() == &acceptor_.get_executor().context()) {
+        continue;
+      }
+      auto extra = std::make_unique<reuse_port_acceptor>(executor);
+      asio::error_code ec;
+      extra->acceptor.open(endpoint.protocol(), ec);
+      if (!ec) {
+        extra->acceptor.set_option(tcp::acceptor::reuse_address(true), ec);
+        coro_io::set_reuse_port(extra->acceptor, ec);
+        extra->acceptor.bind(endpoint, ec);
+      }
+      if (!ec) {
+        extra->acceptor.listen(asio::socket_base::max_listen_connections, ec);
+      }
+      if (ec) {
+        CINATRA_LOG_ERROR << "bind reuse_port acceptor " << i << " of port "
+                          << port_ << " error: " << ec.message();
+        extra->acceptor.close(ec);
+        for (auto &acceptor : reuse_port_acceptors_) {
+          acceptor->acceptor.close(ec);
+        }
+        reuse_port_acceptors_.clear();
+        acceptor_.cancel(ec);
+        acceptor_.close(ec);
+        return std::errc::address_in_use;
+      }
+      reuse_port_acceptors_.push_back(std::move(extra));
+    }
+    CINATRA_LOG_INFO << "listen port " << port_ << " with "
+                     << reuse_port_acceptors_.size() + 1
+                     << " reuse_port acceptors";
+    return {};
+  }
+
   std::errc listen() {
     CINATRA_LOG_INFO << "begin to listen";
     using asio::ip::tcp;
@@ -497,6 +598,15 @@ class coro_http_server {
 #ifdef __GNUC__
     acceptor_.set_option(tcp::acceptor::reuse_address(true));
 #endif
+    bool reuse_port = reuse_port_ && out_ctx_ == nullptr;
+    if (reuse_port && !coro_io::has_reuse_port) {
+      CINATRA_LOG_WARNING << "reuse_port isn't supported, use one acceptor";
+      reuse_port = false;
+    }
+    if (reuse_port) {
+      asio::error_code ignored_ec;
+      coro_io::set_reuse_port(acceptor_, ignored_ec);
+    }
     asio::error_code ec;
     acceptor_.bind(endpoint, ec);
     if (ec) {
@@ -519,13 +629,23 @@ class coro_http_server {
     port_ = end_point.port();
 
     CINATRA_LOG_INFO << "listen port " << port_ << " successfully";
+    if (reuse_port) {
+      return listen_reuse_port();
+    }
     return {};
   }
 
-  async_simple::coro::Lazy<std::errc> accept() {
+  // owner: with reuse_port, the executor of the acceptor, which runs all the
+  // connections it accepts.
+  async_simple::coro::Lazy<std::errc> accept(asio::ip::tcp::acceptor &acceptor,
+                                             std::promise<void> &close_waiter,
+                                             coro_io::ExecutorWrapper<> *owner) {
     for (;;) {
       coro_io::ExecutorWrapper<> *executor;
-      if (out_ctx_ == nullptr) {
+      if (owner != nullptr) {
+        executor = owner;
+      }
+      else if (out_ctx_ == nullptr) {
         executor = pool_->get_executor();
       }
       else {
@@ -535,17 +655,28 @@ class coro_http_server {
       }
 
       asio::ip::tcp::socket socket(executor->get_asio_executor());
-      auto error = co_await coro_io::async_accept(acceptor_, socket);
+      auto error = co_await coro_io::async_accept(acceptor, socket);
       if (error) {
         CINATRA_LOG_INFO << "accept failed, error: " << error.message();
         if (error == asio::error::operation_aborted ||
             error == asio::error::bad_descriptor) {
-          acceptor_close_waiter_.set_value();
+          close_waiter.set_value();
           co_return std::errc::operation_canceled;
         }
         continue;
       }
 
+      if (accept_rate_limiter_) {
+        auto client_ip = coro_io::remote_ip(socket);
+        if (!accept_rate_limiter_->try_acquire(client_ip)) {
+          CINATRA_LOG_WARNING << "too many connections from " << client_ip
+                              << ", close it";
+          std::error_code ignored_ec;
+          socket.close(ignored_ec);
+          continue;
+        }
+      }
+
       uint64_t conn_id = ++conn_id_;
       CINATRA_LOG_DEBUG << "new connection comming, id: " << conn_id;
       auto conn = std::make_shared<coro_http_connection>(
@@ -559,6 +690,10 @@ class coro_http_server {
       if (need_check_) {
         conn->set_check_timeout(true);
       }
+      if (request_rate_limiter_) {
+        conn->set_request_rate_limiter(request_rate_limiter_,
+                                       rate_limit_key_of_);
+      }
 
 #ifdef CINATRA_ENABLE_SSL
       if (use_ssl_) {
@@ -595,6 +730,14 @@ class coro_http_server {
       acceptor_.close(ec);
     });
     acceptor_close_waiter_.get_future().wait();
+    for (auto &extra : reuse_port_acceptors_) {
+      asio::dispatch(extra->acceptor.get_executor(), [&extra]() {
+        asio::error_code ec;
+        extra->acceptor.cancel(ec);
+        extra->acceptor.close(ec);
+      });
+      extra->close_waiter.get_future().wait();
+    }
   }
 
   void start_check_timer() {
@@ -758,8 +901,13 @@ class coro_http_server {
   std::thread thd_;
   std::promise<void> acceptor_close_waiter_;
   bool no_delay_ = true;
+  bool reuse_port_ = false;
+  std::shared_ptr<coro_io::keyed_rate_limiter> accept_rate_limiter_;
+  std::shared_ptr<coro_io::keyed_rate_limiter> request_rate_limiter_;
+  std::function<std::string_view(coro_http_request &)> rate_limit_key_of_;
+  std::vector<std::unique_ptr<reuse_port_acceptor>> reuse_port_acceptors_;
 
-  uint64_t conn_id_ = 0;
+  std::atomic<uint64_t> conn_id_ = 0;
   std::unordered_map<uint64_t, std::shared_ptr<coro_http_connection>>
       connections_;
   std::mutex conn_mtx_;
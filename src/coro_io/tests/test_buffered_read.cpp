@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <doctest.h>
+
+#include <asio/local/connect_pair.hpp>
+#include <asio/local/stream_protocol.hpp>
+#include <string>
+#include <thread>
+#include <ylt/coro_io/coro_io.hpp>
+
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+TEST_CASE("test async_read with buffered_read_stream") {
+  auto executor = coro_io::get_global_executor();
+  asio::local::stream_protocol::socket reader(executor->get_asio_executor());
+  asio::local::stream_protocol::socket writer(executor->get_asio_executor());
+  asio::local::connect_pair(reader, writer);
+
+  std::string small = "0123456789abcdef";
+  std::string big(5 * coro_io::default_read_buffer_size, '\0');
+  for (std::size_t i = 0; i < big.size(); ++i) {
+    big[i] = static_cast<char>(i % 251);
+  }
+  std::thread writer_thread([&] {
+    std::array<asio::const_buffer, 2> buffers{asio::buffer(small),
+                                              asio::buffer(big)};
+    asio::write(writer, buffers);
+  });
+
+  asio::buffered_read_stream<asio::local::stream_protocol::socket &> stream(
+      reader, coro_io::default_read_buffer_size);
+  async_simple::coro::syncAwait(
+      [&]() -> async_simple::coro::Lazy<void> {
+        std::string head(4, '\0');
+        auto [ec, n] = co_await coro_io::async_read(stream, asio::buffer(head));
+        CHECK(!ec);
+        CHECK(n == 4);
+        CHECK(head == "0123");
+        // the first read pulled more than it was asked for.
+        CHECK(stream.in_avail() > 0);
+
+        std::string body(12, '\0');
+        std::tie(ec, n) =
+            co_await coro_io::async_read(stream, asio::buffer(body));
+        CHECK(!ec);
+        CHECK(n == 12);
+        CHECK(body == "456789abcdef");
+
+        // larger than the buffer: buffered prefix + direct read.
+        std::string payload(big.size(), '\0');
+        std::tie(ec, n) =
+            co_await coro_io::async_read(stream, asio::buffer(payload));
+        CHECK(!ec);
+        CHECK(n == big.size());
+        CHECK(payload == big);
+      }()
+          .via(executor));
+  writer_thread.join();
+}
+#endif
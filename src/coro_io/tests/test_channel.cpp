@@ -2,6 +2,7 @@
 #include <async_simple/coro/SyncAwait.h>
 #include <doctest.h>
 
+#include <array>
 #include <asio/io_context.hpp>
 #include <cassert>
 #include <filesystem>
@@ -144,6 +145,282 @@ TEST_CASE("test Random") {
   }());
 }
 
+TEST_CASE("test P2C") {
+  async_simple::coro::syncAwait([]() -> async_simple::coro::Lazy<void> {
+    coro_rpc::coro_rpc_server server(1, 8801);
+    auto res = server.async_start();
+    REQUIRE_MESSAGE(res, "server start failed");
+    auto hosts =
+        std::vector<std::string_view>{"127.0.0.1:8801", "localhost:8801"};
+    auto channel = coro_io::channel<coro_rpc::coro_rpc_client>::create(
+        hosts, {.lba = coro_io::load_blance_algorithm::P2C});
+    int slow_cnt = 0;
+    for (int i = 0; i < 50; ++i) {
+      auto res = co_await channel.send_request(
+          [&hosts, &slow_cnt](
+              coro_rpc::coro_rpc_client &client,
+              std::string_view host) -> async_simple::coro::Lazy<void> {
+            // hosts[1] plays a replica in a GC pause.
+            if (host == hosts[1]) {
+              ++slow_cnt;
+              co_await coro_io::sleep_for(std::chrono::milliseconds{20});
+            }
+            co_return;
+          });
+      CHECK(res.has_value());
+    }
+    CHECK(slow_cnt <= 2);
+    // a single host has no second choice to compare with.
+    auto single_channel = coro_io::channel<coro_rpc::coro_rpc_client>::create(
+        {hosts[0]}, {.lba = coro_io::load_blance_algorithm::P2C});
+    for (int i = 0; i < 5; ++i) {
+      auto res = co_await single_channel.send_request(
+          [](coro_rpc::coro_rpc_client &client,
+             std::string_view host) -> async_simple::coro::Lazy<void> {
+            co_return;
+          });
+      CHECK(res.has_value());
+    }
+    server.stop();
+  }());
+}
+
+TEST_CASE("test least outstanding") {
+  async_simple::coro::syncAwait([]() -> async_simple::coro::Lazy<void> {
+    coro_rpc::coro_rpc_server server(1, 8801);
+    auto res = server.async_start();
+    REQUIRE_MESSAGE(res, "server start failed");
+    auto hosts =
+        std::vector<std::string_view>{"127.0.0.1:8801", "localhost:8801"};
+    auto channel = coro_io::channel<coro_rpc::coro_rpc_client>::create(
+        hosts, {.lba = coro_io::load_blance_algorithm::least_outstanding});
+    std::array<int, 2> cnt{};
+    auto request = [&]() -> async_simple::coro::Lazy<void> {
+      auto res = co_await channel.send_request(
+          [&hosts, &cnt](
+              coro_rpc::coro_rpc_client &client,
+              std::string_view host) -> async_simple::coro::Lazy<void> {
+            ++cnt[host == hosts[0] ? 0 : 1];
+            co_await coro_io::sleep_for(std::chrono::milliseconds{50});
+          });
+      CHECK(res.has_value());
+    };
+    std::vector<async_simple::coro::RescheduleLazy<void>> works;
+    for (int i = 0; i < 4; ++i) {
+      works.emplace_back(request().via(coro_io::get_global_executor()));
+    }
+    co_await async_simple::coro::collectAll(std::move(works));
+    CHECK(cnt[0] == 2);
+    CHECK(cnt[1] == 2);
+    server.stop();
+  }());
+}
+
+TEST_CASE("test consistent hash") {
+  async_simple::coro::syncAwait([]() -> async_simple::coro::Lazy<void> {
+    coro_rpc::coro_rpc_server server1(1, 8801);
+    auto res = server1.async_start();
+    REQUIRE_MESSAGE(res, "server start failed");
+    coro_rpc::coro_rpc_server server2(1, 8802);
+    auto res2 = server2.async_start();
+    REQUIRE_MESSAGE(res2, "server start failed");
+    auto hosts = std::vector<std::string_view>{
+        "127.0.0.1:8801", "localhost:8801", "127.0.0.1:8802"};
+    auto route = [](auto &channel,
+                    std::string key) -> async_simple::coro::Lazy<std::string> {
+      std::string ret;
+      auto res = co_await channel.send_request(
+          key,
+          [&ret](coro_rpc::coro_rpc_client &client,
+                 std::string_view host) -> async_simple::coro::Lazy<void> {
+            ret = host;
+            co_return;
+          });
+      CHECK(res.has_value());
+      co_return ret;
+    };
+    auto channel = coro_io::channel<coro_rpc::coro_rpc_client>::create(
+        hosts, {.lba = coro_io::load_blance_algorithm::consistent_hash});
+    // hosts[1] is removed.
+    auto shrunk = coro_io::channel<coro_rpc::coro_rpc_client>::create(
+        {hosts[0], hosts[2]},
+        {.lba = coro_io::load_blance_algorithm::consistent_hash});
+    std::array<int, 3> cnt{};
+    for (int i = 0; i < 300; ++i) {
+      auto key = "user:" + std::to_string(i);
+      auto host = co_await route(channel, key);
+      auto again = co_await route(channel, key);
+      CHECK(host == again);
+      auto index = std::find(hosts.begin(), hosts.end(), host) - hosts.begin();
+      ++cnt[index];
+      // only the keys of the removed host move.
+      if (index != 1) {
+        auto moved = co_await route(shrunk, key);
+        CHECK(host == moved);
+      }
+    }
+    for (auto n : cnt) {
+      CHECK(n > 50);
+    }
+    server1.stop();
+    server2.stop();
+  }());
+}
+
+TEST_CASE("test channel skips ejected host") {
+  async_simple::coro::syncAwait([]() -> async_simple::coro::Lazy<void> {
+    coro_rpc::coro_rpc_server server(1, 8801);
+    auto res = server.async_start();
+    REQUIRE_MESSAGE(res, "server start failed");
+    // nothing listens on 8804.
+    auto hosts =
+        std::vector<std::string_view>{"127.0.0.1:8801", "127.0.0.1:8804"};
+    auto channel = coro_io::channel<coro_rpc::coro_rpc_client>::create(
+        hosts, {.pool_config = {.connect_retry_count = 0,
+                                .eject_consecutive_failures = 2}});
+    int failed_cnt = 0;
+    for (int i = 0; i < 20; ++i) {
+      auto res = co_await channel.send_request(
+          [&hosts](coro_rpc::coro_rpc_client &client,
+                   std::string_view host) -> async_simple::coro::Lazy<void> {
+            CHECK(host == hosts[0]);
+            co_return;
+          });
+      if (!res.has_value()) {
+        ++failed_cnt;
+      }
+    }
+    CHECK(failed_cnt == 2);
+    server.stop();
+  }());
+}
+
+TEST_CASE("test hedged request") {
+  async_simple::coro::syncAwait([]() -> async_simple::coro::Lazy<void> {
+    coro_rpc::coro_rpc_server server(1, 8801);
+    auto res = server.async_start();
+    REQUIRE_MESSAGE(res, "server start failed");
+    auto hosts =
+        std::vector<std::string_view>{"127.0.0.1:8801", "localhost:8801"};
+    auto channel = coro_io::channel<coro_rpc::coro_rpc_client>::create(
+        hosts, {.hedge_delay = std::chrono::milliseconds{20}});
+    auto begin = std::chrono::steady_clock::now();
+    auto loser_closed = std::make_shared<std::atomic<bool>>(false);
+    auto op = [slow_host = hosts[0], loser_closed](
+                  coro_rpc::coro_rpc_client &client, std::string_view host)
+        -> async_simple::coro::Lazy<std::string> {
+      if (host == slow_host) {
+        co_await coro_io::sleep_for(std::chrono::milliseconds{300});
+        *loser_closed = client.has_closed();
+      }
+      co_return std::string{host};
+    };
+    // round-robin starts with the slow hosts[0].
+    auto ret = co_await channel.send_request(op);
+    REQUIRE(ret.has_value());
+    CHECK(ret.value() == hosts[1]);
+    CHECK(std::chrono::steady_clock::now() - begin <
+          std::chrono::milliseconds{200});
+    // let the dropped request finish.
+    co_await coro_io::sleep_for(std::chrono::milliseconds{400});
+    // the losing request ran on, its pooled client wasn't closed.
+    CHECK(!*loser_closed);
+    server.stop();
+  }());
+}
+
+TEST_CASE("test hedged request with outlier ejection") {
+  async_simple::coro::syncAwait([]() -> async_simple::coro::Lazy<void> {
+    coro_rpc::coro_rpc_server server(1, 8806);
+    auto res = server.async_start();
+    REQUIRE_MESSAGE(res, "server start failed");
+    auto hosts =
+        std::vector<std::string_view>{"127.0.0.1:8806", "localhost:8806"};
+    auto channel = coro_io::channel<coro_rpc::coro_rpc_client>::create(
+        hosts, {.pool_config = {.eject_consecutive_failures = 1},
+                .hedge_delay = std::chrono::milliseconds{20},
+                .retry_budget_ratio = 1});
+    auto op = [slow_host = hosts[0]](coro_rpc::coro_rpc_client &client,
+                                     std::string_view host)
+        -> async_simple::coro::Lazy<std::string> {
+      if (host == slow_host) {
+        co_await coro_io::sleep_for(std::chrono::milliseconds{100});
+      }
+      co_return std::string{host};
+    };
+    for (int i = 0; i < 4; ++i) {
+      auto ret = co_await channel.send_request(op);
+      REQUIRE(ret.has_value());
+      CHECK(ret.value() == hosts[1]);
+    }
+    co_await coro_io::sleep_for(std::chrono::milliseconds{200});
+    // losing to a hedge isn't a failure of the slower host.
+    auto slow_pool = coro_io::g_clients_pool<coro_rpc::coro_rpc_client>().at(
+        hosts[0]);
+    CHECK(!slow_pool->is_ejected());
+    CHECK(slow_pool->free_client_count() > 0);
+    server.stop();
+  }());
+}
+
+TEST_CASE("test retry budget") {
+  coro_io::retry_budget budget(0.5, 2);
+  CHECK(budget.try_withdraw());
+  CHECK(budget.try_withdraw());
+  CHECK(!budget.try_withdraw());
+  budget.deposit();
+  CHECK(!budget.try_withdraw());
+  budget.deposit();
+  CHECK(budget.try_withdraw());
+}
+
+TEST_CASE("test latency histogram") {
+  coro_io::latency_histogram histogram;
+  CHECK(!histogram.quantile(0.95));
+  for (int i = 1; i <= 100; ++i) {
+    histogram.record(std::chrono::milliseconds{i});
+  }
+  auto p95 = histogram.quantile(0.95);
+  REQUIRE(p95);
+  CHECK(*p95 >= std::chrono::milliseconds{95});
+  CHECK(*p95 <= std::chrono::milliseconds{120});
+}
+
+TEST_CASE("test retry") {
+  async_simple::coro::syncAwait([]() -> async_simple::coro::Lazy<void> {
+    coro_rpc::coro_rpc_server server(1, 8801);
+    auto res = server.async_start();
+    REQUIRE_MESSAGE(res, "server start failed");
+    // nothing listens on 8805, and it isn't ejected by default.
+    auto hosts =
+        std::vector<std::string_view>{"127.0.0.1:8801", "127.0.0.1:8805"};
+    typename coro_io::channel<coro_rpc::coro_rpc_client>::channel_config
+        config{.pool_config = {.connect_retry_count = 0}, .max_retries = 1};
+    auto op = [](coro_rpc::coro_rpc_client &client,
+                 std::string_view host) -> async_simple::coro::Lazy<void> {
+      co_return;
+    };
+    auto channel =
+        coro_io::channel<coro_rpc::coro_rpc_client>::create(hosts, config);
+    for (int i = 0; i < 10; ++i) {
+      auto res = co_await channel.send_request(op);
+      CHECK(res.has_value());
+    }
+
+    // only two retries in the budget.
+    config.shared_retry_budget = std::make_shared<coro_io::retry_budget>(0, 2);
+    auto limited =
+        coro_io::channel<coro_rpc::coro_rpc_client>::create(hosts, config);
+    int ok_cnt = 0;
+    for (int i = 0; i < 10; ++i) {
+      auto res = co_await limited.send_request(op);
+      ok_cnt += res.has_value();
+    }
+    CHECK(ok_cnt == 7);
+    server.stop();
+  }());
+}
+
 TEST_CASE("test single host") {
   async_simple::coro::syncAwait([]() -> async_simple::coro::Lazy<void> {
     coro_rpc::coro_rpc_server server(1, 8801);
@@ -238,4 +238,197 @@ TEST_CASE("test client pools parallel r/w") {
     co_await collectAll(std::move(works));
   }());
   ELOG_DEBUG << "test client pools parallel r/w over.";
-}
\ No newline at end of file
+}
+TEST_CASE("test client pool load stats") {
+  async_simple::coro::syncAwait([]() -> async_simple::coro::Lazy<void> {
+    coro_rpc::coro_rpc_server server(1, 8801);
+    auto is_started = server.async_start();
+    REQUIRE(is_started);
+    auto pool = coro_io::client_pool<coro_rpc::coro_rpc_client>::create(
+        "127.0.0.1:8801");
+    CHECK(pool->outstanding_requests() == 0);
+    CHECK(pool->latency_ewma() == 0ns);
+    auto res = co_await pool->send_request(
+        [&pool](coro_rpc::coro_rpc_client &client) -> Lazy<void> {
+          CHECK(pool->outstanding_requests() == 1);
+          co_await coro_io::sleep_for(20ms);
+        });
+    CHECK(res.has_value());
+    CHECK(pool->outstanding_requests() == 0);
+    auto latency = pool->latency_ewma();
+    CHECK(latency >= 15ms);
+    CHECK(latency <= 20s);
+    server.stop();
+  }());
+}
+
+TEST_CASE("test client pool outlier ejection") {
+  async_simple::coro::syncAwait([]() -> async_simple::coro::Lazy<void> {
+    auto pool = coro_io::client_pool<coro_rpc::coro_rpc_client>::create(
+        "127.0.0.1:8803", {.connect_retry_count = 0,
+                           .eject_consecutive_failures = 2,
+                           .base_ejection_time = 200ms});
+    bool called = false;
+    auto op = [&called](coro_rpc::coro_rpc_client &client) -> Lazy<void> {
+      called = true;
+      co_return;
+    };
+    for (int i = 0; i < 2; ++i) {
+      auto res = co_await pool->send_request(op);
+      CHECK(res.error() == std::errc::connection_refused);
+    }
+    CHECK(pool->is_ejected());
+    auto tp = std::chrono::steady_clock::now();
+    auto res = co_await pool->send_request(op);
+    CHECK(res.error() == std::errc::connection_refused);
+    CHECK(std::chrono::steady_clock::now() - tp < 50ms);
+
+    // the probe fails, ejected again for 400ms.
+    co_await coro_io::sleep_for(250ms);
+    CHECK(!pool->is_ejected());
+    res = co_await pool->send_request(op);
+    CHECK(!res.has_value());
+    co_await coro_io::sleep_for(250ms);
+    CHECK(pool->is_ejected());
+    CHECK(!called);
+
+    coro_rpc::coro_rpc_server server(1, 8803);
+    auto is_started = server.async_start();
+    REQUIRE(is_started);
+    co_await coro_io::sleep_for(200ms);
+    res = co_await pool->send_request(op);
+    CHECK(res.has_value());
+    CHECK(called);
+    CHECK(!pool->is_ejected());
+    server.stop();
+  }());
+}
+
+using rpc_result_t =
+    coro_rpc::rpc_result<void, coro_rpc::protocol::coro_rpc_protocol>;
+Lazy<void> hang_past_timeout() { co_await coro_io::sleep_for(300ms); }
+void answer_error(coro_rpc::context<void> ctx) {
+  ctx.response_error(coro_rpc::err_code{104}, "an error of the function");
+}
+
+TEST_CASE("test client pool ejects a host which doesn't answer") {
+  async_simple::coro::syncAwait([]() -> async_simple::coro::Lazy<void> {
+    coro_rpc::coro_rpc_server server(1, 8804);
+    server.register_handler<hang_past_timeout, answer_error>();
+    auto is_started = server.async_start();
+    REQUIRE(is_started);
+    auto pool = coro_io::client_pool<coro_rpc::coro_rpc_client>::create(
+        "127.0.0.1:8804",
+        {.eject_consecutive_failures = 2, .base_ejection_time = 200ms});
+
+    // errors the host answered with aren't its failures.
+    auto answered =
+        [](coro_rpc::coro_rpc_client &client) -> Lazy<rpc_result_t> {
+      co_return co_await client.call<answer_error>();
+    };
+    for (int i = 0; i < 3; ++i) {
+      auto res = co_await pool->send_request(answered);
+      REQUIRE(res.has_value());
+      CHECK(!res.value().has_value());
+    }
+    CHECK(!pool->is_ejected());
+
+    // the connection stays open after a call timeout, but the timeouts count.
+    auto hang = [](coro_rpc::coro_rpc_client &client) -> Lazy<rpc_result_t> {
+      co_return co_await client.call_for<hang_past_timeout>(50ms);
+    };
+    for (int i = 0; i < 2; ++i) {
+      auto res = co_await pool->send_request(hang);
+      REQUIRE(res.has_value());
+      CHECK(res.value().error().code == coro_rpc::errc::timed_out);
+    }
+    CHECK(pool->is_ejected());
+    server.stop();
+  }());
+}
+
+TEST_CASE("test client pool warm up") {
+  async_simple::coro::syncAwait([]() -> async_simple::coro::Lazy<void> {
+    coro_rpc::coro_rpc_server server(1, 8801);
+    auto is_started = server.async_start();
+    REQUIRE(is_started);
+    auto pool = coro_io::client_pool<coro_rpc::coro_rpc_client>::create(
+        "127.0.0.1:8801", {.warm_up_rate = 100});
+    auto tp = std::chrono::steady_clock::now();
+    auto cnt = co_await pool->warm_up(10);
+    CHECK(cnt == 10);
+    CHECK(pool->free_client_count() == 10);
+    // 9 waits of 10ms between the connects.
+    CHECK(std::chrono::steady_clock::now() - tp >= 80ms);
+    cnt = co_await pool->warm_up(5);
+    CHECK(cnt == 10);
+    server.stop();
+  }());
+}
+
+void is_new_connection(coro_rpc::context<bool> ctx) {
+  ctx.response_msg(!std::exchange(ctx.tag(), true).has_value());
+}
+
+TEST_CASE("test client pool min idle") {
+  async_simple::coro::syncAwait([]() -> async_simple::coro::Lazy<void> {
+    coro_rpc::coro_rpc_server server(1, 8801);
+    auto is_started = server.async_start();
+    REQUIRE(is_started);
+    auto pool = coro_io::client_pool<coro_rpc::coro_rpc_client>::create(
+        "127.0.0.1:8801", {.reconnect_wait_time = 50ms,
+                           .idle_timeout = 100ms,
+                           .min_idle_connection = 5,
+                           .warm_up_rate = 0});
+    co_await coro_io::sleep_for(200ms);
+    CHECK(pool->free_client_count() == 5);
+    // idle clients beyond min_idle_connection are still closed.
+    auto cnt = co_await pool->warm_up(8);
+    CHECK(cnt == 8);
+    co_await coro_io::sleep_for(500ms);
+    CHECK(pool->free_client_count() == 5);
+    server.stop();
+  }());
+}
+
+TEST_CASE("test client pool replaces min idle clients") {
+  async_simple::coro::syncAwait([]() -> async_simple::coro::Lazy<void> {
+    coro_rpc::coro_rpc_server server(1, 8807);
+    server.register_handler<is_new_connection>();
+    auto is_started = server.async_start();
+    REQUIRE(is_started);
+    auto pool = coro_io::client_pool<coro_rpc::coro_rpc_client>::create(
+        "127.0.0.1:8807", {.reconnect_wait_time = 300ms,
+                           .idle_timeout = 100ms,
+                           .max_connection_time = 400ms,
+                           .min_idle_connection = 5,
+                           .warm_up_rate = 0});
+    auto is_new = [&](int) -> Lazy<bool> {
+      auto ret = co_await pool->send_request(
+          [](coro_rpc::coro_rpc_client& client) -> Lazy<bool> {
+            auto fresh = co_await client.call<is_new_connection>();
+            // hold the client, so that each caller gets another one.
+            co_await coro_io::sleep_for(20ms);
+            co_return fresh && fresh.value();
+          });
+      co_return ret && ret.value();
+    };
+    // between two top ups, which would add clients for the busy ones.
+    co_await coro_io::sleep_for(150ms);
+    std::vector<Lazy<bool>> calls;
+    for (int i = 0; i < 5; ++i) {
+      calls.push_back(is_new(i));
+    }
+    for (auto& fresh : co_await collectAll(std::move(calls))) {
+      CHECK(fresh.value());
+    }
+    auto fresh = co_await is_new(0);
+    CHECK(!fresh);
+    // kept past max_connection_time, the idle clients are reconnected.
+    co_await coro_io::sleep_for(600ms);
+    fresh = co_await is_new(0);
+    CHECK(fresh);
+    CHECK(pool->free_client_count() == 5);
+    server.stop();
+  }());
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <doctest.h>
+
+#include <chrono>
+#include <ylt/coro_io/concurrency_limiter.hpp>
+
+using namespace std::chrono_literals;
+
+namespace {
+coro_io::concurrency_limiter::config test_config() {
+  coro_io::concurrency_limiter::config conf;
+  conf.initial_limit = 10;
+  conf.min_limit = 4;
+  conf.max_limit = 100;
+  conf.smoothing = 1;
+  conf.window_size = 10;
+  return conf;
+}
+}  // namespace
+
+TEST_CASE("test concurrency_limiter try_acquire") {
+  coro_io::concurrency_limiter limiter(test_config());
+  CHECK(limiter.limit() == 10);
+  for (int i = 0; i < 10; ++i) {
+    CHECK(limiter.try_acquire());
+  }
+  CHECK(!limiter.try_acquire());
+  CHECK(limiter.inflight() == 10);
+  limiter.release(1ms);
+  CHECK(limiter.inflight() == 9);
+  CHECK(limiter.try_acquire());
+}
+
+TEST_CASE("test concurrency_limiter adapts to rtt") {
+  coro_io::concurrency_limiter limiter(test_config());
+  // a full limit at a steady rtt grows it.
+  for (int i = 0; i < 10; ++i) {
+    REQUIRE(limiter.try_acquire());
+  }
+  for (int i = 0; i < 10; ++i) {
+    limiter.release(1ms);
+  }
+  auto grown = limiter.limit();
+  CHECK(grown > 10);
+
+  // requests getting ten times slower shrink it.
+  for (size_t i = 0; i < grown; ++i) {
+    REQUIRE(limiter.try_acquire());
+  }
+  for (int i = 0; i < 10; ++i) {
+    limiter.release(10ms);
+  }
+  CHECK(limiter.limit() < grown);
+  CHECK(limiter.limit() >= 4);
+  while (limiter.inflight() > 0) {
+    limiter.release(1ms);
+  }
+
+  // a load far below the limit doesn't grow it.
+  auto limit = limiter.limit();
+  for (int i = 0; i < 10; ++i) {
+    REQUIRE(limiter.try_acquire());
+    limiter.release(1ms);
+  }
+  CHECK(limiter.limit() == limit);
+}
@@ -2,16 +2,20 @@
 #include <async_simple/coro/SyncAwait.h>
 #include <doctest.h>
 
+#include <array>
+#include <atomic>
 #include <asio/io_context.hpp>
 #include <cassert>
 #include <filesystem>
 #include <fstream>
 #include <memory>
+#include <optional>
 #include <string_view>
 #include <system_error>
 #include <thread>
 #include <ylt/coro_io/coro_file.hpp>
 #include <ylt/coro_io/coro_io.hpp>
+#include <ylt/coro_io/coro_mmap_file.hpp>
 #include <ylt/coro_io/io_context_pool.hpp>
 
 namespace fs = std::filesystem;
@@ -258,6 +262,246 @@ TEST_CASE("coro_file pread and pwrite basic test") {
   }
 }
 
+#if defined(YLT_HAS_NATIVE_IO_URING)
+TEST_CASE("coro_file native io_uring test") {
+  std::string filename = "test_native_uring.tmp";
+  create_files({filename}, 190);
+  coro_io::io_context_pool pool(1);
+  std::thread thd([&pool] {
+    pool.run();
+  });
+  auto executor = pool.get_executor();
+  auto& uring = asio::use_service<coro_io::uring_service>(executor->context());
+  if (!uring.available()) {
+    pool.stop();
+    thd.join();
+    return;
+  }
+
+  alignas(4096) static char fixed_buf[8192];
+  auto ec = uring.register_buffers({iovec{fixed_buf, sizeof(fixed_buf)}});
+  {
+    coro_io::coro_file file(executor);
+    async_simple::coro::syncAwait(
+        file.async_open(filename, coro_io::flags::read_write,
+                        coro_io::read_type::native_uring));
+    REQUIRE(file.is_open());
+
+    std::string buf = "cccccccccc";
+    auto write_ec = async_simple::coro::syncAwait(
+        file.async_pwrite(0, buf.data(), buf.size()));
+    CHECK(!write_ec);
+
+    char buf2[100];
+    auto pair = async_simple::coro::syncAwait(file.async_pread(0, buf2, 20));
+    CHECK(std::string_view(buf2, pair.second) == "ccccccccccAAAAAAAAAA");
+    CHECK(!file.eof());
+
+    pair = async_simple::coro::syncAwait(file.async_pread(110, buf2, 100));
+    CHECK(pair.second == 80);
+    CHECK(!file.eof());
+
+    pair = async_simple::coro::syncAwait(file.async_pread(200, buf2, 100));
+    CHECK(pair.second == 0);
+    CHECK(file.eof());
+
+    if (!ec) {
+      // lies in the registered buffer, so it's a fixed read.
+      pair = async_simple::coro::syncAwait(
+          file.async_pread(5, fixed_buf + 100, 10));
+      CHECK(std::string_view(fixed_buf + 100, pair.second) == "cccccAAAAA");
+    }
+
+    // concurrent reads are submitted together.
+    auto read_all = [&file]() -> async_simple::coro::Lazy<void> {
+      std::vector<std::array<char, 10>> bufs(19);
+      std::vector<
+          async_simple::coro::Lazy<std::pair<std::error_code, size_t>>>
+          reads;
+      for (size_t i = 0; i < bufs.size(); ++i) {
+        reads.push_back(file.async_pread(i * 10, bufs[i].data(), 10));
+      }
+      auto results =
+          co_await async_simple::coro::collectAll(std::move(reads));
+      for (size_t i = 0; i < results.size(); ++i) {
+        CHECK(results[i].value().second == 10);
+        CHECK(bufs[i][0] == (i == 0 ? 'c' : 'A'));
+      }
+    };
+    async_simple::coro::syncAwait(read_all());
+  }
+
+#if defined(O_DIRECT)
+  {
+    coro_io::coro_file file(executor);
+    async_simple::coro::syncAwait(
+        file.async_open(filename, coro_io::flags::read_only | coro_io::direct,
+                        coro_io::read_type::native_uring));
+    // tmpfs doesn't support O_DIRECT.
+    if (file.is_open()) {
+      auto pair = async_simple::coro::syncAwait(
+          file.async_pread(0, fixed_buf + 1, 4096));
+      CHECK(pair.first == std::errc::invalid_argument);
+
+      pair = async_simple::coro::syncAwait(
+          file.async_pread(0, fixed_buf, 4096));
+      CHECK(!pair.first);
+      CHECK(pair.second == 190);
+    }
+  }
+#endif
+
+  pool.stop();
+  thd.join();
+  // it would wait for the io_context forever.
+  CHECK(uring.register_buffers({}) == std::errc::operation_canceled);
+
+  {
+    // closed after its io_context, and the io_uring, are gone.
+    std::optional<coro_io::coro_file> file;
+    {
+      coro_io::io_context_pool pool2(1);
+      std::thread thd2([&pool2] {
+        pool2.run();
+      });
+      file.emplace(pool2.get_executor());
+      async_simple::coro::syncAwait(
+          file->async_open(filename, coro_io::flags::read_only,
+                           coro_io::read_type::native_uring));
+      CHECK(file->is_open());
+      pool2.stop();
+      thd2.join();
+    }
+    file.reset();
+  }
+  fs::remove(filename);
+}
+#endif
+
+TEST_CASE("coro_file vectored and range read test") {
+  std::string filename = "test_ranges.tmp";
+  create_files({filename}, 190);
+  std::vector<coro_io::read_type> types{coro_io::read_type::pread};
+#if defined(YLT_HAS_NATIVE_IO_URING)
+  if (asio::use_service<coro_io::uring_service>(
+          coro_io::get_global_block_executor()->context())
+          .available()) {
+    types.push_back(coro_io::read_type::native_uring);
+  }
+#endif
+  for (auto type : types) {
+    coro_io::coro_file file{};
+    async_simple::coro::syncAwait(
+        file.async_open(filename, coro_io::flags::read_write, type));
+    REQUIRE(file.is_open());
+
+    std::string head = "bbbbb";
+    std::string tail = "ccccc";
+    std::vector<iovec> out{{head.data(), head.size()},
+                           {tail.data(), tail.size()}};
+    auto ec = async_simple::coro::syncAwait(file.async_pwritev(20, out));
+    CHECK(!ec);
+
+    char buf1[8];
+    char buf2[8];
+    std::vector<iovec> in{{buf1, 8}, {buf2, 8}};
+    auto pair = async_simple::coro::syncAwait(file.async_preadv(16, in));
+    CHECK(!pair.first);
+    CHECK(pair.second == 16);
+    CHECK(std::string_view(buf1, 8) == "AAAAbbbb");
+    CHECK(std::string_view(buf2, 8) == "bcccccAA");
+
+    char buf3[10];
+    char buf4[10];
+    char buf5[10];
+    std::vector<coro_io::file_range> ranges{
+        {18, buf3, 10}, {0, buf4, 10}, {185, buf5, 10}};
+    auto results =
+        async_simple::coro::syncAwait(file.async_read_ranges(ranges));
+    REQUIRE(results.size() == 3);
+    CHECK(std::string_view(buf3, results[0].second) == "AAbbbbbccc");
+    CHECK(std::string_view(buf4, results[1].second) == "AAAAAAAAAA");
+    CHECK(results[2].second == 5);
+    CHECK(!file.eof());
+
+    ranges = {{190, buf3, 10}};
+    results = async_simple::coro::syncAwait(file.async_read_ranges(ranges));
+    CHECK(results[0].second == 0);
+    CHECK(file.eof());
+  }
+  fs::remove(filename);
+}
+
+#if !defined(ASIO_WINDOWS)
+TEST_CASE("coro_mmap_file test") {
+  using advice = coro_io::coro_mmap_file::advice;
+  std::string filename = "test_mmap.tmp";
+  create_files({filename}, 190);
+  coro_io::coro_mmap_file file;
+  CHECK(file.read_at(0, 10).empty());
+  auto ec = async_simple::coro::syncAwait(file.async_prefetch());
+  CHECK(ec == std::errc::bad_file_descriptor);
+
+  CHECK(!async_simple::coro::syncAwait(file.async_open("no_such_file.tmp")));
+  REQUIRE(async_simple::coro::syncAwait(file.async_open(filename)));
+  CHECK(file.is_open());
+  CHECK(file.size() == 190);
+  CHECK(file.view() == std::string(190, 'A'));
+  CHECK(file.read_at(180, 100) == std::string(10, 'A'));
+  CHECK(file.read_at(190, 10).empty());
+
+  ec = async_simple::coro::syncAwait(file.async_prefetch(advice::sequential));
+  CHECK(!ec);
+  ec = async_simple::coro::syncAwait(file.async_prefetch(100, 50));
+  CHECK(!ec);
+
+  auto old_mapping = file.mapping();
+  REQUIRE(old_mapping != nullptr);
+  {
+    std::ofstream out(filename, std::ios::binary | std::ios::app);
+    out << "BBBBBBBBBB";
+  }
+  CHECK(file.size() == 190);
+  CHECK(file.remap());
+  CHECK(file.size() == 200);
+  CHECK(file.read_at(185, 10) == "AAAAABBBBB");
+  // the old mapping is released by the file, but stays valid while held.
+  CHECK(file.mapping() != old_mapping);
+  CHECK(old_mapping->view() == std::string(190, 'A'));
+  CHECK(old_mapping.use_count() == 1);
+
+  {
+    // readers racing with remap() hold the mapping they read from.
+    std::atomic<bool> done = false;
+    std::thread reader([&file, &done] {
+      while (!done) {
+        auto mapping = file.mapping();
+        CHECK(mapping->view().substr(0, 5) == "AAAAA");
+        CHECK(file.size() >= 200);
+      }
+    });
+    for (int i = 0; i < 20; ++i) {
+      {
+        std::ofstream out(filename, std::ios::binary | std::ios::app);
+        out << std::string(4096, 'C');
+      }
+      CHECK(file.remap());
+    }
+    done = true;
+    reader.join();
+    CHECK(file.size() == 200 + 20 * 4096);
+  }
+
+  auto held = file.mapping();
+  file.close();
+  CHECK(!file.is_open());
+  CHECK(file.mapping() == nullptr);
+  CHECK(held->view().substr(185, 15) == "AAAAABBBBBBBBBB");
+  CHECK(!file.remap());
+  fs::remove(filename);
+}
+#endif
+
 async_simple::coro::Lazy<void> test_basic_read(std::string filename) {
   coro_io::coro_file file{};
   co_await file.async_open(filename.data(), coro_io::flags::read_only);
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <doctest.h>
+
+#include <future>
+#include <thread>
+#include <ylt/coro_io/io_context_pool.hpp>
+
+TEST_CASE("test parse cpu list") {
+  using coro_io::detail::parse_cpu_list;
+  CHECK(parse_cpu_list("") == std::vector<int>{});
+  CHECK(parse_cpu_list("3\n") == std::vector<int>{3});
+  CHECK(parse_cpu_list("0-3,8,10-11\n") ==
+        std::vector<int>{0, 1, 2, 3, 8, 10, 11});
+}
+
+TEST_CASE("test cpu_affinity_policy resolve") {
+  coro_io::cpu_affinity_policy policy;
+  auto allowed = coro_io::detail::allowed_cpus();
+#ifdef __linux__
+  REQUIRE(!allowed.empty());
+#endif
+  CHECK(policy.resolve() == allowed);
+
+  policy.cpus = {5, 1, 3};
+  CHECK(policy.resolve() == std::vector<int>{5, 1, 3});
+
+  policy.cpus.clear();
+  policy.numa_node = 100000;  // no such node
+  CHECK(policy.resolve().empty());
+
+  policy.numa_node = -1;
+  policy.skip_hyperthread_siblings = true;
+  auto cores = policy.resolve();
+  CHECK(!cores.empty() == !allowed.empty());
+  CHECK(cores.size() <= allowed.size());
+}
+
+#ifdef __linux__
+TEST_CASE("test io_context_pool pins threads by policy") {
+  auto cpu = coro_io::detail::allowed_cpus().back();
+  coro_io::cpu_affinity_policy policy;
+  policy.cpus = {cpu};
+  coro_io::io_context_pool pool(2, policy);
+  std::thread thd([&pool] {
+    pool.run();
+  });
+  for (int i = 0; i < 2; ++i) {
+    std::promise<int> running_on;
+    pool.get_executor()->schedule([&running_on] {
+      running_on.set_value(sched_getcpu());
+    });
+    CHECK(running_on.get_future().get() == cpu);
+  }
+  pool.stop();
+  thd.join();
+}
+#endif
@@ -1,6 +1,10 @@
 #include <async_simple/coro/Collect.h>
 #include <doctest.h>
 
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
 #include <ylt/coro_io/io_context_pool.hpp>
 #include <ylt/coro_io/rate_limiter.hpp>
 
@@ -86,4 +90,66 @@ TEST_CASE("test smooth_bursty_rate_limiter multi coroutine") {
   double cost = (current_time_mills() - start_mills) / 1000.0;
 
   CHECK(cost > expected_cost - cost_diff);
-}
\ No newline at end of file
+}
+TEST_CASE("test token_bucket") {
+  coro_io::token_bucket bucket(10, 5);
+  for (int i = 0; i < 5; ++i) {
+    CHECK(bucket.try_acquire());
+  }
+  CHECK(!bucket.try_acquire());
+  std::this_thread::sleep_for(std::chrono::milliseconds(250));
+  CHECK(bucket.try_acquire(2));
+  CHECK(!bucket.try_acquire(2));
+
+  // acquire takes permits in advance and waits for them.
+  int64_t start_mills = current_time_mills();
+  auto wait = async_simple::coro::syncAwait(bucket.acquire(5));
+  double cost = (current_time_mills() - start_mills) / 1000.0;
+  CHECK(wait.count() > 100);
+  CHECK(cost > 0.1);
+}
+
+TEST_CASE("test token_bucket multi thread") {
+  coro_io::token_bucket bucket(1, 1000);
+  std::atomic<int> acquired = 0;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&] {
+      for (int j = 0; j < 500; ++j) {
+        if (bucket.try_acquire()) {
+          ++acquired;
+        }
+      }
+    });
+  }
+  for (auto &thd : threads) {
+    thd.join();
+  }
+  CHECK(acquired >= 1000);
+  CHECK(acquired <= 1001);
+}
+
+TEST_CASE("test keyed_rate_limiter") {
+  coro_io::keyed_rate_limiter limiter(1, 2, 4, 1);
+  CHECK(limiter.try_acquire("tenant-a"));
+  CHECK(limiter.try_acquire("tenant-a"));
+  CHECK(!limiter.try_acquire("tenant-a"));
+  // keys don't share a bucket.
+  CHECK(limiter.try_acquire("tenant-b", 2));
+  CHECK(!limiter.try_acquire("tenant-b"));
+  CHECK(limiter.size() == 2);
+
+  for (int i = 0; i < 10; ++i) {
+    CHECK(limiter.try_acquire("ip-" + std::to_string(i)));
+  }
+  CHECK(limiter.size() == 4);
+  // tenant-a was evicted, it comes back with a full bucket.
+  CHECK(limiter.try_acquire("tenant-a"));
+
+  coro_io::keyed_rate_limiter sharded(1, 1, 1000);
+  for (int i = 0; i < 5000; ++i) {
+    sharded.try_acquire("ip-" + std::to_string(i));
+  }
+  CHECK(sharded.size() <= 1000);
+  CHECK(sharded.size() > 0);
+}
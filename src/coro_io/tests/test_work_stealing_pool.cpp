@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <async_simple/coro/Lazy.h>
+#include <async_simple/coro/Sleep.h>
+#include <async_simple/coro/SyncAwait.h>
+#include <doctest.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <ylt/coro_io/io_context_pool.hpp>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("test work_stealing_executor_pool steals from a busy thread") {
+  coro_io::work_stealing_executor_pool pool(2, 2);
+  std::thread thd([&pool] {
+    pool.run();
+  });
+  // executors are handed out on io_context 0, 1, 0, 1.
+  auto long_executor = pool.get_executor();
+  pool.get_executor();
+  auto short_executor = pool.get_executor();
+  CHECK(&long_executor->context() == &short_executor->context());
+
+  std::promise<void> long_started;
+  std::promise<void> long_done;
+  std::promise<std::chrono::steady_clock::time_point> short_done;
+  long_executor->schedule([&] {
+    long_started.set_value();
+    std::this_thread::sleep_for(500ms);
+    long_done.set_value();
+  });
+  long_started.get_future().wait();
+  auto begin = std::chrono::steady_clock::now();
+  short_executor->schedule([&] {
+    short_done.set_value(std::chrono::steady_clock::now());
+  });
+  // the other thread runs it while io_context 0's own thread is busy.
+  auto end = short_done.get_future().get();
+  CHECK(end - begin < 400ms);
+  long_done.get_future().wait();
+  CHECK(pool.stolen_count() > 0);
+
+  pool.stop();
+  thd.join();
+}
+
+TEST_CASE("test work_stealing_executor_pool doesn't run another reactor") {
+  coro_io::work_stealing_executor_pool pool(2, 2);
+  std::thread thd([&pool] {
+    pool.run();
+  });
+  auto executor = pool.get_executor();
+  auto &ctx = executor->context();
+
+  // block the thread of io_context 0 in a handler of the io_context itself.
+  std::promise<std::thread::id> blocked;
+  std::atomic<bool> unblocked = false;
+  asio::post(ctx, [&] {
+    blocked.set_value(std::this_thread::get_id());
+    std::this_thread::sleep_for(300ms);
+    unblocked = true;
+  });
+  auto ctx_thread = blocked.get_future().get();
+  std::promise<std::pair<std::thread::id, bool>> posted_done;
+  asio::post(ctx, [&] {
+    posted_done.set_value({std::this_thread::get_id(), unblocked.load()});
+  });
+  std::promise<std::thread::id> task_done;
+  executor->schedule([&] {
+    task_done.set_value(std::this_thread::get_id());
+  });
+  // the strand is taken by the idle thread, the io_context's own handler
+  // waits for its thread.
+  CHECK(task_done.get_future().get() != ctx_thread);
+  auto [posted_thread, after_unblocked] = posted_done.get_future().get();
+  CHECK(posted_thread == ctx_thread);
+  CHECK(after_unblocked);
+  CHECK(pool.stolen_count() > 0);
+
+  pool.stop();
+  thd.join();
+}
+
+TEST_CASE("test work_stealing_executor_pool keeps a strand serial") {
+  coro_io::work_stealing_executor_pool pool(4, 1);
+  std::thread thd([&pool] {
+    pool.run();
+  });
+  auto executor = pool.get_executor();
+  constexpr int count = 2000;
+  std::atomic<int> in_flight = 0;
+  std::atomic<bool> overlapped = false;
+  int counter = 0;
+  std::promise<void> done;
+  for (int i = 0; i < count; ++i) {
+    executor->schedule([&] {
+      if (in_flight.fetch_add(1) != 0) {
+        overlapped = true;
+      }
+      if (++counter == count) {
+        done.set_value();
+      }
+      in_flight.fetch_sub(1);
+    });
+  }
+  done.get_future().wait();
+  CHECK(!overlapped);
+  CHECK(counter == count);
+
+  pool.stop();
+  thd.join();
+}
+
+TEST_CASE("test work_stealing_executor_pool checks in to the strand") {
+  // both strands are on the single io_context.
+  coro_io::work_stealing_executor_pool pool(1, 2);
+  std::thread thd([&pool] {
+    pool.run();
+  });
+  auto a = pool.get_executor();
+  auto b = pool.get_executor();
+  REQUIRE(a != b);
+  std::promise<bool> on_b;
+  a->checkin(
+      [&on_b, b] {
+        on_b.set_value(b->currentThreadInExecutor());
+      },
+      b->checkout());
+  CHECK(on_b.get_future().get());
+
+  pool.stop();
+  thd.join();
+}
+
+TEST_CASE("test work_stealing_executor_pool runs lazy") {
+  coro_io::work_stealing_executor_pool pool(2);
+  std::thread thd([&pool] {
+    pool.run();
+  });
+  auto executor = pool.get_executor();
+  auto ret = async_simple::coro::syncAwait(
+      [executor]() -> async_simple::coro::Lazy<bool> {
+        co_await async_simple::coro::sleep(10ms);
+        co_return executor->currentThreadInExecutor();
+      }()
+          .via(executor));
+  CHECK(ret);
+
+  pool.stop();
+  thd.join();
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Counts the heap allocations made by the server's io thread per echo call.
+//
+// The response buffers are pooled, so the count doesn't grow with the
+// payload. It isn't zero: every call still allocates the frames of the
+// async_simple::coro::Lazy coroutines reading the request and writing the
+// response (and the detached start of the writer), as Lazy has no allocator
+// hook. A release build makes 7 allocations per echo call, echo_string one
+// more for its std::string argument when it doesn't fit the small buffer.
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <ylt/coro_rpc/coro_rpc_client.hpp>
+#include <ylt/coro_rpc/coro_rpc_server.hpp>
+
+using async_simple::coro::syncAwait;
+
+namespace {
+std::atomic<std::thread::id> g_server_thread{};
+std::atomic<uint64_t> g_server_allocs{0};
+std::atomic<uint64_t> g_server_alloc_bytes{0};
+
+void count(std::size_t size) {
+  if (std::this_thread::get_id() ==
+      g_server_thread.load(std::memory_order_relaxed)) {
+    g_server_allocs.fetch_add(1, std::memory_order_relaxed);
+    g_server_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+  }
+}
+}  // namespace
+
+void *operator new(std::size_t size) {
+  count(size);
+  if (void *p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+void *operator new[](std::size_t size) { return ::operator new(size); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+
+std::string_view echo(std::string_view str) {
+  g_server_thread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+  return str;
+}
+
+std::string echo_string(std::string str) { return str; }
+
+template <auto func>
+void run(coro_rpc::coro_rpc_client &client, std::string_view name,
+         std::size_t payload_size) {
+  constexpr int warm_up = 1000;
+  constexpr int rounds = 100000;
+  std::string payload(payload_size, 'A');
+  for (int i = 0; i < warm_up; ++i) {
+    [[maybe_unused]] auto ret = syncAwait(client.call<func>(payload));
+  }
+  auto allocs = g_server_allocs.load();
+  auto bytes = g_server_alloc_bytes.load();
+  for (int i = 0; i < rounds; ++i) {
+    auto ret = syncAwait(client.call<func>(payload));
+    if (!ret) {
+      std::printf("call failed: %s\n", ret.error().msg.data());
+      return;
+    }
+  }
+  allocs = g_server_allocs.load() - allocs;
+  bytes = g_server_alloc_bytes.load() - bytes;
+  std::printf("%-12s payload %6zuB: %.2f allocs/call, %.1f bytes/call\n",
+              name.data(), payload_size, double(allocs) / rounds,
+              double(bytes) / rounds);
+}
+
+int main() {
+  coro_rpc::coro_rpc_server server(1, 9001);
+  server.register_handler<echo, echo_string>();
+  auto res = server.async_start();
+  if (!res) {
+    std::printf("server start failed\n");
+    return 1;
+  }
+  coro_rpc::coro_rpc_client client;
+  if (auto ec = syncAwait(client.connect("127.0.0.1", "9001")); ec) {
+    std::printf("connect failed: %s\n", ec.message().data());
+    return 1;
+  }
+  // the first call pins down the server's io thread.
+  [[maybe_unused]] auto ret =
+      syncAwait(client.call<echo>(std::string_view{}));
+  for (std::size_t size : {8, 100, 4096}) {
+    run<echo>(client, "echo", size);
+  }
+  for (std::size_t size : {8, 100, 4096}) {
+    run<echo_string>(client, "echo_string", size);
+  }
+  return 0;
+}
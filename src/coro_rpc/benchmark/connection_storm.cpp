@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Connection storm: clients connect, make one call and disconnect, as fast as
+// they can. Compares one acceptor with one reuse_port acceptor per io thread.
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <ylt/coro_rpc/coro_rpc_client.hpp>
+#include <ylt/coro_rpc/coro_rpc_server.hpp>
+
+using async_simple::coro::Lazy;
+
+std::string_view hi() { return "hi"; }
+
+std::atomic<bool> g_stop{false};
+std::atomic<uint64_t> g_conns{0};
+std::atomic<uint64_t> g_errors{0};
+std::atomic<unsigned> g_running{0};
+
+Lazy<void> storm(coro_io::ExecutorWrapper<> *executor, std::string port) {
+  while (!g_stop.load(std::memory_order_relaxed)) {
+    coro_rpc::coro_rpc_client client(*executor);
+    if (auto ec = co_await client.connect("127.0.0.1", port); ec) {
+      g_errors.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    auto ret = co_await client.call<hi>();
+    if (ret) {
+      g_conns.fetch_add(1, std::memory_order_relaxed);
+    }
+    else {
+      g_errors.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+}
+
+void run(unsigned server_threads, bool reuse_port, int seconds) {
+  coro_rpc::config::coro_rpc_default_config config;
+  config.thread_num = server_threads;
+  config.port = 0;
+  config.reuse_port = reuse_port;
+  coro_rpc::coro_rpc_server server(config);
+  server.register_handler<hi>();
+  auto res = server.async_start();
+  if (!res) {
+    std::printf("server start failed\n");
+    return;
+  }
+  auto port = std::to_string(server.port());
+
+  g_stop = false;
+  g_conns = 0;
+  g_errors = 0;
+  coro_io::io_context_pool client_pool(server_threads);
+  std::thread thd([&client_pool] {
+    client_pool.run();
+  });
+  auto begin = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < server_threads * 16; ++i) {
+    auto executor = client_pool.get_executor();
+    ++g_running;
+    storm(executor, port).via(executor).start([](auto &&) {
+      --g_running;
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::seconds(seconds));
+  g_stop = true;
+  auto cost = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                            begin)
+                  .count();
+  // let the last calls finish before tearing down the server.
+  while (g_running > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  client_pool.stop();
+  thd.join();
+  server.stop();
+  std::printf("%2u io threads, %-14s: %9.0f conns/s, %llu errors\n",
+              server_threads, reuse_port ? "reuse_port" : "one acceptor",
+              g_conns.load() / cost, (unsigned long long)g_errors.load());
+}
+
+int main(int argc, char **argv) {
+  int seconds = argc > 1 ? std::atoi(argv[1]) : 3;
+  // the clients take the other half of the cores.
+  unsigned max_threads = argc > 2 ? std::atoi(argv[2])
+                                  : std::thread::hardware_concurrency() / 2;
+  if (max_threads == 0) {
+    max_threads = 1;
+  }
+  for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+    run(threads, false, seconds);
+    run(threads, true, seconds);
+  }
+  return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Compares the router lookup through its hash maps with the frozen table.
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <ylt/coro_rpc/coro_rpc_context.hpp>
+#include <ylt/coro_rpc/impl/protocol/coro_rpc_protocol.hpp>
+
+using router_t =
+    coro_rpc::protocol::router<coro_rpc::protocol::coro_rpc_protocol>;
+
+void noop() {}
+async_simple::coro::Lazy<void> coro_noop() { co_return; }
+
+// the lookup coro_connection does for every request.
+// `round` rotates the ids, so that rounds can't be folded together.
+template <typename Router>
+std::size_t dispatch(Router &router, const std::vector<uint32_t> &ids,
+                     std::size_t round) {
+  std::size_t found = 0;
+  const std::size_t mask = ids.size() - 1;
+  for (std::size_t i = 0; i < ids.size(); ++i) {
+    auto id = ids[(i + round) & mask];
+    if (router.get_handler(id)) {
+      ++found;
+    }
+    else if (router.get_coro_handler(id)) {
+      ++found;
+    }
+  }
+  return found;
+}
+
+double ns_per_lookup(router_t &router, const std::vector<uint32_t> &ids,
+                     int rounds) {
+  std::size_t found = dispatch(router, ids, 0);  // warm up
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; ++i) {
+    found += dispatch(router, ids, i);
+  }
+  auto cost = std::chrono::duration<double, std::nano>(
+                  std::chrono::steady_clock::now() - begin)
+                  .count();
+  if (found != ids.size() * (rounds + 1)) {
+    std::printf("lookup failed\n");
+  }
+  return cost / (double(ids.size()) * rounds);
+}
+
+int main() {
+  constexpr std::size_t lookups = 1 << 16;  // a power of two
+  for (std::size_t cnt : {10, 100, 1000}) {
+    std::mt19937 gen(cnt);
+    std::vector<uint32_t> keys(cnt);
+    router_t router;
+    // function ids are MD5 derived, random keys behave alike.
+    for (std::size_t i = 0; i < cnt; ++i) {
+      keys[i] = gen();
+      if (i % 2 == 0) {
+        router.register_handler<noop>(keys[i]);
+      }
+      else {
+        router.register_handler<coro_noop>(keys[i]);
+      }
+    }
+    std::vector<uint32_t> ids(lookups);
+    std::uniform_int_distribution<std::size_t> pick(0, cnt - 1);
+    for (auto &id : ids) {
+      id = keys[pick(gen)];
+    }
+    int rounds = 100;
+    double maps = ns_per_lookup(router, ids, rounds);
+    router.freeze();
+    double frozen = ns_per_lookup(router, ids, rounds);
+    std::printf("%4zu functions: hash maps %6.2f ns, frozen table %6.2f ns\n",
+                cnt, maps, frozen);
+  }
+  return 0;
+}
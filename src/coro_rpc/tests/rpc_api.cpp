@@ -15,6 +15,9 @@
  */
 #include "rpc_api.hpp"
 
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
 #include <ylt/coro_rpc/coro_rpc_context.hpp>
 #include <ylt/easylog.hpp>
 
@@ -102,6 +105,82 @@ void coro_fun_with_delay_return_void_cost_long_time(
   fun_with_delay_return_void_cost_long_time(std::move(conn));
 }
 
+void echo_with_delay(coro_rpc::context<int> conn, int val, int delay_ms) {
+  conn.set_delay();
+  std::thread([conn = std::move(conn), val, delay_ms]() mutable {
+    std::this_thread::sleep_for(std::chrono::milliseconds{delay_ms});
+    conn.response_msg(val);
+  }).detach();
+}
+
+void echo_attachment_with_delay(coro_rpc::context<void> conn, int delay_ms) {
+  conn.set_delay();
+  conn.set_response_attachment(conn.release_request_attachment());
+  std::thread([conn = std::move(conn), delay_ms]() mutable {
+    std::this_thread::sleep_for(std::chrono::milliseconds{delay_ms});
+    conn.response_msg();
+  }).detach();
+}
+
+void echo_in_batch(coro_rpc::context<int> conn, int val, int batch) {
+  static std::mutex mtx;
+  static std::vector<std::pair<coro_rpc::context<int>, int>> waiting;
+  conn.set_delay();
+  std::vector<std::pair<coro_rpc::context<int>, int>> ready;
+  {
+    std::lock_guard lock(mtx);
+    waiting.emplace_back(std::move(conn), val);
+    if (waiting.size() < static_cast<std::size_t>(batch)) {
+      return;
+    }
+    std::swap(ready, waiting);
+  }
+  for (auto &[ctx, v] : ready) {
+    ctx.response_msg(v);
+  }
+}
+
+void get_write_stats(coro_rpc::context<std::array<uint64_t, 3>> conn) {
+  auto &stats = conn.get_write_stats();
+  conn.response_msg(std::array<uint64_t, 3>{
+      stats.flush_count, stats.message_count, stats.max_coalesced});
+}
+
+void blob_view_in_body(coro_rpc::context<bool> conn, std::string_view blob) {
+  auto body = conn.get_request_body();
+  conn.response_msg(blob.data() >= body.data() &&
+                    blob.data() + blob.size() <= body.data() + body.size());
+}
+
+int64_t sum_span(std::span<const int> values) {
+  return std::accumulate(values.begin(), values.end(), int64_t{0});
+}
+
+int point_dot(struct_pack::trivial_view<point3> a,
+              struct_pack::trivial_view<point3> b) {
+  return a.get().x * b.get().x + a.get().y * b.get().y + a.get().z * b.get().z;
+}
+
+async_simple::coro::Generator<int> count_to(int n) {
+  for (int i = 0; i < n; ++i) {
+    co_yield i;
+  }
+}
+
+async_simple::coro::Generator<int> count_produced(int n) {
+  for (int i = 0; i < n; ++i) {
+    ++g_produced_items;
+    co_yield i;
+  }
+}
+
+async_simple::coro::Generator<std::string> stream_then_throw(int n) {
+  for (int i = 0; i < n; ++i) {
+    co_yield std::to_string(i);
+  }
+  throw std::runtime_error("stream broken");
+}
+
 std::string async_hi() { return "async hi"; }
 
 std::string HelloService::hello() {
@@ -15,6 +15,9 @@
  */
 #ifndef CORO_RPC_RPC_API_HPP
 #define CORO_RPC_RPC_API_HPP
+#include <array>
+#include <atomic>
+#include <span>
 #include <string>
 #include <thread>
 #include <ylt/coro_rpc/coro_rpc_context.hpp>
@@ -47,10 +50,40 @@ void coro_fun_with_delay_return_string_twice(
     coro_rpc::context<std::string> conn);
 void coro_fun_with_delay_return_void_cost_long_time(
     coro_rpc::context<void> conn);
+void echo_with_delay(coro_rpc::context<int> conn, int val, int delay_ms);
+void echo_attachment_with_delay(coro_rpc::context<void> conn, int delay_ms);
+// holds the responses back until `batch` calls have come, then sends them all.
+void echo_in_batch(coro_rpc::context<int> conn, int val, int batch);
+void get_write_stats(coro_rpc::context<std::array<uint64_t, 3>> conn);
+// view arguments point into the request body instead of being copied.
+void blob_view_in_body(coro_rpc::context<bool> conn, std::string_view blob);
+int64_t sum_span(std::span<const int> values);
+struct point3 {
+  int x, y, z;
+};
+int point_dot(struct_pack::trivial_view<point3> a,
+              struct_pack::trivial_view<point3> b);
+inline async_simple::coro::Lazy<std::size_t> coro_blob_size(
+    std::string_view blob) {
+  co_await coro_io::post([] {
+  });
+  co_return blob.size();
+}
+// streaming rpc functions
+async_simple::coro::Generator<int> count_to(int n);
+async_simple::coro::Generator<std::string> stream_then_throw(int n);
+// count_to(n), counting the items produced in g_produced_items.
+inline std::atomic<int> g_produced_items = 0;
+async_simple::coro::Generator<int> count_produced(int n);
 inline async_simple::coro::Lazy<void> coro_func_return_void(int i) {
   co_return;
 }
 inline async_simple::coro::Lazy<int> coro_func(int i) { co_return i; }
+inline async_simple::coro::Lazy<int> coro_echo_with_delay(int i,
+                                                         int delay_ms) {
+  co_await coro_io::sleep_for(std::chrono::milliseconds(delay_ms));
+  co_return i;
+}
 inline async_simple::coro::Lazy<void> coro_func_delay_return_int(
     coro_rpc::context<int> conn, int i) {
   conn.response_msg(i);
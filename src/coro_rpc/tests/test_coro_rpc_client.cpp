@@ -13,6 +13,7 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <async_simple/coro/Collect.h>
 #include <async_simple/coro/Lazy.h>
 #include <async_simple/coro/SyncAwait.h>
 
@@ -20,6 +21,7 @@
 #include <chrono>
 #include <cstddef>
 #include <memory>
+#include <numeric>
 #include <thread>
 #include <variant>
 #include <ylt/coro_io/coro_io.hpp>
@@ -383,6 +385,32 @@ TEST_CASE("testing client with eof") {
   REQUIRE_MESSAGE(ret.error().code == coro_rpc::errc::io_error,
                   ret.error().msg);
 }
+TEST_CASE("testing coroutine functions run in order by default") {
+  g_action = {};
+  coro_rpc_server server(2, 8801);
+  server.register_handler<coro_echo_with_delay>();
+  auto res = server.async_start();
+  REQUIRE_MESSAGE(res, "server start failed");
+  coro_rpc_client client(*coro_io::get_global_executor(), g_client_id++);
+  auto ec = client.sync_connect("127.0.0.1", "8801");
+  REQUIRE_MESSAGE(!ec, ec.message());
+
+  auto begin = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::duration fast_cost{};
+  auto fast = [&]() -> Lazy<int> {
+    auto ret = co_await client.call<coro_echo_with_delay>(2, 0);
+    fast_cost = std::chrono::steady_clock::now() - begin;
+    co_return ret.value();
+  };
+  syncAwait([&]() -> Lazy<void> {
+    auto [slow_ret, fast_ret] = co_await collectAll(
+        client.call<coro_echo_with_delay>(1, 300), fast());
+    CHECK(slow_ret.value().value() == 1);
+    CHECK(fast_ret.value() == 2);
+  }());
+  CHECK(fast_cost >= 250ms);
+}
+
 TEST_CASE("testing client with attachment") {
   g_action = {};
   coro_rpc_server server(2, 8801);
@@ -409,6 +437,257 @@ TEST_CASE("testing client with attachment") {
   CHECK(client.get_resp_attachment() == "");
 }
 
+TEST_CASE("testing client with multiplexed calls") {
+  g_action = {};
+  coro_rpc::config::coro_rpc_default_config config;
+  config.thread_num = 2;
+  config.max_concurrent_calls = 4;
+  coro_rpc_server server(config);
+  server.register_handler<echo_with_delay, echo_attachment_with_delay,
+                          coro_echo_with_delay, echo_in_batch,
+                          get_write_stats>();
+  auto res = server.async_start();
+  REQUIRE_MESSAGE(res, "server start failed");
+  coro_rpc_client client(*coro_io::get_global_executor(), g_client_id++);
+  auto ec = client.sync_connect("127.0.0.1", "8801");
+  REQUIRE_MESSAGE(!ec, ec.message());
+
+  SUBCASE("out of order responses") {
+    // the later a call is sent, the earlier its response comes back.
+    using coro_rpc_protocol = coro_rpc::protocol::coro_rpc_protocol;
+    std::vector<Lazy<rpc_result<int, coro_rpc_protocol>>> calls;
+    for (int i = 0; i < 10; ++i) {
+      calls.push_back(client.call<echo_with_delay>(i, (10 - i) * 20));
+    }
+    auto begin = std::chrono::steady_clock::now();
+    auto results = syncAwait([&]() -> Lazy<std::vector<async_simple::Try<
+                                        rpc_result<int, coro_rpc_protocol>>>> {
+      co_return co_await collectAll(std::move(calls));
+    }());
+    auto cost = std::chrono::steady_clock::now() - begin;
+    for (int i = 0; i < 10; ++i) {
+      REQUIRE(results[i].value().has_value());
+      CHECK(results[i].value().value() == i);
+    }
+    // calls are pipelined, so they don't wait for each other (1100ms).
+    CHECK(cost < 800ms);
+  }
+
+  SUBCASE("every call gets the attachment of its own response") {
+    std::vector<std::string> attachments;
+    for (int i = 0; i < 10; ++i) {
+      attachments.push_back("attachment " + std::to_string(i));
+    }
+    auto call = [&](int i) -> Lazy<void> {
+      client.set_req_attachment(attachments[i]);
+      auto ret = co_await client.call_with_attachment<
+          echo_attachment_with_delay>((10 - i) * 20);
+      CHECK(ret.result.has_value());
+      CHECK(ret.resp_attachment == attachments[i]);
+    };
+    syncAwait([&]() -> Lazy<void> {
+      std::vector<Lazy<void>> calls;
+      for (int i = 0; i < 10; ++i) {
+        calls.push_back(call(i));
+      }
+      co_await collectAll(std::move(calls));
+    }());
+  }
+
+  SUBCASE("a slow coroutine function doesn't hold up the next calls") {
+    auto begin = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration fast_cost{};
+    auto fast = [&]() -> Lazy<int> {
+      auto ret = co_await client.call<coro_echo_with_delay>(2, 0);
+      fast_cost = std::chrono::steady_clock::now() - begin;
+      co_return ret.value();
+    };
+    syncAwait([&]() -> Lazy<void> {
+      auto [slow_ret, fast_ret] = co_await collectAll(
+          client.call<coro_echo_with_delay>(1, 500), fast());
+      CHECK(slow_ret.value().value() == 1);
+      CHECK(fast_ret.value() == 2);
+    }());
+    CHECK(fast_cost < 300ms);
+  }
+
+  SUBCASE("the connection stops reading at max_concurrent_calls") {
+    auto begin = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration fast_cost{};
+    auto fast = [&]() -> Lazy<void> {
+      co_await client.call<coro_echo_with_delay>(0, 0);
+      fast_cost = std::chrono::steady_clock::now() - begin;
+    };
+    auto slow = [&](int i) -> Lazy<void> {
+      auto ret = co_await client.call<coro_echo_with_delay>(i, 300);
+      CHECK(ret.value() == i);
+    };
+    syncAwait([&]() -> Lazy<void> {
+      std::vector<Lazy<void>> calls;
+      for (int i = 0; i < 4; ++i) {
+        calls.push_back(slow(i));
+      }
+      calls.push_back(fast());
+      co_await collectAll(std::move(calls));
+    }());
+    CHECK(fast_cost >= 250ms);
+  }
+
+  SUBCASE("timeout of one call doesn't affect the others") {
+    syncAwait([&]() -> Lazy<void> {
+      auto [slow, fast] =
+          co_await collectAll(client.call_for<echo_with_delay>(50ms, 1, 500),
+                              client.call<echo_with_delay>(2, 0));
+      CHECK(slow.value().error().code == errc::timed_out);
+      CHECK(fast.value().value() == 2);
+    }());
+    CHECK(client.has_closed() == false);
+    auto ret = client.sync_call<echo_with_delay>(3, 0);
+    CHECK(ret.value() == 3);
+  }
+
+  SUBCASE("responses finishing together are written by coalesced flushes") {
+    using coro_rpc_protocol = coro_rpc::protocol::coro_rpc_protocol;
+    std::vector<Lazy<rpc_result<int, coro_rpc_protocol>>> calls;
+    for (int i = 0; i < 50; ++i) {
+      calls.push_back(client.call<echo_in_batch>(i, 50));
+    }
+    auto results = syncAwait([&]() -> Lazy<std::vector<async_simple::Try<
+                                        rpc_result<int, coro_rpc_protocol>>>> {
+      co_return co_await collectAll(std::move(calls));
+    }());
+    for (int i = 0; i < 50; ++i) {
+      CHECK(results[i].value().value() == i);
+    }
+    auto stats = client.sync_call<get_write_stats>();
+    REQUIRE(stats.has_value());
+    auto [flush_count, message_count, max_coalesced] = stats.value();
+    CHECK(message_count == 50);
+    // the 49 responses queued while the first one is written go out together.
+    CHECK(flush_count < message_count);
+    CHECK(max_coalesced > 1);
+  }
+}
+
+TEST_CASE("testing client with view arguments") {
+  g_action = {};
+  coro_rpc_server server(2, 8801);
+  server.register_handler<blob_view_in_body, sum_span, point_dot,
+                          coro_blob_size>();
+  auto res = server.async_start();
+  REQUIRE_MESSAGE(res, "server start failed");
+  coro_rpc_client client(*coro_io::get_global_executor(), g_client_id++);
+  auto ec = client.sync_connect("127.0.0.1", "8801");
+  REQUIRE_MESSAGE(!ec, ec.message());
+
+  std::string blob(1024 * 1024, 'A');
+  auto in_body = client.sync_call<blob_view_in_body>(blob);
+  REQUIRE(in_body.has_value());
+  CHECK(in_body.value());
+
+  std::vector<int> values(1000);
+  std::iota(values.begin(), values.end(), 0);
+  auto sum = client.sync_call<sum_span>(values);
+  REQUIRE(sum.has_value());
+  CHECK(sum.value() == 999 * 1000 / 2);
+
+  auto dot = client.sync_call<point_dot>(point3{1, 2, 3}, point3{4, 5, 6});
+  REQUIRE(dot.has_value());
+  CHECK(dot.value() == 32);
+
+  // the body outlives the coro function's suspension.
+  auto size = client.sync_call<coro_blob_size>(blob);
+  REQUIRE(size.has_value());
+  CHECK(size.value() == blob.size());
+}
+
+TEST_CASE("testing client with stream calls") {
+  g_action = {};
+  coro_rpc_server server(2, 8801);
+  server.register_handler<count_to, count_produced, stream_then_throw,
+                          hello>();
+  auto res = server.async_start();
+  REQUIRE_MESSAGE(res, "server start failed");
+  coro_rpc_client client(*coro_io::get_global_executor());
+  REQUIRE(client.init_config(
+      coro_rpc_client::config{.client_id = g_client_id++, .stream_window = 4}));
+  auto ec = client.sync_connect("127.0.0.1", "8801");
+  REQUIRE_MESSAGE(!ec, ec.message());
+
+  SUBCASE("read the whole stream") {
+    syncAwait([&]() -> Lazy<void> {
+      auto stream = co_await client.call_stream<count_to>(1000);
+      REQUIRE(stream.has_value());
+      int expected = 0;
+      while (true) {
+        auto item = co_await stream->next();
+        REQUIRE(item.has_value());
+        if (!item.value()) {
+          break;
+        }
+        CHECK(*item.value() == expected++);
+      }
+      CHECK(expected == 1000);
+      auto end = co_await stream->next();
+      CHECK((end.has_value() && !end.value()));
+    }());
+    CHECK(client.sync_call<hello>() == "hello");
+  }
+
+  SUBCASE("the function throws after some items") {
+    syncAwait([&]() -> Lazy<void> {
+      auto stream = co_await client.call_stream<stream_then_throw>(3);
+      REQUIRE(stream.has_value());
+      for (int i = 0; i < 3; ++i) {
+        auto item = co_await stream->next();
+        REQUIRE((item.has_value() && item.value()));
+        CHECK(*item.value() == std::to_string(i));
+      }
+      auto end = co_await stream->next();
+      REQUIRE(!end.has_value());
+      CHECK(end.error().code == coro_rpc::errc::interrupted);
+    }());
+  }
+
+  SUBCASE("drop the stream early") {
+    g_produced_items = 0;
+    syncAwait([&]() -> Lazy<void> {
+      auto stream = co_await client.call_stream<count_produced>(1000000);
+      REQUIRE(stream.has_value());
+      auto item = co_await stream->next();
+      REQUIRE((item.has_value() && item.value()));
+    }());
+    // the stream is canceled, its remaining items aren't produced.
+    CHECK(client.sync_call<hello>() == "hello");
+    std::this_thread::sleep_for(100ms);
+    CHECK(g_produced_items < 100);
+  }
+
+  SUBCASE("an unread stream doesn't hold up the other calls") {
+    g_produced_items = 0;
+    syncAwait([&]() -> Lazy<void> {
+      auto stream = co_await client.call_stream<count_produced>(100);
+      REQUIRE(stream.has_value());
+      for (int i = 0; i < 10; ++i) {
+        auto ret = co_await client.call<hello>();
+        CHECK(ret.value() == "hello");
+      }
+      // the server waits for the reader, one item past the window at most.
+      CHECK(g_produced_items <= 5);
+      int expected = 0;
+      while (true) {
+        auto item = co_await stream->next();
+        REQUIRE(item.has_value());
+        if (!item.value()) {
+          break;
+        }
+        CHECK(*item.value() == expected++);
+      }
+      CHECK(expected == 100);
+    }());
+  }
+}
+
 TEST_CASE("testing client with context response user-defined error") {
   g_action = {};
   coro_rpc_server server(2, 8801);
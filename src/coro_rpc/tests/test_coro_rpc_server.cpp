@@ -240,6 +240,196 @@ TEST_CASE("testing coro rpc server stop") {
   }
 }
 
+TEST_CASE("testing coro rpc server reuse_port") {
+  ELOGV(INFO, "run testing coro rpc server reuse_port");
+  coro_rpc::config::coro_rpc_default_config config;
+  config.thread_num = 4;
+  config.port = 8810;
+  config.reuse_port = true;
+  coro_rpc_server server(config);
+  server.register_handler<hello>();
+  auto res = server.async_start();
+  REQUIRE_MESSAGE(res, "server start failed");
+  // every connection is served, whichever acceptor the kernel picks.
+  for (int i = 0; i < 16; ++i) {
+    coro_rpc_client client(*coro_io::get_global_executor(), g_client_id++);
+    auto ec = syncAwait(client.connect("127.0.0.1", "8810"));
+    REQUIRE_MESSAGE(!ec, ec.message());
+    auto ret = syncAwait(client.call<hello>());
+    REQUIRE(ret);
+    CHECK(ret.value() == "hello");
+  }
+  server.stop();
+}
+
+TEST_CASE("testing coro rpc server cpu affinity") {
+  ELOGV(INFO, "run testing coro rpc server cpu affinity");
+  coro_rpc::config::coro_rpc_default_config config;
+  config.thread_num = 2;
+  config.port = 8810;
+  config.cpu_affinity = coro_io::cpu_affinity_policy{};
+  config.cpu_affinity->skip_hyperthread_siblings = true;
+  coro_rpc_server server(config);
+  server.register_handler<hello>();
+  auto res = server.async_start();
+  REQUIRE_MESSAGE(res, "server start failed");
+  coro_rpc_client client(*coro_io::get_global_executor(), g_client_id++);
+  auto ec = syncAwait(client.connect("127.0.0.1", "8810"));
+  REQUIRE_MESSAGE(!ec, ec.message());
+  auto ret = syncAwait(client.call<hello>());
+  REQUIRE(ret);
+  CHECK(ret.value() == "hello");
+  server.stop();
+}
+
+TEST_CASE("testing coro rpc server rate limit") {
+  ELOGV(INFO, "run testing coro rpc server rate limit");
+  coro_rpc::config::coro_rpc_default_config config;
+  config.thread_num = 1;
+  config.port = 8810;
+  config.accept_rate_limiter =
+      std::make_shared<coro_io::keyed_rate_limiter>(0.1, 2);
+  config.request_rate_limiter =
+      std::make_shared<coro_io::keyed_rate_limiter>(2, 5);
+  coro_rpc_server server(config);
+  server.register_handler<hello>();
+  auto res = server.async_start();
+  REQUIRE_MESSAGE(res, "server start failed");
+
+  coro_rpc_client client(*coro_io::get_global_executor(), g_client_id++);
+  auto ec = syncAwait(client.connect("127.0.0.1", "8810"));
+  REQUIRE_MESSAGE(!ec, ec.message());
+  for (int i = 0; i < 5; ++i) {
+    auto ret = syncAwait(client.call<hello>());
+    REQUIRE(ret);
+  }
+  // the bucket of 127.0.0.1 is empty now.
+  auto ret = syncAwait(client.call<hello>());
+  REQUIRE(!ret);
+  CHECK(ret.error().code == coro_rpc::errc::too_many_requests);
+  // the rejection keeps the connection open, the next call succeeds once the
+  // bucket has a permit again.
+  std::this_thread::sleep_for(std::chrono::milliseconds(600));
+  ret = syncAwait(client.call<hello>());
+  REQUIRE_MESSAGE(ret, ret.error().msg);
+  CHECK(ret.value() == "hello");
+
+  // the second connection is admitted, the third is closed.
+  coro_rpc_client client2(*coro_io::get_global_executor(), g_client_id++);
+  ec = syncAwait(client2.connect("127.0.0.1", "8810"));
+  REQUIRE_MESSAGE(!ec, ec.message());
+  coro_rpc_client client3(*coro_io::get_global_executor(), g_client_id++);
+  ec = syncAwait(client3.connect("127.0.0.1", "8810"));
+  if (!ec) {
+    ret = syncAwait(client3.call<hello>());
+    CHECK(!ret);
+    CHECK(ret.error().code != coro_rpc::errc::too_many_requests);
+  }
+  server.stop();
+}
+
+TEST_CASE("testing coro rpc server concurrency limit") {
+  ELOGV(INFO, "run testing coro rpc server concurrency limit");
+  coro_rpc::config::coro_rpc_default_config config;
+  config.thread_num = 4;
+  config.port = 8810;
+  coro_io::concurrency_limiter::config limiter_config;
+  limiter_config.initial_limit = 1;
+  limiter_config.min_limit = 1;
+  limiter_config.max_limit = 1;
+  config.concurrency_limiter =
+      std::make_shared<coro_io::concurrency_limiter>(limiter_config);
+  coro_rpc_server server(config);
+  server.register_handler<hello_timeout, echo_with_delay>();
+  auto res = server.async_start();
+  REQUIRE_MESSAGE(res, "server start failed");
+
+  std::vector<std::unique_ptr<coro_rpc_client>> clients;
+  for (int i = 0; i < 4; ++i) {
+    clients.push_back(std::make_unique<coro_rpc_client>(
+        *coro_io::get_global_executor(), g_client_id++));
+    auto ec = syncAwait(clients.back()->connect("127.0.0.1", "8810"));
+    REQUIRE_MESSAGE(!ec, ec.message());
+  }
+  std::atomic<int> succeeded = 0, busy = 0;
+  auto call = [&](coro_rpc_client &client) -> async_simple::coro::Lazy<void> {
+    auto ret = co_await client.call<hello_timeout>();
+    if (ret) {
+      ++succeeded;
+    }
+    else if (ret.error().code == coro_rpc::errc::server_busy) {
+      ++busy;
+    }
+  };
+  syncAwait([&]() -> async_simple::coro::Lazy<void> {
+    std::vector<async_simple::coro::Lazy<void>> calls;
+    for (auto &client : clients) {
+      calls.push_back(call(*client));
+    }
+    co_await async_simple::coro::collectAll(std::move(calls));
+  }());
+  CHECK(succeeded >= 1);
+  CHECK(busy >= 1);
+  CHECK(succeeded + busy == 4);
+  CHECK(config.concurrency_limiter->inflight() == 0);
+
+  // the rejected clients are still connected.
+  for (auto &client : clients) {
+    auto ret = syncAwait(client->call<hello_timeout>());
+    REQUIRE_MESSAGE(ret, ret.error().msg);
+    CHECK(ret.value() == "hello");
+  }
+
+  // a delayed response holds its slot until it's sent, not until its
+  // function returns.
+  syncAwait([&]() -> async_simple::coro::Lazy<void> {
+    auto delayed = [&]() -> async_simple::coro::Lazy<void> {
+      auto ret = co_await clients[0]->call<echo_with_delay>(42, 300);
+      REQUIRE_MESSAGE(ret, ret.error().msg);
+      CHECK(ret.value() == 42);
+    };
+    auto rejected = [&]() -> async_simple::coro::Lazy<void> {
+      co_await coro_io::sleep_for(std::chrono::milliseconds(100));
+      auto ret = co_await clients[1]->call<hello_timeout>();
+      REQUIRE(!ret);
+      CHECK(ret.error().code == coro_rpc::errc::server_busy);
+    };
+    co_await async_simple::coro::collectAll(delayed(), rejected());
+  }());
+  CHECK(config.concurrency_limiter->inflight() == 0);
+  auto ret = syncAwait(clients[1]->call<hello_timeout>());
+  CHECK(ret);
+  server.stop();
+}
+
+struct work_stealing_config : public coro_rpc::config::coro_rpc_config_base {
+  using rpc_protocol = coro_rpc::protocol::coro_rpc_protocol;
+  using executor_pool_t = coro_io::work_stealing_executor_pool;
+};
+
+TEST_CASE("testing coro rpc server with work stealing executor pool") {
+  ELOGV(INFO, "run testing coro rpc server with work stealing executor pool");
+  work_stealing_config config;
+  config.thread_num = 2;
+  config.port = 8810;
+  coro_rpc::coro_rpc_server_base<work_stealing_config> server(config);
+  server.register_handler<hello, get_coro_value>();
+  auto res = server.async_start();
+  REQUIRE_MESSAGE(res, "server start failed");
+  for (int i = 0; i < 8; ++i) {
+    coro_rpc_client client(*coro_io::get_global_executor(), g_client_id++);
+    auto ec = syncAwait(client.connect("127.0.0.1", "8810"));
+    REQUIRE_MESSAGE(!ec, ec.message());
+    auto ret = syncAwait(client.call<hello>());
+    REQUIRE(ret);
+    CHECK(ret.value() == "hello");
+    auto ret2 = syncAwait(client.call<get_coro_value>(i));
+    REQUIRE(ret2);
+    CHECK(ret2.value() == i);
+  }
+  server.stop();
+}
+
 TEST_CASE("test server accept error") {
   ELOGV(INFO, "run test server accept error");
   g_action = inject_action::force_inject_server_accept_error;
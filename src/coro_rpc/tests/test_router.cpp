@@ -371,6 +371,52 @@ TEST_CASE("testing basic rpc register and route") {
   }
 }
 
+TEST_CASE("testing frozen router") {
+  coro_rpc::protocol::router<coro_rpc::protocol::coro_rpc_protocol> r;
+  test_class obj{};
+  r.register_handler<get_str, coro_func>();
+  r.register_handler<&test_class::plus_one>(&obj);
+  // many keys sharing one function, to fill the table.
+  for (uint32_t key = 1; key <= 1000; ++key) {
+    r.register_handler<plus_one>(key * 7919);
+  }
+  CHECK(!r.is_frozen());
+  r.freeze();
+  CHECK(r.is_frozen());
+
+  CHECK(r.get_handler(func_id<get_str>()) != nullptr);
+  CHECK(r.get_coro_handler(func_id<get_str>()) == nullptr);
+  CHECK(r.get_coro_handler(func_id<coro_func>()) != nullptr);
+  CHECK(r.get_handler(func_id<coro_func>()) == nullptr);
+  CHECK(r.get_handler(func_id<not_register_func>()) == nullptr);
+  CHECK(r.get_coro_handler(func_id<not_register_func>()) == nullptr);
+  for (uint32_t key = 1; key <= 1000; ++key) {
+    CHECK(r.get_handler(key * 7919) != nullptr);
+  }
+
+  auto call = [&](auto handler, uint32_t id, const auto &buf) {
+    ctx->req_head_.function_id = id;
+    return r.route(handler, std::string_view{buf.data(), buf.size()}, ctx,
+                   std::variant<coro_rpc::protocol::struct_pack_protocol>{},
+                   id);
+  };
+  auto buf = pack(std::string("test"));
+  auto pair = call(r.get_handler(func_id<get_str>()), func_id<get_str>(), buf);
+  CHECK(!pair.first);
+  CHECK(get_result<get_str>(pair).value() == "test");
+
+  buf = pack(42);
+  constexpr auto member_id = func_id<&test_class::plus_one>();
+  pair = call(r.get_handler(member_id), member_id, buf);
+  CHECK(!pair.first);
+
+  // registering after freeze rebuilds the table.
+  r.register_handler<plus_two>();
+  CHECK(r.is_frozen());
+  CHECK(r.get_handler(func_id<plus_two>()) != nullptr);
+  CHECK(r.get_handler(func_id<get_str>()) != nullptr);
+}
+
 using namespace coro_rpc;
 using namespace coro_rpc::internal;
 TEST_CASE("test get_return_type in connection") {
@@ -7,6 +7,7 @@
 #include <vector>
 inline constexpr int OBJECT_COUNT = 20;
 inline constexpr int ITERATIONS = 1000000;
+inline constexpr int VARINT_COUNT = 1000;
 
 enum class LibType {
   STRUCT_PACK,
@@ -27,6 +28,7 @@ enum class SampleType {
   MONSTER,
   MONSTERS,
   ZC_MONSTERS,
+  VARINTS,
 };
 
 inline const std::unordered_map<SampleType, std::string> g_sample_name_map = {
@@ -44,7 +46,8 @@ inline const std::unordered_map<SampleType, std::string> g_sample_name_map = {
     {SampleType::MONSTER, "1 monster"},
     {SampleType::MONSTERS, std::to_string(OBJECT_COUNT) + " monsters"},
     {SampleType::ZC_MONSTERS,
-     std::to_string(OBJECT_COUNT) + " monsters(with zero-copy deserialize)"}};
+     std::to_string(OBJECT_COUNT) + " monsters(with zero-copy deserialize)"},
+    {SampleType::VARINTS, std::to_string(VARINT_COUNT) + " var_int64"}};
 
 inline const std::unordered_map<LibType, std::string> g_lib_name_map = {
     {LibType::STRUCT_PACK, "struct_pack"},
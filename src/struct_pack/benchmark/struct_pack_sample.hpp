@@ -1,4 +1,5 @@
 #pragma once
+#include <random>
 #include <stdexcept>
 #include <type_traits>
 #include <unordered_map>
@@ -75,6 +76,18 @@ inline std::vector<Monster> create_monsters(size_t object_count) {
   return v;
 }
 
+// random widths of mostly small values, like ids and lengths are.
+inline auto create_varints(size_t count, uint64_t seed = 0) {
+  std::mt19937_64 gen(seed);
+  std::vector<struct_pack::var_int64_t> v{};
+  for (std::size_t i = 0; i < count; i++) {
+    int bits = gen() % 4 ? gen() % 14 : gen() % 63;
+    auto value = static_cast<int64_t>(gen() & ((1ull << bits) - 1));
+    v.push_back(i % 2 ? value : -value);
+  }
+  return v;
+}
+
 struct struct_pack_sample : public base_sample {
   static inline constexpr LibType lib_type = LibType::STRUCT_PACK;
   std::string name() const override { return get_lib_name(lib_type); }
@@ -84,6 +97,7 @@ struct struct_pack_sample : public base_sample {
     persons_ = create_persons(OBJECT_COUNT);
     monsters_ = create_monsters(OBJECT_COUNT);
     rect2s_ = create_rect2s(OBJECT_COUNT);
+    varints_ = create_varints(VARINT_COUNT);
   }
 
   void do_serialization() override {
@@ -95,6 +109,7 @@ struct struct_pack_sample : public base_sample {
     serialize(SampleType::PERSONS, persons_);
     serialize(SampleType::MONSTER, monsters_[0]);
     serialize(SampleType::MONSTERS, monsters_);
+    serialize(SampleType::VARINTS, varints_);
   }
 
   void do_deserialization() override {
@@ -116,6 +131,7 @@ struct struct_pack_sample : public base_sample {
     deserialize<std::vector<Monster>, std::vector<zc_Monster>>(
         SampleType::ZC_MONSTERS, monsters_);
 #endif
+    deserialize_varints();
   }
 
  private:
@@ -165,9 +181,37 @@ struct struct_pack_sample : public base_sample {
     deser_time_elapsed_map_.emplace(sample_type, ns);
   }
 
+  // deserialize distinct arrays in turn, the branch predictor would learn
+  // the widths of a single one.
+  void deserialize_varints() {
+    std::vector<std::string> buffers;
+    for (int i = 0; i < 64; ++i) {
+      buffers.push_back(struct_pack::serialize<std::string>(
+          create_varints(VARINT_COUNT, i)));
+    }
+
+    std::vector<struct_pack::var_int64_t> obj;
+
+    uint64_t ns = 0;
+    std::string bench_name =
+        name() + " deserialize " + get_sample_name(SampleType::VARINTS);
+
+    {
+      ScopedTimer timer(bench_name.data(), ns);
+      for (int i = 0; i < ITERATIONS; ++i) {
+        auto &buffer = buffers[i % buffers.size()];
+        [[maybe_unused]] auto ec = struct_pack::deserialize_to(obj, buffer);
+        no_op((char *)&obj);
+        no_op(buffer);
+      }
+    }
+    deser_time_elapsed_map_.emplace(SampleType::VARINTS, ns);
+  }
+
   std::vector<rect2<int32_t>> rect2s_;
   std::vector<rect<int32_t>> rects_;
   std::vector<person> persons_;
   std::vector<Monster> monsters_;
+  std::vector<struct_pack::var_int64_t> varints_;
   std::string buffer_;
 };
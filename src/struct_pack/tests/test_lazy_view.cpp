@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <ylt/struct_pack.hpp>
+
+#include "doctest.h"
+
+namespace test_lazy_view {
+struct header {
+  int32_t id;
+  std::string route;
+};
+
+struct message {
+  header head;
+  int64_t timestamp;
+  std::string name;
+  std::vector<int32_t> values;
+  std::map<std::string, std::string> attrs;
+  double score;
+};
+
+struct padded {
+  char a;
+  int64_t b;
+  int16_t c;
+};
+
+struct varint_fields {
+  int32_t a;
+  std::string b;
+  uint64_t c;
+  static constexpr auto struct_pack_config =
+      struct_pack::sp_config::ENCODING_WITH_VARINT;
+};
+}  // namespace test_lazy_view
+
+using namespace test_lazy_view;
+
+TEST_CASE("test lazy_view") {
+  message msg{{42, "/user/get"},
+              1700000000000,
+              "tom",
+              {1, 2, 3, 4},
+              {{"k1", "v1"}, {"k2", "v2"}},
+              3.5};
+  auto buffer = struct_pack::serialize(msg);
+  auto view = struct_pack::get_lazy_view<message>(buffer);
+  REQUIRE(view.has_value());
+  CHECK(view->get<1>().value() == msg.timestamp);
+  CHECK(view->get<5>().value() == msg.score);
+  CHECK(view->get<4>().value() == msg.attrs);
+  CHECK(view->get<2>().value() == msg.name);
+
+  // fields can be read as views of the buffer.
+  auto name = view->get<2, std::string_view>();
+  REQUIRE(name.has_value());
+  CHECK(name.value() == msg.name);
+  CHECK(name->data() >= buffer.data());
+  CHECK(name->data() < buffer.data() + buffer.size());
+#if __cpp_lib_span >= 202002L
+  auto values = view->get<3, std::span<int32_t>>();
+  REQUIRE(values.has_value());
+  CHECK(std::vector<int32_t>(values->begin(), values->end()) == msg.values);
+#endif
+
+  auto head = view->view<0>();
+  REQUIRE(head.has_value());
+  CHECK(head->get<0>().value() == msg.head.id);
+  CHECK(head->get<1, std::string_view>().value() == msg.head.route);
+  auto whole_head = view->get<0>();
+  REQUIRE(whole_head.has_value());
+  CHECK(whole_head->route == msg.head.route);
+
+  // field_data is what get_field would read.
+  CHECK(view->field_data<2>().size() == 1 + msg.name.size());
+
+  for (std::size_t len = 0; len < buffer.size(); ++len) {
+    auto truncated = struct_pack::get_lazy_view<message>(buffer.data(), len);
+    CHECK(!truncated.has_value());
+  }
+}
+
+TEST_CASE("test lazy_view of a constant layout") {
+  padded p{'x', -7, 300};
+  auto buffer = struct_pack::serialize(p);
+  auto view = struct_pack::get_lazy_view<padded>(buffer);
+  REQUIRE(view.has_value());
+  CHECK(view->get<0>().value() == p.a);
+  CHECK(view->get<1>().value() == p.b);
+  CHECK(view->get<2>().value() == p.c);
+  CHECK(view->field_data<1>().size() == sizeof(int64_t));
+}
+
+TEST_CASE("test lazy_view of varint fields") {
+  varint_fields v{-1, "hello", UINT64_MAX};
+  auto buffer = struct_pack::serialize(v);
+  auto view = struct_pack::get_lazy_view<varint_fields>(buffer);
+  REQUIRE(view.has_value());
+  CHECK(view->get<0>().value() == v.a);
+  CHECK(view->get<1>().value() == v.b);
+  CHECK(view->get<2>().value() == v.c);
+  CHECK(view->field_data<0>().size() == 10);
+}
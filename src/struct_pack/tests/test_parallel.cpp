@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <atomic>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ylt/struct_pack.hpp>
+
+#include "doctest.h"
+
+namespace test_parallel {
+struct record {
+  int id;
+  std::string name;
+  std::vector<int> values;
+  std::optional<std::string> note;
+};
+
+// runs every task on a thread of its own.
+struct thread_executor {
+  std::vector<std::thread> threads;
+  std::atomic<int> scheduled = 0;
+  void schedule(std::function<void()> func) {
+    ++scheduled;
+    threads.emplace_back(std::move(func));
+  }
+  ~thread_executor() {
+    for (auto &t : threads) {
+      t.join();
+    }
+  }
+};
+
+// refuses every task, as async_simple::Executor::schedule may.
+struct refusing_executor {
+  int refused = 0;
+  bool schedule(std::function<void()>) {
+    ++refused;
+    return false;
+  }
+};
+
+// called from its own thread, like a task of a single threaded executor.
+struct current_executor {
+  int scheduled = 0;
+  void schedule(std::function<void()> func) {
+    ++scheduled;
+    func();
+  }
+  bool currentThreadInExecutor() const { return true; }
+};
+
+std::vector<record> make_records(int n, std::size_t values_size) {
+  std::vector<record> records;
+  for (int i = 0; i < n; ++i) {
+    record r{i, "a name which isn't a short string " + std::to_string(i),
+             std::vector<int>(values_size, i), std::nullopt};
+    if (i % 3 == 0) {
+      r.note = std::to_string(i);
+    }
+    records.push_back(std::move(r));
+  }
+  return records;
+}
+}  // namespace test_parallel
+
+using namespace test_parallel;
+
+TEST_CASE("test serialize_parallel") {
+  SUBCASE("short containers") {
+    auto records = make_records(100, 3);
+    thread_executor executor;
+    auto buffer = struct_pack::serialize_parallel(executor, records, 7);
+    // both the sizes and the bytes of 6 chunks are made on the executor.
+    CHECK(executor.scheduled == 12);
+    CHECK(buffer == struct_pack::serialize(records));
+    auto records2 = struct_pack::deserialize<std::vector<record>>(buffer);
+    REQUIRE(records2.has_value());
+    CHECK(records2->size() == records.size());
+    CHECK(records2->back().name == records.back().name);
+  }
+  SUBCASE("long containers") {
+    thread_executor executor;
+    auto records = make_records(1000, 3);
+    CHECK(struct_pack::serialize_parallel(executor, records, 4) ==
+          struct_pack::serialize(records));
+    records = make_records(10, 70000);
+    CHECK(struct_pack::serialize_parallel(executor, records, 4) ==
+          struct_pack::serialize(records));
+  }
+  SUBCASE("trivially copyable elements") {
+    thread_executor executor;
+    std::vector<int> values(100000);
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      values[i] = i;
+    }
+    CHECK(struct_pack::serialize_parallel(executor, values, 3) ==
+          struct_pack::serialize(values));
+  }
+  SUBCASE("map") {
+    thread_executor executor;
+    std::map<int, std::string> m;
+    for (int i = 0; i < 1000; ++i) {
+      m.emplace(i, std::to_string(i));
+    }
+    CHECK(struct_pack::serialize_parallel(executor, m, 5) ==
+          struct_pack::serialize(m));
+  }
+  SUBCASE("more chunks than elements") {
+    thread_executor executor;
+    auto records = make_records(3, 3);
+    CHECK(struct_pack::serialize_parallel(executor, records, 8) ==
+          struct_pack::serialize(records));
+    CHECK(executor.scheduled == 4);
+    std::vector<record> empty;
+    CHECK(struct_pack::serialize_parallel(executor, empty, 8) ==
+          struct_pack::serialize(empty));
+  }
+  SUBCASE("config") {
+    thread_executor executor;
+    auto records = make_records(100, 3);
+    constexpr auto conf = struct_pack::sp_config::DISABLE_ALL_META_INFO;
+    CHECK(struct_pack::serialize_parallel<conf, std::string>(executor, records,
+                                                             4) ==
+          struct_pack::serialize<conf, std::string>(records));
+  }
+  SUBCASE("append to a buffer") {
+    thread_executor executor;
+    auto records = make_records(100, 3);
+    std::vector<char> buffer{'a', 'b'};
+    struct_pack::serialize_to_parallel(buffer, executor, records, 4);
+    auto expected = struct_pack::serialize(records);
+    REQUIRE(buffer.size() == expected.size() + 2);
+    CHECK(std::equal(expected.begin(), expected.end(), buffer.begin() + 2));
+  }
+  SUBCASE("executor refuses the tasks") {
+    refusing_executor executor;
+    auto records = make_records(100, 3);
+    CHECK(struct_pack::serialize_parallel(executor, records, 4) ==
+          struct_pack::serialize(records));
+    CHECK(executor.refused == 6);
+  }
+  SUBCASE("called from a thread of the executor") {
+    current_executor executor;
+    auto records = make_records(100, 3);
+    CHECK(struct_pack::serialize_parallel(executor, records, 4) ==
+          struct_pack::serialize(records));
+    CHECK(executor.scheduled == 0);
+  }
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <ylt/struct_pack.hpp>
+
+#include "doctest.h"
+
+#ifdef STRUCT_PACK_ENABLE_PMR
+#include <memory_resource>
+
+namespace test_pmr {
+struct person {
+  int age;
+  std::string name;
+};
+
+struct request {
+  std::vector<std::string> tags;
+  std::map<std::string, person> persons;
+  std::vector<person> list;
+  std::optional<std::string> note;
+};
+
+struct pmr_person {
+  int age;
+  std::pmr::string name;
+};
+
+struct pmr_request {
+  std::pmr::vector<std::pmr::string> tags;
+  std::pmr::map<std::pmr::string, pmr_person> persons;
+  std::pmr::vector<pmr_person> list;
+  std::optional<std::pmr::string> note;
+};
+
+class counting_resource : public std::pmr::memory_resource {
+ public:
+  std::size_t allocations = 0;
+
+ private:
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+    ++allocations;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void *p, std::size_t bytes,
+                     std::size_t alignment) override {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(
+      const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+// all the allocations of the default resource are counted while it's alive.
+struct default_resource_guard {
+  default_resource_guard()
+      : old(std::pmr::set_default_resource(&default_resource)) {}
+  ~default_resource_guard() { std::pmr::set_default_resource(old); }
+  counting_resource default_resource;
+  std::pmr::memory_resource *old;
+};
+
+request make_request() {
+  request r;
+  for (int i = 0; i < 100; ++i) {
+    auto name = "a name which isn't a short string " + std::to_string(i);
+    r.tags.push_back("a tag which isn't a short string " + std::to_string(i));
+    r.persons.emplace(name, person{i, name});
+    r.list.push_back({i, name});
+  }
+  r.note = "a note which isn't a short string";
+  return r;
+}
+
+bool equal(std::string_view a, std::string_view b) { return a == b; }
+
+void check_equal(const pmr_request &r1, const request &r2) {
+  REQUIRE(r1.tags.size() == r2.tags.size());
+  for (std::size_t i = 0; i < r1.tags.size(); ++i) {
+    CHECK(equal(r1.tags[i], r2.tags[i]));
+  }
+  REQUIRE(r1.persons.size() == r2.persons.size());
+  auto iter = r2.persons.begin();
+  for (auto &[name, p] : r1.persons) {
+    CHECK(equal(name, iter->first));
+    CHECK(p.age == iter->second.age);
+    CHECK(equal(p.name, iter->second.name));
+    ++iter;
+  }
+  REQUIRE(r1.list.size() == r2.list.size());
+  for (std::size_t i = 0; i < r1.list.size(); ++i) {
+    CHECK(r1.list[i].age == r2.list[i].age);
+    CHECK(equal(r1.list[i].name, r2.list[i].name));
+  }
+  REQUIRE(r1.note.has_value());
+  CHECK(equal(*r1.note, *r2.note));
+}
+}  // namespace test_pmr
+
+using namespace test_pmr;
+
+TEST_CASE("test deserialize with memory_resource") {
+  auto r = make_request();
+  auto buffer = struct_pack::serialize(r);
+
+  SUBCASE("everything is allocated from the resource") {
+    counting_resource upstream;
+    std::pmr::monotonic_buffer_resource arena(&upstream);
+    default_resource_guard guard;
+    auto r2 = struct_pack::deserialize<pmr_request>(buffer, arena);
+    REQUIRE(r2.has_value());
+    check_equal(r2.value(), r);
+    CHECK(upstream.allocations > 0);
+    CHECK(guard.default_resource.allocations == 0);
+    CHECK(r2->tags.get_allocator().resource() == &arena);
+    CHECK(r2->persons.begin()->second.name.get_allocator().resource() ==
+          &arena);
+    CHECK(r2->note->get_allocator().resource() == &arena);
+  }
+  SUBCASE("deserialize_to an object of another resource") {
+    counting_resource upstream;
+    std::pmr::monotonic_buffer_resource arena(&upstream);
+    pmr_request r2;
+    r2.tags.emplace_back("a tag which is going to be overwritten");
+    default_resource_guard guard;
+    auto ec = struct_pack::deserialize_to(r2, buffer.data(), buffer.size(),
+                                          arena);
+    REQUIRE(!ec);
+    check_equal(r2, r);
+    CHECK(guard.default_resource.allocations == 0);
+    CHECK(r2.tags.get_allocator().resource() == &arena);
+  }
+  SUBCASE("without a resource") {
+    auto r2 = struct_pack::deserialize<pmr_request>(buffer);
+    REQUIRE(r2.has_value());
+    check_equal(r2.value(), r);
+    CHECK(r2->tags.get_allocator().resource() ==
+          std::pmr::get_default_resource());
+  }
+  SUBCASE("broken buffer") {
+    std::pmr::monotonic_buffer_resource arena;
+    auto r2 = struct_pack::deserialize<pmr_request>(buffer.data(),
+                                                    buffer.size() / 2, arena);
+    REQUIRE(!r2.has_value());
+    CHECK(r2.error() == struct_pack::errc::no_buffer_space);
+  }
+}
+#endif
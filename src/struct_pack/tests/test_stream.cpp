@@ -259,4 +259,89 @@ TEST_CASE("testing broken container size") {
     }
   }
   std::filesystem::remove("tmp.data");
-}
\ No newline at end of file
+}
+TEST_CASE("test element_reader file") {
+  std::vector<person> persons;
+  for (int i = 0; i < 1000; ++i) {
+    persons.push_back({i, "person" + std::to_string(i)});
+  }
+  std::vector<int> numbers(70000);
+  for (int i = 0; i < 70000; ++i) {
+    numbers[i] = i * 3;
+  }
+  std::map<int, person> map = {{1, {20, "tom"}}, {2, {22, "jerry"}}};
+  {
+    std::ofstream ofs("5.save", std::ofstream::binary | std::ofstream::out);
+    struct_pack::serialize_to(ofs, persons);
+    struct_pack::serialize_to(ofs, numbers);
+    struct_pack::serialize_to(ofs, map);
+    struct_pack::serialize_to(ofs, std::vector<person>{});
+    struct_pack::serialize_to(ofs, persons[42]);
+  }
+  SUBCASE("read elements one by one") {
+    std::ifstream ifs("5.save", std::ofstream::binary | std::ofstream::in);
+    auto elements = struct_pack::get_element_reader<std::vector<person>>(ifs);
+    REQUIRE(elements.has_value());
+    CHECK(elements->size() == 1000);
+    std::vector<person> persons2;
+    for (auto &p : *elements) {
+      persons2.push_back(std::move(p));
+    }
+    CHECK(!elements->error());
+    CHECK(elements->remaining() == 0);
+    CHECK(persons2 == persons);
+    person p;
+    CHECK(elements->read(p) == struct_pack::errc::no_buffer_space);
+
+    auto numbers2 = struct_pack::get_element_reader<std::vector<int>>(ifs);
+    REQUIRE(numbers2.has_value());
+    CHECK(numbers2->size() == 70000);
+    int number;
+    for (int i = 0; i < 70000; ++i) {
+      REQUIRE(!numbers2->read(number));
+      CHECK(number == i * 3);
+    }
+
+    auto map2 = struct_pack::get_element_reader<std::map<int, person>>(ifs);
+    REQUIRE(map2.has_value());
+    std::map<int, person> map3;
+    for (auto &kv : *map2) {
+      map3.insert(std::move(kv));
+    }
+    CHECK(map3 == map);
+
+    auto empty = struct_pack::get_element_reader<std::vector<person>>(ifs);
+    REQUIRE(empty.has_value());
+    CHECK(empty->size() == 0);
+    CHECK(empty->begin() == empty->end());
+
+    auto p2 = struct_pack::deserialize<person>(ifs);
+    CHECK(p2 == persons[42]);
+  }
+  SUBCASE("wrong type") {
+    std::ifstream ifs("5.save", std::ofstream::binary | std::ofstream::in);
+    auto elements = struct_pack::get_element_reader<std::vector<int>>(ifs);
+    REQUIRE(!elements.has_value());
+    CHECK(elements.error() == struct_pack::errc::invalid_buffer);
+  }
+  SUBCASE("truncated file") {
+    auto buffer = struct_pack::serialize(persons);
+    buffer.resize(buffer.size() / 2);
+    {
+      std::ofstream ofs("5.save", std::ofstream::binary | std::ofstream::out);
+      ofs.write(buffer.data(), buffer.size());
+    }
+    std::ifstream ifs("5.save", std::ofstream::binary | std::ofstream::in);
+    auto elements = struct_pack::get_element_reader<std::vector<person>>(ifs);
+    REQUIRE(elements.has_value());
+    std::size_t count = 0;
+    for (auto &p : *elements) {
+      CHECK(p == persons[count++]);
+    }
+    CHECK(count > 0);
+    CHECK(count < 1000);
+    CHECK(elements->error() == struct_pack::errc::no_buffer_space);
+    CHECK(elements->remaining() == 0);
+  }
+  std::filesystem::remove("5.save");
+}
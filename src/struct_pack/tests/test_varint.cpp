@@ -1,4 +1,5 @@
 #include <cstdint>
+#include <sstream>
 #include <ylt/struct_pack.hpp>
 
 #include "doctest.h"
@@ -865,4 +866,50 @@ TEST_CASE("test varint by normal int") {
   REQUIRE(result.has_value());
   CHECK(result == v);
   CHECK(buffer.size() == 4);
-}
\ No newline at end of file
+}
+TEST_CASE("test varint array of every width") {
+  std::vector<var_uint64_t> vec;
+  for (int bits = 0; bits <= 64; ++bits) {
+    uint64_t value = bits == 64 ? UINT64_MAX : (1ull << bits) - 1;
+    vec.push_back(value);
+    vec.push_back(value + 1);
+  }
+  std::vector<var_int64_t> signed_vec;
+  for (auto v : vec) {
+    signed_vec.push_back(static_cast<int64_t>(v.get()));
+  }
+  auto buffer = struct_pack::serialize(vec, signed_vec);
+  {
+    auto result = struct_pack::deserialize<std::vector<var_uint64_t>,
+                                           std::vector<var_int64_t>>(buffer);
+    REQUIRE(result.has_value());
+    CHECK(std::get<0>(result.value()) == vec);
+    CHECK(std::get<1>(result.value()) == signed_vec);
+  }
+  {
+    // a stream reader takes the bytewise path.
+    std::stringstream ss(std::string(buffer.data(), buffer.size()));
+    auto result = struct_pack::deserialize<std::vector<var_uint64_t>,
+                                           std::vector<var_int64_t>>(ss);
+    REQUIRE(result.has_value());
+    CHECK(std::get<0>(result.value()) == vec);
+    CHECK(std::get<1>(result.value()) == signed_vec);
+  }
+  for (std::size_t len = 0; len < buffer.size(); len += 7) {
+    auto result = struct_pack::deserialize<std::vector<var_uint64_t>,
+                                           std::vector<var_int64_t>>(
+        buffer.data(), len);
+    CHECK(!result.has_value());
+  }
+  {
+    // a varint longer than 10 bytes is rejected.
+    std::vector<var_uint64_t> longest(20, UINT64_MAX);
+    auto buffer = struct_pack::serialize(longest);
+    auto pos = buffer.size() - 20 * 10 + 9;
+    REQUIRE(buffer[pos] == 1);
+    buffer[pos] = (char)0x81;
+    auto result = struct_pack::deserialize<std::vector<var_uint64_t>>(buffer);
+    REQUIRE(!result.has_value());
+    CHECK(result.error() == struct_pack::errc::invalid_buffer);
+  }
+}